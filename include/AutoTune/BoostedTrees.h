@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace KernelCodeGen {
+
+/// @brief a table of named features and one target per row.
+struct Samples {
+  std::vector<std::string> features;
+  std::vector<std::vector<double>> rows;
+  std::vector<double> targets;
+
+  /// @brief read a CSV whose header names the columns, the target column is taken out of the features.
+  /// Rows with a wrong number of fields or a field which isn't a number are skipped.
+  /// @param path
+  /// @param target name of the target column
+  /// @return false if the file can't be read or has no target column.
+  bool loadCSV(const std::string& path, const std::string& target);
+};
+
+struct TreeParams {
+  int trees = 200;
+  int depth = 4;
+  double learningRate = 0.1;
+  // a split leaves at least this many samples on both sides.
+  int minSamplesLeaf = 4;
+};
+
+/// @brief gradient boosted regression trees on the squared loss.
+/// The model is small enough to be trained offline from a few thousand measurements and evaluated in process.
+class BoostedTrees {
+public:
+  BoostedTrees() = default;
+
+  /// @return false if there are no samples.
+  bool train(const Samples& samples, const TreeParams& params = {});
+
+  /// @param values in the order of getFeatures(), missing trailing values count as 0.
+  double predict(const std::vector<double>& values) const;
+
+  /// @brief the model is a JSON object of the feature names, the base value and the trees.
+  bool load(const std::string& path);
+  bool save(const std::string& path) const;
+  /// @brief the JSON save() writes.
+  std::string toJson() const;
+
+  const std::vector<std::string>& getFeatures() const {
+    return features;
+  }
+
+  bool empty() const {
+    return trees.empty();
+  }
+
+private:
+  // a leaf has no feature, the values of the leaves are already scaled by the learning rate.
+  struct Node {
+    int feature = -1;
+    double threshold = 0.0;
+    int left = -1;
+    int right = -1;
+    double value = 0.0;
+  };
+  using Tree = std::vector<Node>;
+
+  int grow(Tree& tree, const Samples& samples, const std::vector<double>& residuals, const std::vector<int>& indices,
+           int depth, const TreeParams& params);
+  static double walk(const Tree& tree, const std::vector<double>& values);
+
+  std::vector<std::string> features;
+  double base = 0.0;
+  std::vector<Tree> trees;
+};
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "AutoTune/DeviceProfile.h"
+#include "Optimizer/Config.h"
+
+#include <string>
+#include <vector>
+
+namespace KernelCodeGen {
+
+/// @brief a matmul kernel measured on the device and priced by a cost model.
+struct Measurement {
+  int64_t m = 0;
+  int64_t n = 0;
+  int64_t k = 0;
+  // empty means the default config of the generator.
+  ConfigRecord config;
+  double measured = 0.0;
+  double predicted = 0.0;
+};
+
+/// @brief how well a cost model ranks and predicts the measured kernels.
+struct Accuracy {
+  double kendall = 0.0;
+  double spearman = 0.0;
+  // mean of |predicted - measured| / measured, in percent.
+  double mape = 0.0;
+};
+
+struct Calibration {
+  Calibration() = default;
+
+  /// @brief read the kernels of a benchmark log, every entry is
+  ///   Matrix size :
+  ///    --- M --- : 4096
+  ///    --- N --- : 2048
+  ///    --- K --- : 1024
+  ///   Config : BLOCK_SIZE_M=128;BLOCK_SIZE_N=128;...    (optional)
+  ///   My Matmul Latency = 1.80746 ms
+  /// the other lines (cublas, compiler output) are ignored.
+  static bool parseLog(const std::string& path, std::vector<Measurement>& measurements);
+
+  /// @brief Kendall's tau-b, ties count for neither order.
+  static double kendall(const std::vector<double>& x, const std::vector<double>& y);
+  /// @brief Pearson correlation of the ranks, ties take their average rank.
+  static double spearman(const std::vector<double>& x, const std::vector<double>& y);
+  static double mape(const std::vector<double>& predicted, const std::vector<double>& measured);
+
+  static Accuracy accuracy(const std::vector<Measurement>& measurements);
+
+  /// @brief fit measured = scale * predicted + offset minimizing the relative squared error,
+  /// the scale is kept positive so the ranking of the model is unchanged.
+  static void fitCorrection(const std::vector<Measurement>& measurements, double& scale, double& offsetMs);
+
+  /// @brief indices of the measurements with the largest relative error, worst first.
+  static std::vector<int> outliers(const std::vector<Measurement>& measurements, int count);
+};
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "AutoTune/Evaluator.h"
+#include "AutoTune/BoostedTrees.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace KernelCodeGen {
+
+/// @brief features of an optimized module for the learned cost model.
+/// The config reaches the features through the IR it produced: the grid and block dims, the local
+/// buffers, the unrolled loops and the vector width, so a module is described the same way in the
+/// measurement corpus and inside evaluate(). The kernel features are those of the heaviest kernel.
+struct FeatureExtractor {
+  FeatureExtractor() = default;
+
+  static const std::vector<std::string>& names();
+
+  /// @return one value per name.
+  static std::vector<double> extract(mlir::ModuleOp& module, const DeviceProfile& device);
+};
+
+/// @brief prices a module with gradient boosted trees trained offline on measured latencies.
+/// The trees predict log(ms), the roofline prices the modules while no model is loaded.
+struct LearnedEvaluator : Evaluator {
+  LearnedEvaluator() {
+    this->name = std::move(std::string("Learned"));
+  }
+  LearnedEvaluator(const std::string& modelPath) : LearnedEvaluator() {
+    load(modelPath);
+  }
+  virtual float evaluate(mlir::ModuleOp& module, const DeviceProfile& device) override;
+  /// @brief covers the trees, a retrained model at the same path prices differently.
+  virtual uint64_t digest() const override {
+    return llvm::hash_combine(name, model.toJson());
+  }
+
+  /// @brief the features of the model are matched to the extracted ones by name, the unknown ones count as 0.
+  bool load(const std::string& modelPath);
+
+  /// @brief train a model from a CSV written by RecordingEvaluator (the features plus a "latency" column in ms).
+  /// @return false if the samples can't be read or the model can't be written.
+  static bool train(const std::string& csvPath, const std::string& modelPath, const TreeParams& params = {});
+
+  BoostedTrees model;
+  // extracted feature of every feature of the model, -1 if the extractor doesn't know it.
+  std::vector<int> columns;
+};
+
+/// @brief measures with another evaluator and appends the features and the latency of every
+/// module to a CSV, the corpus LearnedEvaluator::train() reads.
+struct RecordingEvaluator : Evaluator {
+  RecordingEvaluator(std::unique_ptr<Evaluator> inner_, const std::string& csvPath_)
+    : inner(std::move(inner_)), csvPath(csvPath_) {
+    this->name = std::move(std::string("Recording"));
+  }
+  virtual float evaluate(mlir::ModuleOp& module, const DeviceProfile& device) override;
+  // the recording doesn't change the prices of the inner evaluator.
+  virtual uint64_t digest() const override {
+    return inner->digest();
+  }
+
+  std::unique_ptr<Evaluator> inner;
+  std::string csvPath;
+  // the tuning workers share the file.
+  std::mutex fileMutex;
+};
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace KernelCodeGen {
+
+/// @brief hardware limits of the target device, used to prune the tuning candidates.
+/// The defaults describe an A100 (sm_80), the same arch as CUDA_ARCH_VAR in cmake/config.cmake.
+struct DeviceProfile {
+  std::string name = "A100";
+  int64_t warpSize = 32;
+  int64_t maxThreadsPerBlock = 1024;
+  // static shared memory a block can allocate without opt-in.
+  int64_t maxSharedMemPerBlock = 48 * 1024;
+  int64_t maxRegistersPerThread = 255;
+  // widest vectorized global access in bytes (float4).
+  int64_t maxVectorBytes = 16;
+
+  int64_t smCount = 108;
+  int64_t maxWarpsPerSM = 64;
+  int64_t maxBlocksPerSM = 32;
+  int64_t registersPerSM = 64 * 1024;
+  int64_t sharedMemPerSM = 164 * 1024;
+  // registers are allocated per warp in units of registerAllocUnit.
+  int64_t registerAllocUnit = 256;
+  int64_t sharedAllocUnit = 128;
+  // shared memory the driver reserves for every block (sm_80).
+  int64_t reservedSharedMemPerBlock = 1024;
+  int64_t l2Bytes = 40 * 1024 * 1024;
+  int64_t l2LineBytes = 128;
+  int64_t l2Ways = 16;
+  // fp32 peak without tensor cores.
+  double peakGFlops = 19500.0;
+  double memBandwidthGBs = 1555.0;
+  double sharedBandwidthGBs = 19400.0;
+  double launchOverheadUs = 5.0;
+  // boost clock of the SMs.
+  double clockGHz = 1.41;
+  // cycles a warp stalls on a __syncthreads() when no other block hides it.
+  double barrierCycles = 20.0;
+  // fitted by the calibration tool: a kernel's modelled ms are mapped to scale * ms + offset.
+  double latencyScale = 1.0;
+  double latencyOffsetUs = 0.0;
+  // the host which runs the functions left on "cpu".
+  double hostGFlops = 100.0;
+  double hostBandwidthGBs = 20.0;
+
+  /// @brief read a JSON object keyed by the member names, the missing keys keep their defaults.
+  /// @param path
+  /// @return false if the file can't be read or isn't a JSON object.
+  bool load(const std::string& path);
+  bool save(const std::string& path) const;
+  /// @brief every member as the JSON object save() writes.
+  std::string toJson() const;
+};
+
+}
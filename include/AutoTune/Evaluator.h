@@ -0,0 +1,115 @@
+#pragma once
+
+#include "AutoTune/DeviceProfile.h"
+#include "IR/IR.h"
+#include "enum.h"
+
+#include <string>
+#include <map>
+#include <vector>
+
+namespace KernelCodeGen {
+
+/// @brief prices a module, the tuner only compares the results so any consistent unit works (ms by default).
+/// evaluate() is called by the tuning workers at the same time, each on a module of its own context.
+struct Evaluator {
+  virtual ~Evaluator() = default;
+  virtual float evaluate(mlir::ModuleOp& module, const DeviceProfile& device) = 0;
+  /// @brief hash of the parameters which change the prices, the incremental cache of the generator keys on it.
+  virtual uint64_t digest() const {
+    return llvm::hash_value(name);
+  }
+  std::string name;
+};
+
+/// @brief static counts of one function, every op is weighted by the trip counts of its enclosing loops.
+struct FuncStats {
+  double flops = 0.0;
+  double globalBytes = 0.0;
+  double sharedBytes = 0.0;
+  // one kernel per outermost affine.parallel, 0 means the function runs on the host.
+  int64_t kernels = 0;
+  // times the function is called by the graph.
+  int64_t calls = 1;
+};
+
+/// @brief cost model over the optimized affine IR, one roofline per function.
+/// kernel time = max(compute, global traffic, shared traffic) + launch overhead.
+struct AnalyticalEvaluator : Evaluator {
+  AnalyticalEvaluator() {
+    this->name = std::move(std::string("Analytical"));
+  }
+  virtual float evaluate(mlir::ModuleOp& module, const DeviceProfile& device) override;
+
+  static std::map<std::string, FuncStats> collectStats(mlir::ModuleOp& module);
+  static FuncStats collectStats(mlir::func::FuncOp func);
+  /// @brief ms of one call of the function.
+  static double funcLatency(const FuncStats& stats, const DeviceProfile& device);
+};
+
+/// @brief static counts of one kernel, an outermost affine.parallel of a function.
+/// flops and bytes are totals of one block, barriers are met by every thread of the block.
+struct KernelStats {
+  std::string symbol;
+  // ranges of the grid level (blockIdx) and of the block level (threadIdx).
+  std::vector<int64_t> grid;
+  std::vector<int64_t> block;
+  int64_t blocks = 1;
+  int64_t threads = 1;
+  double flops = 0.0;
+  double globalBytes = 0.0;
+  double sharedBytes = 0.0;
+  double barriers = 0.0;
+  // static shared memory allocated by one block.
+  int64_t sharedAlloc = 0;
+  // 32 bit registers per thread, see Analyzer::estimateRegisters.
+  int64_t registers = 0;
+  // shared memory wavefronts / conflict free wavefronts, see AccessAnalyzer::bankConflictDegree.
+  double bankConflictDegree = 1.0;
+  // useful global bytes / bytes of the sectors moved, see AccessAnalyzer::sectorEfficiency.
+  double sectorEfficiency = 1.0;
+};
+
+/// @brief roofline model per kernel: the blocks run in waves over the SMs, every wave is bound by
+/// the compute or shared traffic of a SM or by the global traffic of the device, plus the barrier stalls.
+/// Bank conflicts replay the shared traffic and uncoalesced accesses inflate the global traffic.
+/// The device is usually read from a JSON profile, see DeviceProfile::load.
+struct RooflineEvaluator : Evaluator {
+  /// @param traceBlocks blocks run by the MemoryTracer to count the bank conflicts and the sectors,
+  /// 0 keeps the static analysis of the first warp.
+  RooflineEvaluator(int64_t traceBlocks_ = 0) : traceBlocks(traceBlocks_) {
+    this->name = std::move(std::string("Roofline"));
+  }
+  virtual float evaluate(mlir::ModuleOp& module, const DeviceProfile& device) override;
+  virtual uint64_t digest() const override {
+    return llvm::hash_combine(name, traceBlocks);
+  }
+
+  static std::vector<KernelStats> collectKernels(mlir::func::FuncOp func, int64_t traceBlocks = 0);
+  /// @brief ms of one launch of the kernel.
+  static double kernelLatency(const KernelStats& kernel, const DeviceProfile& device);
+
+  int64_t traceBlocks;
+};
+
+/// @brief measures the wall time of the module on the host, for boxes without a GPU.
+/// The module is lowered to LLVM through the ExecutionEngine: affine.parallel runs as serial loops,
+/// barriers are dropped and warp shuffles return their own value. The timing only ranks candidates.
+struct HostEvaluator : Evaluator {
+  HostEvaluator(int repeats_ = 3) : repeats(repeats_) {
+    this->name = std::move(std::string("Host"));
+  }
+  virtual float evaluate(mlir::ModuleOp& module, const DeviceProfile& device) override;
+  virtual uint64_t digest() const override {
+    return llvm::hash_combine(name, repeats);
+  }
+
+  /// @brief a copy of the functions with a bench_{symbol} entry per function, which allocates the arguments, fills
+  /// them with 1.0 or 0 for the integers and indices, calls the function and frees what it allocated.
+  static mlir::ModuleOp buildBenchModule(mlir::ModuleOp& module, std::vector<std::string>& entries);
+  static bool lowerToLLVM(mlir::ModuleOp& module);
+
+  int repeats;
+};
+
+}
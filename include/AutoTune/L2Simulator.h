@@ -0,0 +1,71 @@
+#pragma once
+
+#include "AutoTune/DeviceProfile.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace KernelCodeGen {
+
+struct L2Config {
+  int64_t sizeBytes = 40 * 1024 * 1024;
+  int64_t lineBytes = 128;
+  int64_t ways = 16;
+  // blocks resident on the device at once, they run their k steps side by side.
+  int64_t concurrentBlocks = 108;
+
+  /// @param device
+  /// @param blocksPerSM resident blocks of the kernel per SM, see Analyzer::getOccupancy.
+  static L2Config fromDevice(const DeviceProfile& device, int64_t blocksPerSM = 1);
+};
+
+/// @brief a row major C[m, n] = A[m, k] * B[k, n] cut into blockM x blockN tiles stepping blockK along k.
+struct GemmTiling {
+  int64_t m = 0;
+  int64_t n = 0;
+  int64_t k = 0;
+  int64_t blockM = 128;
+  int64_t blockN = 128;
+  int64_t blockK = 8;
+  int64_t elementBytes = 4;
+  // the GROUP_SIZE_M of the matmul config, 1 launches the tiles in plain row major order.
+  int64_t groupSizeM = 1;
+};
+
+struct L2Stats {
+  int64_t accesses = 0;
+  int64_t hits = 0;
+  int64_t blocks = 0;
+  int64_t simulatedBlocks = 0;
+  int64_t lineBytes = 128;
+
+  double hitRate() const {
+    return accesses ? 1.0 * hits / accesses : 0.0;
+  }
+  // bytes read from DRAM by the simulated blocks.
+  int64_t dramBytes() const {
+    return (accesses - hits) * lineBytes;
+  }
+};
+
+/// @brief replays the global tile footprints of a GEMM through a set associative LRU cache, in the launch
+/// order of the tiles. The co-resident blocks are launched in waves and step through k together, the
+/// writes of C at the end of a block are left out.
+struct L2Simulator {
+  L2Simulator() = default;
+
+  /// @brief (tile row, tile col) of every linear block id. Groups of groupSizeM tile rows are walked
+  /// column by column, so the blocks running together share the tiles of A and B.
+  static std::vector<std::pair<int64_t, int64_t>> rasterize(int64_t gridM, int64_t gridN, int64_t groupSizeM);
+
+  /// @param maxWaves waves simulated at most, 0 simulates every block. The first waves already show
+  /// the reuse of a rasterization for large GEMMs.
+  static L2Stats simulateGemm(const GemmTiling& tiling, const L2Config& l2, int64_t maxWaves = 0);
+
+  /// @brief the same with any launch order of the tiles.
+  static L2Stats simulateGemm(const GemmTiling& tiling, const std::vector<std::pair<int64_t, int64_t>>& order,
+                              const L2Config& l2, int64_t maxWaves = 0);
+};
+
+}
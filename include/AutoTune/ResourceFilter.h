@@ -0,0 +1,44 @@
+#pragma once
+
+#include "AutoTune/SearchSpace.h"
+
+#include <string>
+#include <vector>
+
+namespace KernelCodeGen {
+
+/// @brief resources one block of a kernel needs, estimated from the raw config.
+struct ResourceUsage {
+  int64_t threads = 0;
+  int64_t sharedBytes = 0;
+  // 32 bit registers per thread: the local buffers of the kernel plus addressing.
+  int64_t registers = 0;
+  int64_t blocksPerSM = 0;
+  float occupancy = 0.0f;
+};
+
+/// @brief rejects the configs which can't launch or run below an occupancy floor before any IR is rewritten.
+struct ResourceFilter {
+  ResourceFilter() = default;
+
+  /// @brief estimate the usage of a config, the buffers mirror the allocations of the optimizer.
+  /// @param optName
+  /// @param config
+  /// @param shape FMHA needs the head dim to derive Br/Bc.
+  /// @param device
+  static ResourceUsage estimate(const std::string& optName, const TuneConfig& config, const OpShape& shape,
+                                const DeviceProfile& device);
+
+  /// @brief
+  /// @param usage
+  /// @param device
+  /// @param minOccupancy active warps / max warps of a SM
+  /// @param reason why the config is rejected, may be nullptr.
+  static bool feasible(const ResourceUsage& usage, const DeviceProfile& device, float minOccupancy,
+                       std::string* reason = nullptr);
+
+  static std::vector<TuneConfig> filter(const std::string& optName, const std::vector<TuneConfig>& configs,
+                                        const OpShape& shape, const DeviceProfile& device, float minOccupancy);
+};
+
+}
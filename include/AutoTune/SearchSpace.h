@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Optimizer/Optimizer.h"
+#include "AutoTune/DeviceProfile.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace KernelCodeGen {
+
+using TuneConfig = std::map<std::string, int>;
+
+/// @brief problem sizes of one function, collapsed to the 2D/3D view the optimizer tiles.
+/// Matmul like: m x n x k. Elementwise like: m rows of n elements. LayerNorm: m rows reduced over n.
+/// FMHA: m = sequence length of Q, n = sequence length of K/V, k = head dim.
+struct OpShape {
+  std::string symbol;
+  int64_t m = 1;
+  int64_t n = 1;
+  int64_t k = 1;
+  std::vector<int64_t> batch;
+  int64_t elementBytes = 4;
+  std::string dtype = "f32";
+};
+
+/// @brief the declarative space of one optimizer: candidate values of every knob,
+/// constants shared by all candidates and the constraints a legal config must satisfy.
+struct ParamSpace {
+  using Constraint = std::function<bool(const TuneConfig&, const OpShape&, const DeviceProfile&)>;
+
+  std::vector<std::pair<std::string, std::vector<int>>> params;
+  TuneConfig fixed;
+  std::vector<Constraint> constraints;
+  // rewrite helper knobs to the keys read by the optimizer (e.g. Br -> HdxBr).
+  std::function<void(TuneConfig&, const OpShape&)> finalize;
+  // set knobs a model predicts well on the legal configs instead of searching them (e.g. GROUP_SIZE_M).
+  std::function<void(std::vector<TuneConfig>&, const OpShape&, const DeviceProfile&)> choose;
+
+  bool isLegal(const TuneConfig& config, const OpShape& shape, const DeviceProfile& device) const {
+    for (auto& constraint : constraints) {
+      if (!constraint(config, shape, device)) return false;
+    }
+    return true;
+  }
+};
+
+struct SearchSpace {
+  SearchSpace() = default;
+
+  /// @brief enumerate the legal configs of one shape.
+  static std::vector<TuneConfig> generate(const std::string& optName, const OpShape& shape, const DeviceProfile& device);
+
+  /// @brief collect the shapes of the functions opt can rewrite, opt is re-collected by applicable().
+  static std::vector<OpShape> collectShapes(Optimizer& opt, mlir::ModuleOp& module);
+
+  /// @brief check a finalized config against a shape.
+  static bool isLegal(const std::string& optName, const TuneConfig& config, const OpShape& shape, const DeviceProfile& device);
+
+  /// @brief the declarative space of the optimizer, nullptr if the optimizer has no knobs.
+  static const ParamSpace* getParamSpace(const std::string& optName);
+
+  static ParamSpace matmulSpace();
+  static ParamSpace batchMatmulSpace();
+  static ParamSpace binarySpace();
+  static ParamSpace elementWiseSpace();
+  static ParamSpace gatherSpace();
+  static ParamSpace layerNormSpace();
+  static ParamSpace fmhaSpace();
+};
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "AutoTune/SearchSpace.h"
+
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include <cfloat>
+#include <functional>
+
+namespace KernelCodeGen {
+
+enum class SearchMethod {
+  Exhaustive = 0,
+  Random = 1,
+  Genetic = 2,
+  // a k nearest neighbours surrogate picks the candidates by a lower confidence bound.
+  Surrogate = 3,
+};
+
+/// @brief limits of one search, 0 means unlimited.
+struct TuneBudget {
+  int maxCandidates = 0;
+  double maxSeconds = 0.0;
+};
+
+/// @brief proposes which configs of a space to measure. It is anytime: the best config so far
+/// can be read from another thread while run() is going, and run() stops on the budget.
+class SearchStrategy {
+public:
+  // latency of every config of the batch, FLT_MAX for the configs which can't be applied.
+  using Measure = std::function<std::vector<float>(const std::vector<TuneConfig>&)>;
+
+  virtual ~SearchStrategy() = default;
+
+  /// @brief measure the space by batches until it is exhausted or the budget is spent.
+  /// @param space legal configs
+  /// @param measure
+  /// @param budget
+  /// @param batchSize configs measured together, e.g. the number of tuning workers.
+  /// @param seeds the first configs of the space, measured in order before the strategy proposes any.
+  void run(const std::vector<TuneConfig>& space, const Measure& measure, const TuneBudget& budget, int batchSize = 1,
+           int seeds = 0);
+
+  /// @brief the best config measured so far.
+  /// @return false if no config was valid yet.
+  bool getBest(TuneConfig& config, float& latency) const;
+
+  int getMeasuredNumber() const;
+
+  std::string name;
+
+protected:
+  /// @brief the unmeasured indexes in space to measure next, empty when the strategy is done.
+  virtual std::vector<int> propose(int batchSize) = 0;
+  virtual void reset() {}
+
+  std::vector<TuneConfig> space;
+  // index -> latency of the measured configs.
+  std::map<int, float> measured;
+  std::mt19937 rng{0};
+
+private:
+  mutable std::mutex mutex;
+  int bestIndex = -1;
+  float bestLatency = FLT_MAX;
+};
+
+struct ExhaustiveSearch : SearchStrategy {
+  ExhaustiveSearch() {
+    this->name = std::move(std::string("Exhaustive"));
+  }
+protected:
+  virtual std::vector<int> propose(int batchSize) override;
+  virtual void reset() override { next = 0; }
+  int next = 0;
+};
+
+struct RandomSearch : SearchStrategy {
+  RandomSearch() {
+    this->name = std::move(std::string("Random"));
+  }
+protected:
+  virtual std::vector<int> propose(int batchSize) override;
+  virtual void reset() override;
+  std::vector<int> order;
+  int next = 0;
+};
+
+/// @brief tournament selection, uniform crossover of the knobs and one-knob mutation.
+/// Children which leave the legal space are replaced by random unmeasured configs.
+struct GeneticSearch : SearchStrategy {
+  GeneticSearch(int population_ = 16, float mutation_ = 0.2f) : population(population_), mutation(mutation_) {
+    this->name = std::move(std::string("Genetic"));
+  }
+protected:
+  virtual std::vector<int> propose(int batchSize) override;
+  virtual void reset() override;
+  int select();
+  int randomUnmeasured();
+  int population;
+  float mutation;
+  std::map<TuneConfig, int> indexOf;
+  std::map<std::string, std::vector<int>> knobValues;
+};
+
+/// @brief k nearest neighbours regression on log2 of the knobs, which proposes the unmeasured configs
+/// with the lowest (mean - beta * distance to the measured ones).
+struct SurrogateSearch : SearchStrategy {
+  SurrogateSearch(int warmup_ = 8, int neighbours_ = 3, double beta_ = 0.5)
+    : warmup(warmup_), neighbours(neighbours_), beta(beta_) {
+    this->name = std::move(std::string("Surrogate"));
+  }
+protected:
+  virtual std::vector<int> propose(int batchSize) override;
+  double distance(int x, int y);
+  int warmup;
+  int neighbours;
+  double beta;
+};
+
+std::unique_ptr<SearchStrategy> createSearchStrategy(SearchMethod method);
+
+}
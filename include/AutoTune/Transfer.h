@@ -0,0 +1,40 @@
+#pragma once
+
+#include "AutoTune/TuningDatabase.h"
+
+namespace KernelCodeGen {
+
+enum class TransferMode {
+  Off = 0,
+  // the configs of the nearest tuned shapes are tried first, then the usual search.
+  Seed = 1,
+  // only the configs of the nearest tuned shapes are tried.
+  Replace = 2,
+};
+
+/// @brief reuse the tuning records of similar shapes for a shape missing in the database.
+struct Transfer {
+  Transfer() = default;
+
+  /// @brief the configs of the topK nearest records of the same optimizer, dtype, device and codegen version.
+  /// @param database
+  /// @param key key of the unseen shapes
+  /// @param shapes
+  /// @param device
+  /// @param topK
+  /// @return configs legal for every shape, nearest first.
+  static std::vector<TuneConfig> nearestConfigs(const TuningDatabase& database, const TuningKey& key,
+                                                const std::vector<OpShape>& shapes, const DeviceProfile& device, int topK);
+
+  /// @brief distance of two problems on log2 of (m, n, k, batch) and of the arithmetic intensity.
+  static double distance(const TuningRecord& record, const OpShape& shape);
+
+  /// @brief flops per byte of a m x n x k problem, the elementwise like ops have k = 1.
+  static double intensity(int64_t m, int64_t n, int64_t k, int64_t batch, int64_t elementBytes);
+
+  /// @brief rescale the knobs which are derived from the shape, e.g. HdxBr of FMHA.
+  static TuneConfig adapt(const std::string& optName, const TuneConfig& config, const TuningRecord& record,
+                          const OpShape& shape);
+};
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "AutoTune/SearchSpace.h"
+
+#include "llvm/ADT/StringRef.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cfloat>
+
+namespace llvm {
+class MemoryBuffer;
+}
+
+namespace KernelCodeGen {
+
+/// @brief bump it whenever an optimizer rewrites its kernels differently, old records are ignored then.
+static const int codegenVersion = 1;
+
+struct TuningKey {
+  std::string optimizer;
+  // symbol of the tuned function, e.g. Matmul_m2048n2048k1024; several are joined by ','.
+  std::string symbol;
+  std::string dtype;
+  std::string device;
+  int version = codegenVersion;
+
+  std::string str() const;
+  static bool parse(const std::string& str, TuningKey& key);
+};
+
+struct TuningRecord {
+  TuneConfig config;
+  float latency = FLT_MAX;
+  // shape of the first tuned function, used to find neighbours of unseen shapes.
+  int64_t m = 1;
+  int64_t n = 1;
+  int64_t k = 1;
+  int64_t batch = 1;
+};
+
+/// @brief append only record store. The file is a magic header followed by records:
+///   u32 keyLen | key | u32 configLen | config "K=v;K=v" | f32 latency | i64 m, n, k, batch
+/// all little endian. A later record of the same key overrides the earlier one.
+/// The file stays mapped while the database is open: the index points at the records in the mapping and a record
+/// is decoded when it is looked up, only the records appended since open() are kept in memory.
+class TuningDatabase {
+public:
+  TuningDatabase();
+  ~TuningDatabase();
+
+  /// @brief map the file and index its records, a missing or empty file is created on the first record.
+  /// Records which can't be parsed are skipped, a partial record at the end is cut off by the first record().
+  /// @param path
+  /// @return false if the file exists but is not a tuning database.
+  bool open(const std::string& path);
+
+  bool lookup(const TuningKey& key, TuningRecord& record) const;
+
+  /// @brief insert a record and append it to the file.
+  void record(const TuningKey& key, const TuningRecord& record);
+
+  /// @brief decode every record, the latest one of each key.
+  void forEachRecord(const std::function<void(const std::string& key, const TuningRecord& record)>& fn) const;
+
+  /// @brief the device of the key is its name and a digest of the whole profile and the evaluator, so a recalibrated
+  /// profile or another evaluator doesn't hit the winners picked under the old ones.
+  /// @param evaluatorDigest see Evaluator::digest.
+  static TuningKey makeKey(const std::string& optName, const std::vector<OpShape>& shapes, const DeviceProfile& device,
+                           uint64_t evaluatorDigest);
+  static std::string serialize(const TuneConfig& config);
+  /// @return false if an item is no "K=v" with an integer v.
+  static bool deserialize(llvm::StringRef str, TuneConfig& config);
+
+private:
+  // decodes the record whose config length starts at data, the index only holds records which decode.
+  static bool decode(const char* data, const char* end, TuningRecord& record);
+
+  std::string path;
+  std::unique_ptr<llvm::MemoryBuffer> mapped;
+  // key in the mapping -> its config length in the mapping.
+  std::map<llvm::StringRef, const char*> index;
+  std::map<std::string, TuningRecord> appended;
+  // the size the file is cut back to before the next append, -1 if it ends in a whole record.
+  int64_t validSize = -1;
+};
+
+}
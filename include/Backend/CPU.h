@@ -0,0 +1,22 @@
+#pragma once
+#include "IR/IR.h"
+
+namespace KernelCodeGen {
+
+enum class CPUParallel {
+  // a static OpenMP loop over the blocks, for grids whose blocks cost the same.
+  OpenMP = 0,
+  // chunks of kcg_parallel_for (Backend/CPURuntime.h), for uneven blocks like the causal ones of FMHA.
+  WorkStealing = 1,
+};
+
+/// @brief portable C++ of the kernels CUDAGen emits, with the same names and in the same order.
+/// The blocks of the grid level affine.parallel are the iterations of an OpenMP parallel loop or the chunks of the
+/// work stealing runtime. Within a block the threads are loop nests, one per stretch between two gpu.barrier, so
+/// every thread finishes a stretch before any thread starts the next one; the shared buffers are stack tiles of the
+/// block. The values and the local buffers a thread carries across a barrier get one copy per thread.
+/// @param parallel how the blocks of a grid are run.
+/// @param grain blocks per chunk of the work stealing runtime, 0 lets the runtime pick.
+std::string CPUGen(mlir::ModuleOp &module, CPUParallel parallel = CPUParallel::OpenMP, int64_t grain = 0);
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The C API the code of CPUGen calls in the work stealing mode. It depends on nothing but the standard library,
+// so CPURuntime.cc can be compiled with the generated kernels as well as linked from kcg_runtime.
+extern "C" {
+
+typedef void (*kcg_range_fn)(int64_t begin, int64_t end, void* context);
+
+/// @brief counters of a worker since the pool started or the last reset, the last worker stands for the
+/// threads outside the pool which wait for their ranges.
+typedef struct {
+  uint64_t busyNs;
+  uint64_t idleNs;
+  uint64_t chunks;
+  uint64_t steals;
+} kcg_worker_stats;
+
+/// @brief run fn over [begin, end) in chunks of at most grain iterations, returns when all of them ran.
+/// @param grain 0 picks about 8 chunks per worker.
+void kcg_parallel_for(int64_t begin, int64_t end, int64_t grain, kcg_range_fn fn, void* context);
+
+/// @brief restart the shared pool with the given number of workers, 0 uses KCG_NUM_THREADS or all hardware threads.
+/// Must not run concurrently with kcg_parallel_for.
+void kcg_runtime_set_threads(int threads);
+int kcg_runtime_num_threads();
+
+/// @return the number of entries written, at most capacity.
+int kcg_runtime_stats(kcg_worker_stats* stats, int capacity);
+void kcg_runtime_reset_stats();
+
+}
+
+namespace KernelCodeGen {
+
+/// @brief a thread pool whose workers own a deque of ranges each. A worker splits the range it takes in halves
+/// until it is down to the grain, pushing the upper halves to the back of its deque and running the rest; it pops
+/// from the back, so it stays on the data it just touched, and when its deque is empty it steals from the front
+/// of a random victim, where the biggest ranges are. Uneven blocks, like the causal blocks of FMHA or the tails
+/// of Rewriter::irregularMat, are balanced by the thieves instead of the static OpenMP chunks.
+/// The caller of parallelFor helps with the ranges until its own are done, so nested calls don't deadlock.
+class WorkStealingPool {
+public:
+  /// @param threads 0 uses KCG_NUM_THREADS or all hardware threads.
+  explicit WorkStealingPool(int threads = 0);
+  ~WorkStealingPool();
+
+  void parallelFor(int64_t begin, int64_t end, int64_t grain, kcg_range_fn fn, void* context);
+
+  /// @brief the workers plus the calling thread.
+  int getThreads() const {
+    return workers.size();
+  }
+
+  /// @brief one entry per worker, then one for the threads outside the pool.
+  std::vector<kcg_worker_stats> getStats() const;
+  void resetStats();
+
+  /// @brief the pool of the C API, created by the first call.
+  static WorkStealingPool& global();
+  static void resetGlobal(int threads);
+
+private:
+  struct Job {
+    kcg_range_fn fn;
+    void* context;
+    int64_t grain;
+    std::atomic<int64_t> remaining;
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false;
+  };
+  struct Range {
+    std::shared_ptr<Job> job;
+    int64_t begin;
+    int64_t end;
+  };
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Range> ranges;
+    std::atomic<uint64_t> busyNs{0};
+    std::atomic<uint64_t> idleNs{0};
+    std::atomic<uint64_t> chunks{0};
+    std::atomic<uint64_t> steals{0};
+    uint64_t seed;
+  };
+
+  void run(int id);
+  void push(int id, Range range);
+  bool pop(int id, Range& range);
+  bool steal(int id, Range& range);
+  bool take(int id, Range& range) {
+    return pop(id, range) || steal(id, range);
+  }
+  // splits the range down to the grain and runs the rest, the halves go to the deque of the worker.
+  void execute(int id, Range range);
+  // the slot of the calling thread: its worker, or the shared slot of the outside threads.
+  int slot() const;
+
+  // the workers, then the slot of the outside threads.
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+  std::atomic<int64_t> queued{0};
+  std::atomic<int> sleeping{0};
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+  bool stopping = false;
+};
+
+}
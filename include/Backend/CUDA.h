@@ -1,8 +1,11 @@
 #pragma once
 #include "IR/IR.h"
+#include "AutoTune/DeviceProfile.h"
 
 namespace KernelCodeGen {
 
-std::string CUDAGen(mlir::ModuleOp &module);
+/// @param device the target, its register file bounds the blocks in __launch_bounds__. nullptr only bounds the
+/// threads per block.
+std::string CUDAGen(mlir::ModuleOp &module, const DeviceProfile* device = nullptr);
 
 }
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+#include "IR/IR.h"
+#include "Backend/HostJIT.h"
+#include "Backend/CPURuntime.h"
+
+#include <string>
+#include <vector>
+
+namespace KernelCodeGen {
+
+/// @brief a module level func.call of the graph.
+struct GraphNode {
+  std::string symbol;
+  // the buffer of every operand and result, a result which returns an operand shares its buffer.
+  std::vector<int> args;
+  std::vector<int> results;
+  // the calls this one waits for: the last writer of every buffer it touches, and the readers of the buffers it
+  // writes since their last writer.
+  std::vector<int> deps;
+  std::vector<int> users;
+};
+
+/// @brief the timeline of one GraphExecutor::run, in ms since its start.
+struct GraphReport {
+  struct NodeTime {
+    std::string symbol;
+    double startMs = 0.0;
+    double endMs = 0.0;
+  };
+
+  /// @brief the available parallelism, the speedup of the run with unlimited threads.
+  double parallelism() const {
+    return criticalPathMs > 0.0 ? workMs / criticalPathMs : 1.0;
+  }
+
+  std::string toJson() const;
+
+  std::vector<NodeTime> nodes;
+  double wallMs = 0.0;
+  // the sum of the calls, what a run in program order takes.
+  double workMs = 0.0;
+  // the longest chain of dependent calls by their measured time, no schedule runs faster.
+  double criticalPathMs = 0.0;
+  // nodes of the longest chain, first to last.
+  std::vector<int> criticalPath;
+};
+
+/// @brief runs the call graph of a ComputeDAG module on the host with the calls as tasks.
+/// build() turns the module level PlaceHolders and call results into buffers and links every call to the calls
+/// it depends on through them; a callee writes an operand if it stores to its argument. run() starts the calls
+/// without deps on a WorkStealingPool, and every call that finishes starts the users it was the last dep of, so
+/// independent branches like the Q/K/V projections overlap instead of running in program order.
+class GraphExecutor {
+public:
+  /// @param pool nullptr runs on the shared pool of the CPU kernels, WorkStealingPool::global().
+  explicit GraphExecutor(HostJIT& jit_, WorkStealingPool* pool_ = nullptr) : jit(jit_), pool(pool_) {}
+
+  /// @brief collect the calls of the module, the callees run the code the JIT compiles from this module.
+  /// @return false if a callee doesn't run on the host or an operand isn't a static memref of the graph.
+  bool build(mlir::ModuleOp module);
+
+  /// @brief false runs the calls one by one in program order, to compare against.
+  void setConcurrent(bool enable) {
+    concurrent = enable;
+  }
+
+  const std::vector<GraphNode>& getNodes() const {
+    return nodes;
+  }
+
+  /// @brief the PlaceHolders no call writes, in module order.
+  std::vector<std::vector<int64_t>> getInputShapes() const;
+  /// @brief the results no later call reads, in program order.
+  std::vector<std::vector<int64_t>> getOutputShapes() const;
+
+  /// @param inputs one buffer per input, see getInputShapes.
+  /// @param outputs one buffer per output allocated by the caller, see getOutputShapes.
+  /// @param report filled with the timeline of the calls if not null.
+  /// @return false if the buffers don't match or a call fails, the outputs are undefined then.
+  bool run(const std::vector<HostBuffer>& inputs, std::vector<HostBuffer>& outputs, GraphReport* report = nullptr);
+
+private:
+  struct Buffer {
+    std::vector<int64_t> shape;
+    int64_t elementBytes;
+  };
+  struct RunState;
+  struct Batch;
+
+  bool callNode(RunState& state, int id);
+  // calls the node, then the users it was the last dep of.
+  void runNode(RunState& state, int id);
+  static void runBatch(int64_t begin, int64_t end, void* context);
+
+  HostJIT& jit;
+  WorkStealingPool* pool;
+  bool concurrent = true;
+  std::vector<GraphNode> nodes;
+  std::vector<Buffer> buffers;
+  std::vector<int> inputs;
+  std::vector<int> outputs;
+};
+
+}
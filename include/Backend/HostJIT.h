@@ -0,0 +1,82 @@
+#pragma once
+#include "IR/IR.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class TargetMachine;
+}
+
+namespace KernelCodeGen {
+
+/// @brief a row major host buffer bound to a memref argument or result of a jitted function.
+struct HostBuffer {
+  void* data = nullptr;
+  std::vector<int64_t> shape;
+};
+
+/// @brief the memrefs a jitted function takes and returns.
+struct HostSignature {
+  std::vector<std::vector<int64_t>> argShapes;
+  std::vector<std::vector<int64_t>> resultShapes;
+  std::vector<int64_t> argElementBytes;
+  std::vector<int64_t> resultElementBytes;
+};
+
+/// @brief runs the functions the frontend tagged func.state = "cpu" on the host.
+/// compile() lowers the affine/memref/arith/math IR of those functions to LLVM like HostEvaluator and JITs it
+/// through the ExecutionEngine, once per distinct set of functions: every compile() points the symbols at the code
+/// of the given module, a module compiled before reuses its engine. call() passes the host buffers as memref descriptors and copies the memrefs the function returns
+/// into the result buffers, the memory the function allocated for them is freed.
+class HostJIT {
+public:
+  HostJIT(int optLevel_ = 3) : optLevel(optLevel_) {}
+  ~HostJIT();
+
+  /// @brief compile the "cpu" functions of the module, the module level graph ops are ignored.
+  /// The symbols of the module call its code afterwards, even if another module compiled them before.
+  /// @return false if nothing could be compiled.
+  bool compile(mlir::ModuleOp module);
+
+  bool has(const std::string& symbol);
+  const HostSignature* getSignature(const std::string& symbol);
+
+  /// @param args one buffer per memref argument
+  /// @param results one buffer per returned memref, allocated by the caller (see getSignature).
+  bool call(const std::string& symbol, const std::vector<HostBuffer>& args, std::vector<HostBuffer>& results);
+
+  /// @brief ms of one call without the copy of the results, the best of the repeats after a warm up run.
+  /// @return -1 if the function can't run.
+  float measure(const std::string& symbol, const std::vector<HostBuffer>& args, int repeats = 3);
+
+private:
+  struct Entry {
+    void (*packed)(void**) = nullptr;
+    HostSignature signature;
+  };
+  struct Compiled {
+    std::unique_ptr<llvm::TargetMachine> targetMachine;
+    std::unique_ptr<mlir::ExecutionEngine> engine;
+    // the entry points of the engine, copied to entries when the module is compiled again.
+    std::map<std::string, Entry> entries;
+  };
+
+  const Entry* lookup(const std::string& symbol);
+  // runs the function, the descriptors of the returned memrefs are left in resultDescriptors.
+  static bool invoke(const Entry& entry, const std::vector<HostBuffer>& args, std::vector<int64_t>& resultDescriptors);
+  // frees the memrefs the function returned, unless they alias an argument.
+  static void release(const Entry& entry, const std::vector<HostBuffer>& args,
+                      const std::vector<int64_t>& resultDescriptors);
+
+  int optLevel;
+  // digest of the compiled functions -> engine, the engines own the code of the entries.
+  std::map<uint64_t, Compiled> engines;
+  std::map<std::string, Entry> entries;
+  std::mutex mutex;
+};
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "IR/IR.h"
+#include "AutoTune/DeviceProfile.h"
+#include "AutoTune/TuningDatabase.h"
+
+#include <map>
+#include <string>
+
+namespace KernelCodeGen {
+
+/// @brief a JSON report of the kernels CUDAGen emits for the module, with the same names and in the same order.
+/// Every kernel lists its source function, launch dims (x, y, z), resources, static counts, the roofline
+/// prediction and the config its function was tuned with.
+/// @param module
+/// @param device
+/// @param tuned the records of the tuned functions by symbol, see KernelCodeGenerator::getTunedFunctions.
+std::string KernelReportGen(mlir::ModuleOp& module, const DeviceProfile& device,
+                            const std::map<std::string, TuningRecord>& tuned = {});
+
+}
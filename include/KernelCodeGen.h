@@ -3,6 +3,19 @@
 #include "Frontend/Operators.h"
 #include "Optimizer/Optimizer.h"
 #include "Backend/CUDA.h"
+#include "Backend/CPU.h"
+#include "Backend/HostJIT.h"
+#include "Backend/GraphExecutor.h"
+#include "Backend/KernelReport.h"
+#include "AutoTune/SearchSpace.h"
+#include "AutoTune/TuningDatabase.h"
+#include "AutoTune/Transfer.h"
+#include "AutoTune/Evaluator.h"
+#include "AutoTune/CostModel.h"
+#include "AutoTune/SearchStrategy.h"
+#include "AutoTune/ResourceFilter.h"
+#include "Optimizer/AccessAnalyzer.h"
+#include "Optimizer/MemoryTracer.h"
 #include "log.h"
 
 // #include "ComputeDAG.h"
@@ -20,6 +33,10 @@
 #include <climits>
 #include <cfloat>
 
+namespace llvm {
+class ThreadPool;
+}
+
 namespace KernelCodeGen {
 
 class KernelCodeGenerator {
@@ -60,21 +77,28 @@ public:
   KernelCodeGenerator() = delete;
 
   void initMLIRContext() {
-    // context.getOrLoadDialect<mlir::compute_dag::ComputeDAGDialect>();
-    // context.getOrLoadDialect<mlir::schedule::ScheduleDialect>();
-    context.getOrLoadDialect<mlir::AffineDialect>();
-    context.getOrLoadDialect<mlir::memref::MemRefDialect>();
-    context.getOrLoadDialect<mlir::func::FuncDialect>();
-    context.getOrLoadDialect<mlir::arith::ArithmeticDialect>();
-    context.getOrLoadDialect<mlir::gpu::GPUDialect>();
-    context.getOrLoadDialect<mlir::vector::VectorDialect>();
-    context.getOrLoadDialect<mlir::scf::SCFDialect>();
-    context.getOrLoadDialect<mlir::math::MathDialect>();
+    loadDialects(context);
     mlir::registerAllPasses();
   }
 
+  static void loadDialects(mlir::MLIRContext& context_) {
+    // context_.getOrLoadDialect<mlir::compute_dag::ComputeDAGDialect>();
+    // context_.getOrLoadDialect<mlir::schedule::ScheduleDialect>();
+    context_.getOrLoadDialect<mlir::AffineDialect>();
+    context_.getOrLoadDialect<mlir::memref::MemRefDialect>();
+    context_.getOrLoadDialect<mlir::func::FuncDialect>();
+    context_.getOrLoadDialect<mlir::arith::ArithmeticDialect>();
+    context_.getOrLoadDialect<mlir::gpu::GPUDialect>();
+    context_.getOrLoadDialect<mlir::vector::VectorDialect>();
+    context_.getOrLoadDialect<mlir::scf::SCFDialect>();
+    context_.getOrLoadDialect<mlir::math::MathDialect>();
+  }
+
   ComputeDAG& createGraph(const std::string& graphName) {
     minLatency = FLT_MAX;
+    // runOnHost and runGraph take the optimized module over the graph, the one of the last graph is stale.
+    bestModule = nullptr;
+    hostModule = nullptr;
     graph.module = mlir::ModuleOp::create(builder.getUnknownLoc(), mlir::Optional<mlir::StringRef>(std::move(graphName)));
     graph.builder.setInsertionPointToEnd(graph.module.getBody());
     return graph;
@@ -114,31 +138,196 @@ public:
     return;
   }
 
-  void resetModule(mlir::ModuleOp& module) {
+  /// @brief replace the module by a copy of the backup, the replaced module is erased unless it is keep.
+  void resetModule(mlir::ModuleOp& module, mlir::ModuleOp keep = {}) {
     mlir::Operation *cloned = backupModule_->clone();
+    if (module && module != keep) module->erase();
     module = mlir::dyn_cast<mlir::ModuleOp>(cloned);   
   }
 
   void backupModule(mlir::ModuleOp& module) {
     mlir::Operation *cloned = module->clone();
+    eraseBackup();
     backupModule_ = mlir::dyn_cast<mlir::ModuleOp>(cloned);
   }
 
+  void eraseBackup() {
+    if (backupModule_) backupModule_->erase();
+    backupModule_ = nullptr;
+  }
+
   void saveBestModule(mlir::ModuleOp& module) {
     mlir::Operation *cloned = module->clone();
-    bestModule = mlir::dyn_cast<mlir::ModuleOp>(cloned);    
+    bestModule = mlir::dyn_cast<mlir::ModuleOp>(cloned);
+    // the host code of the old module is stale, runOnHost compiles the new one.
+    hostModule = nullptr;
   }
 
   mlir::ModuleOp& optimize(ComputeDAG& graph_);
 
   float evaluate(mlir::ModuleOp& module) {
-    return 0.0f;
+    return evaluator->evaluate(module, device);
+  }
+
+  /// @brief the evaluator which prices the candidates, the roofline model by default.
+  /// A LearnedEvaluator ranks them on a box without a GPU, a RecordingEvaluator around a measuring one collects its corpus.
+  /// @param evaluator_ must be safe to call from several tuning workers at once.
+  void setEvaluator(std::unique_ptr<Evaluator> evaluator_) {
+    evaluator = std::move(evaluator_);
+  }
+
+  /// @brief number of workers used to evaluate the candidates of one optimizer.
+  /// @param threads 1 keeps the serial search, 0 uses all hardware threads.
+  void setTuneThreads(int threads) {
+    tuneThreads = threads;
+  }
+
+  /// @brief replace the default configs the optimizer tries.
+  /// @return false if the generator keeps no configs for the optimizer.
+  bool setConfigs(Optimizer& opt, const std::vector<std::map<std::string, int>>& configs) {
+    auto target = getConfigs(opt);
+    if (target == nullptr) return false;
+    *target = configs;
+    return true;
+  }
+
+  /// @brief replace the default configs by the legal configs generated for the shapes in the module.
+  /// @param enable 
+  void useSearchSpace(bool enable) {
+    searchSpace = enable;
+  }
+
+  void setDeviceProfile(const DeviceProfile& device_) {
+    device = device_;
+  }
+
+  /// @brief read the device from a JSON profile, the keys are the members of DeviceProfile.
+  /// @return false if the profile can't be read, the device is left unchanged then.
+  bool setDeviceProfile(const std::string& path) {
+    DeviceProfile profile = device;
+    if (!profile.load(path)) return false;
+    device = profile;
+    return true;
+  }
+
+  /// @brief reuse and record the tuned configs in a database file.
+  /// @param path 
+  /// @return false if the file can't be used, tuning runs without the database then.
+  bool setTuningDatabase(const std::string& path) {
+    database = std::make_unique<TuningDatabase>();
+    if (!database->open(path)) {
+      database.reset();
+      return false;
+    }
+    return true;
+  }
+
+  /// @brief for shapes missing in the tuning database, try the configs of the nearest tuned shapes.
+  /// @param mode Seed tries them before the search, Replace tries only them.
+  /// @param topK number of neighbours
+  void setTransferMode(TransferMode mode, int topK = 3) {
+    transferMode = mode;
+    transferTopK = topK;
+  }
+
+  /// @brief how the configs of a function are explored and when the search stops.
+  /// @param method 
+  /// @param budget candidates or seconds per function, unlimited by default.
+  void setSearchStrategy(SearchMethod method, TuneBudget budget = {}) {
+    searchMethod = method;
+    tuneBudget = budget;
+  }
+
+  /// @brief configs whose estimated occupancy is below the floor are not tried, and the kernels
+  /// whose registers estimated from the IR exceed the device or drop the occupancy below the floor are rejected.
+  /// @param occupancy active warps / max warps of a SM, 0 by default, which only rejects the configs which can't launch.
+  void setOccupancyFloor(float occupancy) {
+    minOccupancy = occupancy;
+  }
+
+  /// @brief reject the candidates whose shared memory accesses replay more than the given degree.
+  /// @param degree wavefronts / conflict free wavefronts of the worst kernel, 0 keeps every layout.
+  void setMaxBankConflict(double degree) {
+    maxBankConflict = degree;
+  }
+
+  /// @brief the best config of the function being tuned, callable from another thread while optimize() runs.
+  /// @return false if nothing valid was measured yet, or no function is being tuned.
+  bool getBestSoFar(std::map<std::string, int>& config, float& latency) {
+    std::lock_guard<std::mutex> lock(searchMutex);
+    if (!activeSearch) return false;
+    return activeSearch->getBest(config, latency);
+  }
+
+  /// @brief reuse the optimized functions of the previous optimize() calls whose body, symbol and configs
+  /// are unchanged, so an edit of the graph only rewrites the functions it touches.
+  /// @param enable on by default
+  void setIncremental(bool enable) {
+    incremental = enable;
+  }
+
+  void clearFunctionCache() {
+    functionCache.clear();
+  }
+
+  /// @brief symbols of the functions taken from the cache in the last optimize().
+  const std::set<std::string>& getReusedFunctions() {
+    return reusedFunctions;
+  }
+
+  /// @brief the winning config and latency of every tuned function in the last optimize().
+  const std::map<std::string, TuningRecord>& getTunedFunctions() {
+    return tunedFunctions;
   }
 
   std::string codegen(mlir::ModuleOp module) {
     if (platform == "CUDA") {
-      return std::move(CUDAGen(module));
+      return std::move(CUDAGen(module, &device));
+    }
+    if (platform == "CPU") {
+      return std::move(CPUGen(module, cpuParallel, cpuGrain));
     }
+    llvm::errs() << "Unknown platform \"" << platform << "\", no source is generated\n";
+    return "";
+  }
+
+  /// @brief how the CPU kernels run their blocks, the work stealing mode links against Backend/CPURuntime.
+  /// @param grain blocks per chunk, 0 lets the runtime pick.
+  void setCPUParallel(CPUParallel parallel, int64_t grain = 0) {
+    cpuParallel = parallel;
+    cpuGrain = grain;
+  }
+
+  /// @brief the JSON report of the kernels codegen() emits for the module, save() writes it next to the source.
+  std::string report(mlir::ModuleOp module) {
+    return KernelReportGen(module, device, tunedFunctions);
+  }
+
+  /// @brief run a "cpu" function of the graph on the host, the graph is compiled by the first call which misses it.
+  /// After optimize() the optimized module is compiled again by the next call, with the CpuMatmulOptimizer blocking.
+  /// @param args one buffer per memref argument
+  /// @param results one buffer per returned memref, see HostJIT::getSignature.
+  bool runOnHost(const std::string& symbol, const std::vector<HostBuffer>& args, std::vector<HostBuffer>& results) {
+    auto module = bestModule ? bestModule : graph.module;
+    if (module != hostModule || !hostJIT.has(symbol)) {
+      if (!hostJIT.compile(module)) return false;
+      hostModule = module;
+    }
+    return hostJIT.call(symbol, args, results);
+  }
+
+  /// @brief run the calls of the graph on the host, the independent ones at the same time on the shared pool.
+  /// Build a GraphExecutor on getHostJIT() for the shapes of the inputs and outputs.
+  /// @param report the critical path against the total work of the calls, if not null.
+  bool runGraph(const std::vector<HostBuffer>& inputs, std::vector<HostBuffer>& outputs,
+                GraphReport* report = nullptr) {
+    GraphExecutor executor(hostJIT);
+    auto module = bestModule ? bestModule : graph.module;
+    return executor.build(module) && executor.run(inputs, outputs, report);
+  }
+
+  HostJIT& getHostJIT() {
+    return hostJIT;
   }
 
   void setLogMode(Log level) {
@@ -148,6 +337,33 @@ public:
   std::vector<std::unique_ptr<Optimizer>> opts;
 
 private:
+  // A tuned candidate, the module is kept as text to move it across contexts.
+  struct Candidate {
+    std::map<std::string, int> config;
+    float latency = FLT_MAX;
+    std::string moduleText;
+    bool valid = false;
+  };
+
+  std::vector<std::map<std::string, int>>* getConfigs(Optimizer& opt);
+  Candidate tuneCandidate(const std::string& optName, const std::set<std::string>& targets,
+                          const std::map<std::string, int>& config, const std::string& moduleText);
+  std::vector<Candidate> tuneParallel(Optimizer& opt, const std::vector<std::map<std::string, int>>& configs, 
+                                      mlir::ModuleOp& module, llvm::ThreadPool& pool);
+  bool tuneFunction(Optimizer& opt, const OpShape& shape, const std::vector<std::map<std::string, int>>& defaults,
+                    mlir::ModuleOp& module, TuningRecord& winner);
+  // rejects the kernels of the targets which conflict too much, spill or starve the SMs.
+  bool acceptKernels(mlir::ModuleOp& module, const std::set<std::string>& targets);
+  // hash of everything besides the function which changes the result of optimize().
+  uint64_t configDigest();
+
+  // An optimized function, detached from any module.
+  struct CachedFunction {
+    mlir::OwningOpRef<mlir::func::FuncOp> funcOp;
+    bool tuned = false;
+    TuningRecord record;
+  };
+
   mlir::MLIRContext context;
   mlir::OpBuilder builder;
   mlir::ModuleOp backupModule_;
@@ -155,6 +371,29 @@ private:
   ComputeDAG graph;
   std::string platform;
   float minLatency = FLT_MAX;
+  int tuneThreads = 1;
+  bool searchSpace = false;
+  DeviceProfile device;
+  std::unique_ptr<Evaluator> evaluator = std::make_unique<RooflineEvaluator>();
+  std::unique_ptr<TuningDatabase> database;
+  HostJIT hostJIT;
+  // the module the entries of hostJIT were last compiled from.
+  mlir::ModuleOp hostModule;
+  CPUParallel cpuParallel = CPUParallel::OpenMP;
+  int64_t cpuGrain = 0;
+  TransferMode transferMode = TransferMode::Off;
+  int transferTopK = 3;
+  std::map<std::string, TuningRecord> tunedFunctions;
+  SearchMethod searchMethod = SearchMethod::Exhaustive;
+  TuneBudget tuneBudget;
+  float minOccupancy = 0.0f;
+  double maxBankConflict = 0.0;
+  std::shared_ptr<SearchStrategy> activeSearch;
+  std::mutex searchMutex;
+  bool incremental = true;
+  // content hash of the function before optimize() -> its optimized form.
+  std::map<uint64_t, CachedFunction> functionCache;
+  std::set<std::string> reusedFunctions;
   std::vector<std::map<std::string, int>> matmulConfigs;
   std::vector<std::map<std::string, int>> fmhaConfigs;
   std::vector<std::map<std::string, int>> binaryConfigs;
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "IR/IR.h"
+#include "enum.h"
+
+#include <vector>
+
+namespace KernelCodeGen {
+
+/// @brief one load or store of a kernel, evaluated for the lanes of the first warp of the first block.
+/// The loops sit at their first iteration, so only the lane dependent part of the address is meaningful.
+struct WarpAccess {
+  mlir::Operation* op = nullptr;
+  MemorySpace space = MemorySpace::global;
+  bool isStore = false;
+  int64_t bytesPerLane = 0;
+  // byte offset in the buffer of every lane, the warp may be narrower than warpSize.
+  std::vector<int64_t> addresses;
+  // false if an index depends on a value which isn't affine in the ivs, the addresses are empty then.
+  bool analyzable = true;
+  // times the access runs per thread.
+  double times = 1.0;
+};
+
+/// @brief shared memory wavefronts of one warp-wide access.
+struct BankConflict {
+  mlir::Operation* op = nullptr;
+  // wavefronts the access takes and the wavefronts of a conflict free access of the same width.
+  int64_t wavefronts = 1;
+  int64_t idealWavefronts = 1;
+  double times = 1.0;
+
+  double degree() const {
+    return idealWavefronts ? 1.0 * wavefronts / idealWavefronts : 1.0;
+  }
+};
+
+/// @brief global memory transactions of one warp-wide access.
+struct Coalescing {
+  mlir::Operation* op = nullptr;
+  // distinct bytes the lanes ask for.
+  int64_t usefulBytes = 0;
+  // 32, 64 and 128 bytes aligned segments touched by the warp.
+  int64_t sectors = 0;
+  int64_t segments64 = 0;
+  int64_t segments128 = 0;
+  double times = 1.0;
+
+  double efficiency() const {
+    return sectors ? 1.0 * usefulBytes / (sectors * 32) : 1.0;
+  }
+};
+
+/// @brief the memref, index map and value of a load or store, plain memref indices get an identity map.
+struct AccessOperands {
+  mlir::Value memref;
+  mlir::AffineMap map;
+  llvm::SmallVector<mlir::Value> operands;
+  mlir::Type valueType;
+  bool isStore = false;
+};
+
+struct AccessAnalyzer {
+  AccessAnalyzer() = default;
+
+  /// @brief evaluate an affine expression on constant dims and symbols.
+  /// @return false for a division by 0.
+  static bool evalExpr(mlir::AffineExpr expr, const std::vector<int64_t>& dims, const std::vector<int64_t>& symbols,
+                       int64_t& result);
+
+  /// @return false if the op isn't an affine or memref load or store.
+  static bool getAccessOperands(mlir::Operation* op, AccessOperands& access);
+
+  /// @brief the memory accesses under a grid level affine.parallel, the ivs of the nested
+  /// affine.parallel are threadIdx with the last iv as the fastest dim.
+  static std::vector<WarpAccess> collectAccesses(mlir::AffineParallelOp gridLevel, int64_t warpSize = 32);
+
+  /// @brief a warp accesses 128 bits per lane at most in one wavefront: 8 bytes accesses are split
+  /// into half warps and 16 bytes accesses into quarter warps. Lanes reading the same word are a broadcast.
+  static BankConflict bankConflict(const WarpAccess& access, int64_t banks = 32, int64_t bankBytes = 4);
+
+  /// @brief the conflicts of every analyzable shared memory access of the kernel.
+  static std::vector<BankConflict> bankConflicts(mlir::AffineParallelOp gridLevel, int64_t warpSize = 32);
+
+  /// @brief wavefronts / ideal wavefronts, weighted by how often the accesses run. 1 is conflict free.
+  static double bankConflictDegree(const std::vector<BankConflict>& conflicts);
+
+  /// @brief the buffers are taken as 128 bytes aligned.
+  static Coalescing coalescing(const WarpAccess& access);
+
+  /// @brief the transactions of every analyzable global memory access of the kernel.
+  static std::vector<Coalescing> coalescings(mlir::AffineParallelOp gridLevel, int64_t warpSize = 32);
+
+  /// @brief useful bytes / bytes of the sectors, weighted by how often the accesses run. 1 is fully coalesced.
+  static double sectorEfficiency(const std::vector<Coalescing>& coalescings);
+
+  /// @brief print the transactions or wavefronts of every access of the kernel.
+  static void dump(mlir::AffineParallelOp gridLevel, llvm::raw_ostream& os, int64_t warpSize = 32);
+};
+
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "IR/IR.h"
+#include "AutoTune/DeviceProfile.h"
+#include "enum.h"
 
 #include <vector>
 
@@ -39,6 +41,39 @@ struct CompareFuncCall {
   }
 };
 
+/// @brief 32 bit registers of one thread of a kernel, estimated from the optimized IR.
+struct RegisterUsage {
+  // local buffers like tileC, fragA and fragB, which live in registers when the loops over them are unrolled.
+  int64_t arrays = 0;
+  // results of the loops marked to unroll, all copies of the body are taken as live together.
+  int64_t temporaries = 0;
+  // indices, addresses and loop counters.
+  int64_t addressing = 24;
+
+  int64_t total() const {
+    return arrays + temporaries + addressing;
+  }
+};
+
+/// @brief how a kernel fills the SMs of a device.
+struct Occupancy {
+  int64_t blocks = 0;
+  int64_t threads = 0;
+  int64_t warps = 0;
+  // static shared memory of a block, the double buffers of Rewriter::pipeline included.
+  int64_t sharedBytes = 0;
+  int64_t registers = 0;
+  int64_t blocksPerSM = 0;
+  int64_t activeWarps = 0;
+  // active warps / max warps per SM.
+  double occupancy = 0.0;
+  // "warps", "blocks", "registers" or "shared memory", the resource which bounds blocksPerSM.
+  std::string limiter;
+  int64_t waves = 0;
+  // blocks / (waves * resident blocks of the device), 1 if the last wave is full.
+  double tailEfficiency = 0.0;
+};
+
 struct Analyzer {
   Analyzer() = default;
   static std::vector<mlir::AffineForOp> collectOutermostLoop(mlir::ModuleOp& module); 
@@ -68,6 +103,34 @@ struct Analyzer {
   static mlir::func::FuncOp getTargetFunction(mlir::ModuleOp& module, const std::string& targetFuncName);
   static int getUsersNumber(mlir::Value::user_range users);
 
+  /// @brief trip count of a loop, non constant bounds count as their constant upper bound or 1.
+  static int64_t getTripCount(mlir::AffineForOp forOp);
+
+  /// @brief bytes of a scalar or vector type, index counts as 8 bytes.
+  static int64_t getTypeBytes(mlir::Type type);
+
+  /// @brief content hash of a function over its symbol, attributes and body, the locations are ignored.
+  static uint64_t hashFunction(mlir::func::FuncOp funcOp);
+
+  /// @brief the registers a thread of the kernel needs, an upper bound which ignores the reuse of the scalars.
+  /// @param gridLevel outermost affine.parallel of the kernel
+  static RegisterUsage estimateRegisters(mlir::AffineParallelOp gridLevel);
+
+  /// @brief bytes of the static shared memory allocs of a kernel.
+  static int64_t getSharedBytes(mlir::AffineParallelOp gridLevel);
+
+  /// @brief resident blocks per SM limited by warps, registers, shared memory and the block slots.
+  static int64_t getBlocksPerSM(int64_t threads, int64_t registers, int64_t sharedBytes, const DeviceProfile& device);
+
+  /// @brief occupancy of a kernel from its launch and resources.
+  static Occupancy getOccupancy(int64_t blocks, int64_t threads, int64_t registers, int64_t sharedBytes,
+                                const DeviceProfile& device);
+
+  /// @brief occupancy of a kernel, the resources are read from the IR.
+  /// @param gridLevel outermost affine.parallel of the kernel
+  /// @param device
+  static Occupancy getOccupancy(mlir::AffineParallelOp gridLevel, const DeviceProfile& device);
+
   template<typename OpType, typename ParentOpType>
   static OpType getLastOp(ParentOpType father) {
     auto& ops = father.getBody()->getOperations();
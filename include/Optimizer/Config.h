@@ -0,0 +1,147 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace KernelCodeGen {
+
+/// @brief the flat form of a config, used by the search space and the tuning database.
+using ConfigRecord = std::map<std::string, int>;
+
+/// @brief binds a key of a record to a member of a typed config.
+template <typename Config>
+struct ConfigField {
+  const char* key;
+  int Config::*member;
+  // an optional key keeps the default of the member when the record misses it.
+  bool required;
+};
+
+struct MatmulConfig {
+  int BLOCK_SIZE_M = 128;
+  int BLOCK_SIZE_N = 128;
+  int BLOCK_SIZE_K = 8;
+  int GROUP_SIZE_M = 8;
+  int THREAD_SIZE_M = 8;
+  int THREAD_SIZE_N = 8;
+  int VECTORIZE_WIDTH = 4;
+  int WARP_SIZE = 32;
+
+  static const std::vector<ConfigField<MatmulConfig>>& fields();
+  bool validate() const;
+};
+
+/// @brief element wise, binary and gather kernels are tiled the same way.
+struct ElementWiseConfig {
+  int BLOCK_SIZE_M = 64;
+  int BLOCK_SIZE_N = 64;
+  int THREAD_SIZE_M = 4;
+  int THREAD_SIZE_N = 4;
+  int VECTORIZE_WIDTH = 4;
+
+  static const std::vector<ConfigField<ElementWiseConfig>>& fields();
+  bool validate() const;
+};
+
+using BinaryConfig = ElementWiseConfig;
+using GatherConfig = ElementWiseConfig;
+
+struct LayerNormConfig {
+  int BLOCK_SIZE = 2048;
+  int THREAD_SIZE = 4;
+  int VECTORIZE_WIDTH = 4;
+
+  static const std::vector<ConfigField<LayerNormConfig>>& fields();
+  bool validate() const;
+};
+
+struct FMHAConfig {
+  int BLOCK_SIZE = 128;
+  int HdxBr = 128 * 64;
+  int BrxBc = 128 * 64;
+  int WarpX_O = 2;
+  int Slice = 8;
+  int BrTileS = 8;
+  int BcTileS = 8;
+  int BrTileO = 8;
+  int HdTileO = 8;
+  int Width = 4;
+  int WARP_SIZE = 32;
+
+  // derived from the head dim when the kernel is built, not part of the record.
+  int Hd = 0;
+  int Br = 0;
+  int Bc = 0;
+
+  static const std::vector<ConfigField<FMHAConfig>>& fields();
+  bool validate() const;
+};
+
+struct BatchMatmulConfig {
+  int BLOCK_SIZE_M = 128;
+  int BLOCK_SIZE_N = 128;
+  int BLOCK_SIZE_K = 8;
+  int THREAD_SIZE_M = 8;
+  int THREAD_SIZE_N = 8;
+  int VECTORIZE_WIDTH = 4;
+  int WARP_SIZE = 32;
+
+  static const std::vector<ConfigField<BatchMatmulConfig>>& fields();
+  bool validate() const;
+};
+
+/// @brief BLIS blocking of a matmul on the host: the panels of B are NC x KC and live in the L3, the blocks of A
+/// are MC x KC and live in the L2, the MR x NR tile of C stays in vector registers while the micro-kernel runs
+/// over KC. NR is a multiple of VECTORIZE_WIDTH, MR x NR / VECTORIZE_WIDTH accumulators plus the row of B must
+/// fit in the vector register file.
+struct CpuMatmulConfig {
+  int MC = 72;
+  int NC = 3072;
+  int KC = 256;
+  int MR = 6;
+  int NR = 16;
+  int VECTORIZE_WIDTH = 8;
+  int UNROLL_K = 4;
+
+  /// @brief 6x16 fp32 micro-kernel, 12 of the 16 ymm registers hold C.
+  static CpuMatmulConfig avx2();
+  /// @brief 14x32 fp32 micro-kernel, 28 of the 32 zmm registers hold C.
+  static CpuMatmulConfig avx512();
+  /// @brief the preset matching the vector extensions of the host.
+  static CpuMatmulConfig host();
+
+  static const std::vector<ConfigField<CpuMatmulConfig>>& fields();
+  bool validate() const;
+};
+
+/// @brief parse a record into a typed config.
+/// @param record
+/// @param config left untouched on failure.
+/// @return false if a required key is missing or the config is invalid.
+template <typename Config>
+bool fromRecord(const ConfigRecord& record, Config& config) {
+  Config result;
+  for (auto& field : Config::fields()) {
+    auto iter = record.find(field.key);
+    if (iter == record.end()) {
+      if (field.required) return false;
+      continue;
+    }
+    result.*field.member = iter->second;
+  }
+  if (!result.validate()) return false;
+  config = result;
+  return true;
+}
+
+template <typename Config>
+ConfigRecord toRecord(const Config& config) {
+  ConfigRecord record;
+  for (auto& field : Config::fields()) {
+    record[field.key] = config.*field.member;
+  }
+  return record;
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "IR/IR.h"
+#include "Optimizer/AccessAnalyzer.h"
+
+#include <vector>
+
+namespace KernelCodeGen {
+
+/// @brief the traced requests of one load or store, summed over the warps and the iterations.
+struct TracedAccess {
+  mlir::Operation* op = nullptr;
+  MemorySpace space = MemorySpace::global;
+  // warp-wide requests, a request whose lanes are all masked off is not counted.
+  int64_t requests = 0;
+  // global: 32 bytes sectors and the distinct bytes the lanes asked for.
+  int64_t sectors = 0;
+  int64_t usefulBytes = 0;
+  // shared: wavefronts and the wavefronts of the same requests without conflicts.
+  int64_t wavefronts = 0;
+  int64_t idealWavefronts = 0;
+};
+
+/// @brief hardware counter like statistics of the traced blocks of one kernel.
+struct TraceStats {
+  int64_t blocks = 0;
+  int64_t tracedBlocks = 0;
+  int64_t tracedWarps = 0;
+  int64_t globalRequests = 0;
+  int64_t globalSectors = 0;
+  int64_t globalUsefulBytes = 0;
+  int64_t sharedRequests = 0;
+  int64_t sharedWavefronts = 0;
+  int64_t sharedIdealWavefronts = 0;
+  // distinct global sectors touched by the traced blocks, what they leave in L2.
+  int64_t l2FootprintBytes = 0;
+  // requests whose index depends on a loaded value or an unsupported op, they are not counted.
+  int64_t unresolved = 0;
+  // the request budget ran out before every traced block finished.
+  bool truncated = false;
+  std::vector<TracedAccess> accesses;
+
+  double sectorEfficiency() const {
+    return globalSectors ? 1.0 * globalUsefulBytes / (globalSectors * 32) : 1.0;
+  }
+  double bankConflictDegree() const {
+    return sharedIdealWavefronts ? 1.0 * sharedWavefronts / sharedIdealWavefronts : 1.0;
+  }
+  int64_t bankConflictReplays() const {
+    return sharedWavefronts - sharedIdealWavefronts;
+  }
+};
+
+/// @brief runs the index computations of an optimized kernel on the CPU, warp by warp with the lanes in lock step.
+/// Unlike AccessAnalyzer it follows every iteration, the affine.if guards of Rewriter::irregularMat and
+/// the partial tiles, so the counts are those of the traced blocks. The data itself is never computed:
+/// an index loaded from memory (a gather) makes its accesses unresolved.
+struct MemoryTracer {
+  MemoryTracer() = default;
+
+  /// @brief trace a sample of blocks spread over the grid, the first and the last block included.
+  /// @param gridLevel outermost affine.parallel of the kernel
+  /// @param sampleBlocks 0 traces every block
+  /// @param warpSize
+  /// @param maxRequests warp-wide requests traced at most, the stats are truncated beyond.
+  static TraceStats trace(mlir::AffineParallelOp gridLevel, int64_t sampleBlocks = 4, int64_t warpSize = 32,
+                          int64_t maxRequests = 1 << 20);
+
+  /// @brief print the counters of every access and the totals.
+  static void dump(const TraceStats& stats, llvm::raw_ostream& os);
+};
+
+}
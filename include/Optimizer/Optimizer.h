@@ -2,10 +2,12 @@
 
 #include "Optimizer/Analyzer.h"
 #include "Optimizer/Rewriter.h"
+#include "Optimizer/Config.h"
 #include "Frontend/Operators.h"
 
 #include "IR/IR.h"
 
+#include <cassert>
 #include <unordered_map>
 
 struct BatchMatmulDescriptor {
@@ -27,12 +29,31 @@ struct BatchMatmulDescriptor {
 namespace KernelCodeGen {
 
 struct Optimizer {
+  virtual ~Optimizer() = default;
   virtual bool applicable(mlir::ModuleOp& module) = 0;
   virtual void applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& builder) = 0;
+
+  /// @brief read the config of this instance from a record.
+  /// @return false if the record misses a key or is invalid, the current config is kept then.
+  virtual bool setConfig(const ConfigRecord& record) = 0;
+  virtual ConfigRecord getConfig() const = 0;
+
   bool operator==(const Optimizer& other) {
     return name == other.name;
   }
+
+  /// @brief restrict the rewrite to the functions named in targets, so every function can be tuned alone.
+  bool isTarget(const std::string& symbol) {
+    return targets.empty() || targets.count(symbol) != 0;
+  }
+  /// @brief also drops the functions taken from the incremental cache.
+  std::vector<mlir::func::FuncOp> filterTargets(std::vector<mlir::func::FuncOp> funcs);
+
   std::string name;
+  // symbols of the functions to rewrite, empty means all of them. FMHA is selected by its first batched matmul.
+  std::set<std::string> targets;
+  // symbols of the functions which are already optimized and must not be rewritten again.
+  std::set<std::string> reused;
 };
 
 struct MatmulOptimizer : Optimizer {
@@ -41,10 +62,21 @@ struct MatmulOptimizer : Optimizer {
     this->name = std::move(std::string("Matmul"));
   }
 
+  explicit MatmulOptimizer(const MatmulConfig& config) : MatmulOptimizer() {
+    assert(config.validate());
+    matmulConfig = config;
+  }
+
   // bool isMatmulPattern(mlir::AffineForOp forOp);
 
   virtual bool applicable(mlir::ModuleOp& module) override;
   virtual void applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& builder) override;
+  virtual bool setConfig(const ConfigRecord& record) override {
+    return fromRecord(record, matmulConfig);
+  }
+  virtual ConfigRecord getConfig() const override {
+    return toRecord(matmulConfig);
+  }
 
   mlir::AffineMap getAffineMap(const std::string& mapIdentifier, mlir::OpBuilder& builder);
 
@@ -76,15 +108,82 @@ struct MatmulOptimizer : Optimizer {
   // std::map<mlir::AffineForOp, MemoryBuffer, CompareLoop> matmulBuffers;
   std::map<mlir::func::FuncOp, MemoryBuffer, CompareFunc> matmulBuffers;
 
-  static std::map<std::string, int> matmulConfig;
+  MatmulConfig matmulConfig;
+};
+
+/// @brief schedules the "cpu" matmuls for the HostJIT the way BLIS does: jc -> pc -> ic -> jr -> ir -> micro-kernel.
+/// The NC x KC panel of B and the MC x KC block of A are packed into contiguous buffers in micro-panel order, the
+/// micro-kernel keeps the MR x NR tile of C in vector registers and does MR broadcasts and MR x NR / width fma per k.
+/// The rows of A beyond M are packed as zeros, N must be a multiple of NR, other matmuls are left as they are.
+struct CpuMatmulOptimizer : Optimizer {
+
+  CpuMatmulOptimizer() {
+    this->name = std::move(std::string("CpuMatmul"));
+    cpuMatmulConfig = CpuMatmulConfig::host();
+  }
+
+  explicit CpuMatmulOptimizer(const CpuMatmulConfig& config) : CpuMatmulOptimizer() {
+    assert(config.validate());
+    cpuMatmulConfig = config;
+  }
+
+  virtual bool applicable(mlir::ModuleOp& module) override;
+  virtual void applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& builder) override;
+  virtual bool setConfig(const ConfigRecord& record) override {
+    return fromRecord(record, cpuMatmulConfig);
+  }
+  virtual ConfigRecord getConfig() const override {
+    return toRecord(cpuMatmulConfig);
+  }
+
+  // MC, NC and KC shrunk to divide the padded problem.
+  struct Blocking {
+    int64_t m, n, k;
+    // M rounded up to MR, the rows beyond M are zeros in the packed A.
+    int64_t paddedM;
+    int64_t mc, nc, kc;
+  };
+
+  /// @param extras constant offsets of the row and column in the tile.
+  mlir::AffineMap getAffineMap(const std::string& mapIdentifier, mlir::OpBuilder& builder, const Blocking& blocking,
+                               const std::vector<int64_t>& extras = {});
+  // the guards of the rows beyond M.
+  mlir::IntegerSet getIntegerSet(const std::string& setIdentifier, mlir::OpBuilder& builder, const Blocking& blocking,
+                                 const std::vector<int64_t>& extras = {});
+
+  void clear() {
+    matmuls.clear();
+    matmulLoops.clear();
+    matmulBuffers.clear();
+    matmulBlockings.clear();
+  }
+
+  std::set<mlir::func::FuncOp, CompareFunc> matmuls;
+  // loopM->[loopM, loopN, loopK]
+  std::map<mlir::func::FuncOp, std::vector<mlir::AffineForOp>, CompareFunc> matmulLoops;
+  std::map<mlir::func::FuncOp, MatmulOptimizer::MemoryBuffer, CompareFunc> matmulBuffers;
+  std::map<mlir::func::FuncOp, Blocking, CompareFunc> matmulBlockings;
+
+  CpuMatmulConfig cpuMatmulConfig;
 };
 
 struct BinaryOptimizer : Optimizer {
   BinaryOptimizer() {
     this->name = std::move(std::string("Binary"));
   }
+
+  explicit BinaryOptimizer(const BinaryConfig& config) : BinaryOptimizer() {
+    assert(config.validate());
+    binaryConfig = config;
+  }
   virtual bool applicable(mlir::ModuleOp& module) override;
   virtual void applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& builder) override;
+  virtual bool setConfig(const ConfigRecord& record) override {
+    return fromRecord(record, binaryConfig);
+  }
+  virtual ConfigRecord getConfig() const override {
+    return toRecord(binaryConfig);
+  }
 
   mlir::AffineMap getAffineMap(const std::string& mapIdentifier, mlir::OpBuilder& builder, const std::vector<int64_t> &extras={}, 
                                 const int needDims=0, const int oneDimNums=0);
@@ -122,15 +221,26 @@ struct BinaryOptimizer : Optimizer {
   std::map<mlir::func::FuncOp, MemoryBuffer, CompareFunc> binaryBuffers;
   std::set<mlir::func::FuncOp, CompareFunc> binarys;
   std::map<mlir::func::FuncOp, std::vector<mlir::AffineForOp>, CompareFunc> binaryLoops;
-  static std::map<std::string, int> binaryConfig;
+  BinaryConfig binaryConfig;
 };
 
 struct ElementWiseOptimizer : Optimizer {
   ElementWiseOptimizer() {
     this->name = std::move(std::string("ElementWise"));
   }
+
+  explicit ElementWiseOptimizer(const ElementWiseConfig& config) : ElementWiseOptimizer() {
+    assert(config.validate());
+    elementWiseConfig = config;
+  }
   virtual bool applicable(mlir::ModuleOp& module) override;
   virtual void applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& builder) override;
+  virtual bool setConfig(const ConfigRecord& record) override {
+    return fromRecord(record, elementWiseConfig);
+  }
+  virtual ConfigRecord getConfig() const override {
+    return toRecord(elementWiseConfig);
+  }
   mlir::AffineMap getAffineMap(const std::string& mapIdentifier, mlir::OpBuilder& builder, const std::vector<int64_t> &extras={});
   void clear() {
     elementWiseBuffers.clear();
@@ -146,15 +256,26 @@ struct ElementWiseOptimizer : Optimizer {
   std::map<mlir::func::FuncOp, MemoryBuffer, CompareFunc> elementWiseBuffers;
   std::set<mlir::func::FuncOp, CompareFunc> elementWises;
   std::map<mlir::func::FuncOp, std::vector<mlir::AffineForOp>, CompareFunc> elementWiseLoops;
-  static std::map<std::string, int> elementWiseConfig;
+  ElementWiseConfig elementWiseConfig;
 };
 
 struct LayerNormOptimizer : Optimizer {
   LayerNormOptimizer() {
     this->name = std::move(std::string("LayerNorm"));
   }
+
+  explicit LayerNormOptimizer(const LayerNormConfig& config) : LayerNormOptimizer() {
+    assert(config.validate());
+    layerNormConfig = config;
+  }
   virtual bool applicable(mlir::ModuleOp& module) override;
   virtual void applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& builder) override;
+  virtual bool setConfig(const ConfigRecord& record) override {
+    return fromRecord(record, layerNormConfig);
+  }
+  virtual ConfigRecord getConfig() const override {
+    return toRecord(layerNormConfig);
+  }
   mlir::AffineMap getAffineMap(const std::string& mapIdentifier, mlir::OpBuilder& builder, const std::vector<int64_t> &extras={});
   mlir::AffineParallelOp combineParallel(std::vector<mlir::AffineParallelOp> pals);
   mlir::AffineForOp write(mlir::AffineForOp forOp, std::vector<mlir::Value> buffers);
@@ -179,15 +300,26 @@ struct LayerNormOptimizer : Optimizer {
   std::map<mlir::func::FuncOp, MemoryBuffer, CompareFunc> layerNormBuffers;
   std::set<mlir::func::FuncOp, CompareFunc> layerNorms;
   std::map<mlir::func::FuncOp, std::vector<std::vector<mlir::AffineForOp>>, CompareFunc> layerNormLoops;
-  static std::map<std::string, int> layerNormConfig;
+  LayerNormConfig layerNormConfig;
 };
 
 struct GatherOptimizer : Optimizer {
   GatherOptimizer() {
     this->name = std::move(std::string("Gather"));
   }
+
+  explicit GatherOptimizer(const GatherConfig& config) : GatherOptimizer() {
+    assert(config.validate());
+    gatherConfig = config;
+  }
   virtual bool applicable(mlir::ModuleOp& module) override;
   virtual void applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& builder) override;
+  virtual bool setConfig(const ConfigRecord& record) override {
+    return fromRecord(record, gatherConfig);
+  }
+  virtual ConfigRecord getConfig() const override {
+    return toRecord(gatherConfig);
+  }
   mlir::AffineMap getAffineMap(const std::string& mapIdentifier, mlir::OpBuilder& builder, const std::vector<int64_t> &extras={});
   void oneIndexLoad(mlir::AffineForOp forOp, mlir::AffineParallelOp pal);
 
@@ -206,7 +338,7 @@ struct GatherOptimizer : Optimizer {
   std::map<mlir::func::FuncOp, MemoryBuffer, CompareFunc> gatherBuffers;
   std::set<mlir::func::FuncOp, CompareFunc> gathers;
   std::map<mlir::func::FuncOp, std::vector<mlir::AffineForOp>, CompareFunc> gatherLoops;
-  static std::map<std::string, int> gatherConfig;
+  GatherConfig gatherConfig;
 };
 
 struct FMHAOptimizer : Optimizer {
@@ -215,8 +347,19 @@ struct FMHAOptimizer : Optimizer {
     this->name = std::move(std::string("FMHA"));
   }
 
+  explicit FMHAOptimizer(const FMHAConfig& config) : FMHAOptimizer() {
+    assert(config.validate());
+    fmhaConfig = config;
+  }
+
   virtual bool applicable(mlir::ModuleOp& module) override;
   virtual void applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& builder) override;
+  virtual bool setConfig(const ConfigRecord& record) override {
+    return fromRecord(record, fmhaConfig);
+  }
+  virtual ConfigRecord getConfig() const override {
+    return toRecord(fmhaConfig);
+  }
 
   mlir::AffineMap getAffineMap(const std::string& mapIdentifier, mlir::OpBuilder& builder);
 
@@ -249,7 +392,7 @@ struct FMHAOptimizer : Optimizer {
 
   std::map<mlir::func::CallOp, MemoryBuffer, CompareFuncCall> call2bufferMap;
 
-  static std::map<std::string, int> fmhaConfig;
+  FMHAConfig fmhaConfig;
 };
 
 struct BatchMatmulOptimizer : Optimizer {
@@ -258,8 +401,19 @@ struct BatchMatmulOptimizer : Optimizer {
     this->name = std::move(std::string("BatchMatmul"));
   }
 
+  explicit BatchMatmulOptimizer(const BatchMatmulConfig& config) : BatchMatmulOptimizer() {
+    assert(config.validate());
+    batchMatmulConfig = config;
+  }
+
   virtual bool applicable(mlir::ModuleOp& module) override;
   virtual void applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& builder) override;
+  virtual bool setConfig(const ConfigRecord& record) override {
+    return fromRecord(record, batchMatmulConfig);
+  }
+  virtual ConfigRecord getConfig() const override {
+    return toRecord(batchMatmulConfig);
+  }
 
   // mlir::AffineMap getAffineMap(const std::string& mapIdentifier, mlir::OpBuilder& builder, const int64_t batchNum=0);
   mlir::AffineMap getAffineMap(const std::string& mapIdentifier, mlir::OpBuilder& builder);
@@ -281,8 +435,13 @@ struct BatchMatmulOptimizer : Optimizer {
   std::map<mlir::func::FuncOp, MemoryBuffer, CompareFunc> batchMatmulBuffers;
   std::set<mlir::func::FuncOp, CompareFunc> batchMatmuls;
   std::map<mlir::func::FuncOp, std::vector<mlir::AffineForOp>, CompareFunc> batchMatmulLoops;
-  static std::map<std::string, int> batchMatmulConfig;
+  BatchMatmulConfig batchMatmulConfig;
   
 };
 
+/// @brief create a fresh optimizer by its name, used by the tuning workers.
+/// @param name 
+/// @return nullptr if the name is unknown.
+std::unique_ptr<Optimizer> createOptimizer(const std::string& name);
+
 }
\ No newline at end of file
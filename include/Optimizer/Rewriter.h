@@ -272,6 +272,11 @@ struct Rewriter {
 
   static std::vector<mlir::Value> blockLevelOneToTwo(mlir::AffineParallelOp pal, int64_t oneDimLen);
 
+  /// @brief launch the tiles of a 2D grid in groups of groupSizeM tile rows walked column by column, the order of
+  /// L2Simulator::rasterize. Every use of the block indices reads the swizzled (row, col) afterwards.
+  /// @return the swizzled indices, the block indices if the grid isn't constant or groupSizeM doesn't divide its rows.
+  static std::vector<mlir::Value> swizzleGrid(mlir::AffineParallelOp gridLevel, int64_t groupSizeM);
+
 };
 
 }
\ No newline at end of file
@@ -5,6 +5,7 @@ namespace KernelCodeGen {
 enum class Target {
   CUDA = 0,
   ROCm = 1,
+  CPU = 2,
 };
 
 enum class MemorySpace {
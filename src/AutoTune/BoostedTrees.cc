@@ -0,0 +1,262 @@
+#include "AutoTune/BoostedTrees.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace KernelCodeGen {
+
+namespace {
+
+std::vector<std::string> split(const std::string& line) {
+  std::vector<std::string> fields;
+  std::stringstream stream(line);
+  std::string field;
+  while (std::getline(stream, field, ',')) {
+    // tolerate the \r of files written on windows and spaces after the commas.
+    field.erase(0, field.find_first_not_of(" \t"));
+    field.erase(field.find_last_not_of(" \t\r") + 1);
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+bool toNumber(const std::string& field, double& value) {
+  if (field.empty()) return false;
+  char* end = nullptr;
+  value = std::strtod(field.c_str(), &end);
+  return *end == '\0';
+}
+
+}
+
+bool Samples::loadCSV(const std::string& path, const std::string& target) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    llvm::errs() << "Can't open samples \"" << path << "\"\n";
+    return false;
+  }
+  std::string line;
+  if (!std::getline(file, line)) return false;
+  auto header = split(line);
+  auto targetColumn = std::find(header.begin(), header.end(), target) - header.begin();
+  if (targetColumn == header.size()) {
+    llvm::errs() << "Samples \"" << path << "\" have no column \"" << target << "\"\n";
+    return false;
+  }
+  features.clear();
+  rows.clear();
+  targets.clear();
+  for (int i = 0; i < header.size(); i++) {
+    if (i != targetColumn) features.push_back(header[i]);
+  }
+
+  int skipped = 0;
+  while (std::getline(file, line)) {
+    if (line.empty() || line == "\r") continue;
+    auto fields = split(line);
+    if (fields.size() != header.size()) {
+      skipped++;
+      continue;
+    }
+    std::vector<double> row;
+    double targetValue = 0.0;
+    bool valid = true;
+    for (int i = 0; i < fields.size() && valid; i++) {
+      double value = 0.0;
+      valid = toNumber(fields[i], value);
+      if (i == targetColumn) targetValue = value;
+      else row.push_back(value);
+    }
+    if (!valid) {
+      skipped++;
+      continue;
+    }
+    rows.push_back(std::move(row));
+    targets.push_back(targetValue);
+  }
+  if (skipped) llvm::errs() << "Skipped " << skipped << " bad rows of \"" << path << "\"\n";
+  return true;
+}
+
+int BoostedTrees::grow(Tree& tree, const Samples& samples, const std::vector<double>& residuals,
+                       const std::vector<int>& indices, int depth, const TreeParams& params) {
+  int id = tree.size();
+  tree.emplace_back();
+  double sum = 0.0;
+  for (auto index : indices) sum += residuals[index];
+  int count = indices.size();
+  tree[id].value = params.learningRate * sum / std::max(count, 1);
+  if (depth >= params.depth || count < 2 * params.minSamplesLeaf) return id;
+
+  // the split which reduces the squared error most is the one which maximizes sumL^2/nL + sumR^2/nR.
+  int bestFeature = -1;
+  double bestThreshold = 0.0, bestGain = sum * sum / count + 1e-12;
+  std::vector<int> sorted = indices;
+  for (int feature = 0; feature < samples.features.size(); feature++) {
+    std::sort(sorted.begin(), sorted.end(), [&](int x, int y) {
+      return samples.rows[x][feature] < samples.rows[y][feature];
+    });
+    double left = 0.0;
+    for (int i = 0; i + 1 < count; i++) {
+      left += residuals[sorted[i]];
+      auto value = samples.rows[sorted[i]][feature], next = samples.rows[sorted[i + 1]][feature];
+      int nLeft = i + 1, nRight = count - nLeft;
+      if (value == next || nLeft < params.minSamplesLeaf || nRight < params.minSamplesLeaf) continue;
+      auto right = sum - left;
+      auto gain = left * left / nLeft + right * right / nRight;
+      if (gain > bestGain) {
+        bestGain = gain;
+        bestFeature = feature;
+        bestThreshold = (value + next) / 2;
+      }
+    }
+  }
+  if (bestFeature < 0) return id;
+
+  std::vector<int> leftIndices, rightIndices;
+  for (auto index : indices) {
+    if (samples.rows[index][bestFeature] <= bestThreshold) leftIndices.push_back(index);
+    else rightIndices.push_back(index);
+  }
+  tree[id].feature = bestFeature;
+  tree[id].threshold = bestThreshold;
+  // grow() appends to the tree, so the children are linked after they are built.
+  auto left = grow(tree, samples, residuals, leftIndices, depth + 1, params);
+  auto right = grow(tree, samples, residuals, rightIndices, depth + 1, params);
+  tree[id].left = left;
+  tree[id].right = right;
+  return id;
+}
+
+bool BoostedTrees::train(const Samples& samples, const TreeParams& params) {
+  if (samples.rows.empty()) return false;
+  features = samples.features;
+  trees.clear();
+  base = 0.0;
+  for (auto target : samples.targets) base += target;
+  base /= samples.targets.size();
+
+  std::vector<double> predictions(samples.rows.size(), base), residuals(samples.rows.size());
+  std::vector<int> indices(samples.rows.size());
+  for (int i = 0; i < indices.size(); i++) indices[i] = i;
+  for (int t = 0; t < params.trees; t++) {
+    for (int i = 0; i < indices.size(); i++) residuals[i] = samples.targets[i] - predictions[i];
+    Tree tree;
+    grow(tree, samples, residuals, indices, 0, params);
+    trees.push_back(std::move(tree));
+    for (int i = 0; i < indices.size(); i++) predictions[i] += walk(trees.back(), samples.rows[i]);
+  }
+  return true;
+}
+
+double BoostedTrees::walk(const Tree& tree, const std::vector<double>& values) {
+  int id = 0;
+  while (tree[id].feature >= 0) {
+    auto value = tree[id].feature < values.size() ? values[tree[id].feature] : 0.0;
+    id = value <= tree[id].threshold ? tree[id].left : tree[id].right;
+  }
+  return tree[id].value;
+}
+
+double BoostedTrees::predict(const std::vector<double>& values) const {
+  auto result = base;
+  for (auto& tree : trees) result += walk(tree, values);
+  return result;
+}
+
+bool BoostedTrees::load(const std::string& path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    llvm::errs() << "Can't open cost model \"" << path << "\"\n";
+    return false;
+  }
+  auto parsed = llvm::json::parse(buffer.get()->getBuffer());
+  if (!parsed) {
+    llvm::errs() << "Bad cost model \"" << path << "\": " << llvm::toString(parsed.takeError()) << "\n";
+    return false;
+  }
+  auto object = parsed->getAsObject();
+  auto featureArray = object ? object->getArray("features") : nullptr;
+  auto treeArray = object ? object->getArray("trees") : nullptr;
+  if (!featureArray || !treeArray) {
+    llvm::errs() << "Cost model \"" << path << "\" misses the features or the trees\n";
+    return false;
+  }
+
+  std::vector<std::string> newFeatures;
+  for (auto& feature : *featureArray) {
+    if (auto name = feature.getAsString()) newFeatures.push_back(name->str());
+  }
+  std::vector<Tree> newTrees;
+  for (auto& treeValue : *treeArray) {
+    auto nodes = treeValue.getAsArray();
+    if (!nodes || nodes->empty()) return false;
+    Tree tree;
+    for (auto& nodeValue : *nodes) {
+      auto node = nodeValue.getAsObject();
+      if (!node) return false;
+      Node result;
+      result.feature = node->getInteger("feature").getValueOr(-1);
+      result.threshold = node->getNumber("threshold").getValueOr(0.0);
+      result.left = node->getInteger("left").getValueOr(-1);
+      result.right = node->getInteger("right").getValueOr(-1);
+      result.value = node->getNumber("value").getValueOr(0.0);
+      tree.push_back(result);
+    }
+    // a malformed tree would make predict() walk out of it.
+    for (auto& node : tree) {
+      if (node.feature < 0) continue;
+      if (node.left <= 0 || node.right <= 0 || node.left >= tree.size() || node.right >= tree.size()) {
+        llvm::errs() << "Cost model \"" << path << "\" has a broken tree\n";
+        return false;
+      }
+    }
+    newTrees.push_back(std::move(tree));
+  }
+  features = std::move(newFeatures);
+  trees = std::move(newTrees);
+  base = object->getNumber("base").getValueOr(0.0);
+  return true;
+}
+
+std::string BoostedTrees::toJson() const {
+  llvm::json::Array featureArray, treeArray;
+  for (auto& feature : features) featureArray.push_back(feature);
+  for (auto& tree : trees) {
+    llvm::json::Array nodes;
+    for (auto& node : tree) {
+      if (node.feature < 0) {
+        nodes.push_back(llvm::json::Object{{"value", node.value}});
+      } else {
+        nodes.push_back(llvm::json::Object{{"feature", node.feature}, {"threshold", node.threshold},
+                                           {"left", node.left}, {"right", node.right}});
+      }
+    }
+    treeArray.push_back(std::move(nodes));
+  }
+  llvm::json::Object object{{"features", std::move(featureArray)}, {"base", base}, {"trees", std::move(treeArray)}};
+  std::string result;
+  llvm::raw_string_ostream os(result);
+  os << llvm::json::Value(std::move(object));
+  return os.str();
+}
+
+bool BoostedTrees::save(const std::string& path) const {
+  std::error_code error;
+  llvm::raw_fd_ostream os(path, error, llvm::sys::fs::OF_Text);
+  if (error) {
+    llvm::errs() << "Can't write cost model \"" << path << "\": " << error.message() << "\n";
+    return false;
+  }
+  os << toJson() << "\n";
+  return true;
+}
+
+}
@@ -0,0 +1,193 @@
+#include "AutoTune/Calibration.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
+namespace KernelCodeGen {
+
+namespace {
+
+bool startsWith(const std::string& line, const std::string& prefix) {
+  return line.compare(0, prefix.size(), prefix) == 0;
+}
+
+// the number after the last ':' or '=' of the line.
+bool tailNumber(const std::string& line, double& value) {
+  auto pos = line.find_last_of(":=");
+  if (pos == std::string::npos) return false;
+  char* end = nullptr;
+  value = std::strtod(line.c_str() + pos + 1, &end);
+  return end != line.c_str() + pos + 1;
+}
+
+ConfigRecord parseConfig(const std::string& str) {
+  ConfigRecord config;
+  std::stringstream stream(str);
+  std::string item;
+  while (std::getline(stream, item, ';')) {
+    auto pos = item.find('=');
+    if (pos == std::string::npos) continue;
+    auto key = item.substr(0, pos);
+    key.erase(0, key.find_first_not_of(" \t"));
+    key.erase(key.find_last_not_of(" \t") + 1);
+    config[key] = std::atoi(item.c_str() + pos + 1);
+  }
+  return config;
+}
+
+std::vector<double> ranks(const std::vector<double>& x) {
+  std::vector<int> order(x.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int a, int b) { return x[a] < x[b]; });
+  std::vector<double> result(x.size());
+  for (int i = 0; i < order.size();) {
+    int j = i;
+    while (j + 1 < order.size() && x[order[j + 1]] == x[order[i]]) j++;
+    for (int t = i; t <= j; t++) result[order[t]] = (i + j) / 2.0;
+    i = j + 1;
+  }
+  return result;
+}
+
+double pearson(const std::vector<double>& x, const std::vector<double>& y) {
+  auto n = x.size();
+  if (n < 2) return 0.0;
+  auto meanX = std::accumulate(x.begin(), x.end(), 0.0) / n, meanY = std::accumulate(y.begin(), y.end(), 0.0) / n;
+  double xy = 0.0, xx = 0.0, yy = 0.0;
+  for (int i = 0; i < n; i++) {
+    xy += (x[i] - meanX) * (y[i] - meanY);
+    xx += (x[i] - meanX) * (x[i] - meanX);
+    yy += (y[i] - meanY) * (y[i] - meanY);
+  }
+  return xx > 0.0 && yy > 0.0 ? xy / std::sqrt(xx * yy) : 0.0;
+}
+
+}
+
+bool Calibration::parseLog(const std::string& path, std::vector<Measurement>& measurements) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    llvm::errs() << "Can't open log \"" << path << "\"\n";
+    return false;
+  }
+  Measurement current;
+  bool inEntry = false;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    auto trimmed = line.substr(std::min(line.size(), line.find_first_not_of(" \t")));
+    double value = 0.0;
+    if (startsWith(trimmed, "Matrix size")) {
+      current = Measurement();
+      inEntry = true;
+    } else if (!inEntry) {
+      continue;
+    } else if (startsWith(trimmed, "--- M ---") && tailNumber(trimmed, value)) {
+      current.m = value;
+    } else if (startsWith(trimmed, "--- N ---") && tailNumber(trimmed, value)) {
+      current.n = value;
+    } else if (startsWith(trimmed, "--- K ---") && tailNumber(trimmed, value)) {
+      current.k = value;
+    } else if (startsWith(trimmed, "Config")) {
+      auto pos = trimmed.find(':');
+      if (pos != std::string::npos) current.config = parseConfig(trimmed.substr(pos + 1));
+    } else if (startsWith(trimmed, "My Matmul Latency")) {
+      // "= 1.80746 ms", the unit follows the number.
+      auto pos = trimmed.find('=');
+      char* end = nullptr;
+      if (pos != std::string::npos) value = std::strtod(trimmed.c_str() + pos + 1, &end);
+      if (end && value > 0.0 && current.m > 0 && current.n > 0 && current.k > 0) {
+        current.measured = value;
+        measurements.push_back(current);
+      }
+      inEntry = false;
+    }
+  }
+  return true;
+}
+
+double Calibration::kendall(const std::vector<double>& x, const std::vector<double>& y) {
+  int64_t concordant = 0, discordant = 0, tiesX = 0, tiesY = 0;
+  for (int i = 0; i < x.size(); i++) {
+    for (int j = i + 1; j < x.size(); j++) {
+      auto dx = x[i] - x[j], dy = y[i] - y[j];
+      if (dx == 0.0 && dy == 0.0) continue;
+      if (dx == 0.0) tiesX++;
+      else if (dy == 0.0) tiesY++;
+      else if ((dx > 0.0) == (dy > 0.0)) concordant++;
+      else discordant++;
+    }
+  }
+  auto denominator = std::sqrt(1.0 * (concordant + discordant + tiesX) * (concordant + discordant + tiesY));
+  return denominator > 0.0 ? (concordant - discordant) / denominator : 0.0;
+}
+
+double Calibration::spearman(const std::vector<double>& x, const std::vector<double>& y) {
+  return pearson(ranks(x), ranks(y));
+}
+
+double Calibration::mape(const std::vector<double>& predicted, const std::vector<double>& measured) {
+  if (measured.empty()) return 0.0;
+  double sum = 0.0;
+  for (int i = 0; i < measured.size(); i++) sum += std::fabs(predicted[i] - measured[i]) / measured[i];
+  return sum / measured.size() * 100.0;
+}
+
+Accuracy Calibration::accuracy(const std::vector<Measurement>& measurements) {
+  std::vector<double> predicted, measured;
+  for (auto& measurement : measurements) {
+    predicted.push_back(measurement.predicted);
+    measured.push_back(measurement.measured);
+  }
+  Accuracy result;
+  result.kendall = kendall(predicted, measured);
+  result.spearman = spearman(predicted, measured);
+  result.mape = mape(predicted, measured);
+  return result;
+}
+
+void Calibration::fitCorrection(const std::vector<Measurement>& measurements, double& scale, double& offsetMs) {
+  // weighted least squares with weights 1/measured^2: solve the 2x2 normal equations.
+  double sw = 0.0, sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+  for (auto& measurement : measurements) {
+    auto w = 1.0 / (measurement.measured * measurement.measured);
+    auto x = measurement.predicted, y = measurement.measured;
+    sw += w;
+    sx += w * x;
+    sy += w * y;
+    sxx += w * x * x;
+    sxy += w * x * y;
+  }
+  scale = 1.0;
+  offsetMs = 0.0;
+  auto det = sw * sxx - sx * sx;
+  if (sw == 0.0) return;
+  if (std::fabs(det) > 1e-12 * sw * sxx) {
+    scale = (sw * sxy - sx * sy) / det;
+    offsetMs = (sxx * sy - sx * sxy) / det;
+  }
+  // a single point or a negative slope: keep only a scale.
+  if (!(scale > 0.0) || std::fabs(det) <= 1e-12 * sw * sxx) {
+    scale = sxx > 0.0 ? sxy / sxx : 1.0;
+    offsetMs = 0.0;
+  }
+}
+
+std::vector<int> Calibration::outliers(const std::vector<Measurement>& measurements, int count) {
+  auto error = [&](int i) {
+    return std::fabs(measurements[i].predicted - measurements[i].measured) / measurements[i].measured;
+  };
+  std::vector<int> order(measurements.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](int a, int b) { return error(a) > error(b); });
+  if (order.size() > count) order.resize(count);
+  return order;
+}
+
+}
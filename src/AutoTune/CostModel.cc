@@ -0,0 +1,229 @@
+#include "AutoTune/CostModel.h"
+#include "Optimizer/Analyzer.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <map>
+
+namespace KernelCodeGen {
+
+namespace {
+
+// the memref and the value type of a load or store, a null memref for the other ops.
+std::pair<mlir::Value, mlir::Type> getAccess(mlir::Operation* op, bool& isStore) {
+  isStore = false;
+  if (auto loadOp = mlir::dyn_cast<mlir::AffineLoadOp>(op)) return {loadOp.getMemRef(), loadOp.getResult().getType()};
+  if (auto loadOp = mlir::dyn_cast<mlir::AffineVectorLoadOp>(op)) return {loadOp.getMemRef(), loadOp.getResult().getType()};
+  if (auto loadOp = mlir::dyn_cast<mlir::memref::LoadOp>(op)) return {loadOp.getMemRef(), loadOp.getResult().getType()};
+  if (auto loadOp = mlir::dyn_cast<mlir::vector::LoadOp>(op)) return {loadOp.getBase(), loadOp.getResult().getType()};
+  isStore = true;
+  if (auto storeOp = mlir::dyn_cast<mlir::AffineStoreOp>(op)) {
+    return {storeOp.getMemRef(), storeOp.getValueToStore().getType()};
+  }
+  if (auto storeOp = mlir::dyn_cast<mlir::AffineVectorStoreOp>(op)) {
+    return {storeOp.getMemRef(), storeOp.getValueToStore().getType()};
+  }
+  if (auto storeOp = mlir::dyn_cast<mlir::memref::StoreOp>(op)) {
+    return {storeOp.getMemRef(), storeOp.getValueToStore().getType()};
+  }
+  if (auto storeOp = mlir::dyn_cast<mlir::vector::StoreOp>(op)) return {storeOp.getBase(), storeOp.getValueToStore().getType()};
+  return {mlir::Value(), mlir::Type()};
+}
+
+// times an op runs per thread: the trip counts of its loops inside the kernel.
+double getTimes(mlir::Operation* op, mlir::AffineParallelOp gridLevel) {
+  double times = 1.0;
+  for (auto parent = op->getParentOp(); parent && parent != gridLevel.getOperation(); parent = parent->getParentOp()) {
+    if (auto forOp = mlir::dyn_cast<mlir::AffineForOp>(parent)) times *= Analyzer::getTripCount(forOp);
+  }
+  return times;
+}
+
+int64_t dim(const std::vector<int64_t>& dims, int index) {
+  // the last dim is x.
+  return index < dims.size() ? dims[dims.size() - 1 - index] : 1;
+}
+
+void describe(mlir::AffineParallelOp gridLevel, const KernelStats& kernel, const DeviceProfile& device,
+              std::map<std::string, double>& features) {
+  auto occupancy = Analyzer::getOccupancy(kernel.blocks, kernel.threads, kernel.registers, kernel.sharedAlloc, device);
+  features["blocks"] = kernel.blocks;
+  features["threads"] = kernel.threads;
+  features["grid_x"] = dim(kernel.grid, 0);
+  features["grid_y"] = dim(kernel.grid, 1);
+  features["block_x"] = dim(kernel.block, 0);
+  features["block_y"] = dim(kernel.block, 1);
+  features["registers"] = kernel.registers;
+  features["local_words"] = Analyzer::estimateRegisters(gridLevel).arrays;
+  features["shared_alloc"] = kernel.sharedAlloc;
+  features["occupancy"] = occupancy.occupancy;
+  features["waves"] = occupancy.waves;
+  features["tail_efficiency"] = occupancy.tailEfficiency;
+  features["flops"] = kernel.flops;
+  features["global_bytes"] = kernel.globalBytes;
+  features["shared_bytes"] = kernel.sharedBytes;
+  features["intensity"] = kernel.globalBytes > 0 ? kernel.flops / kernel.globalBytes : 0.0;
+  features["barriers"] = kernel.barriers;
+  features["bank_conflict"] = kernel.bankConflictDegree;
+  features["sector_efficiency"] = kernel.sectorEfficiency;
+
+  double globalLoads = 0.0, globalStores = 0.0, sharedLoads = 0.0, sharedStores = 0.0;
+  int64_t vectorWidth = 1;
+  gridLevel.walk([&](mlir::Operation* op) {
+    bool isStore = false;
+    auto access = getAccess(op, isStore);
+    if (!access.first) return;
+    auto type = access.first.getType().dyn_cast<mlir::MemRefType>();
+    if (!type) return;
+    auto times = getTimes(op, gridLevel);
+    auto space = type.getMemorySpaceAsInt();
+    if (space == static_cast<int>(MemorySpace::shared)) {
+      (isStore ? sharedStores : sharedLoads) += times;
+    } else if (space != static_cast<int>(MemorySpace::local)) {
+      (isStore ? globalStores : globalLoads) += times;
+      if (auto vectorType = access.second.dyn_cast<mlir::VectorType>()) {
+        vectorWidth = std::max(vectorWidth, vectorType.getNumElements());
+      }
+    }
+  });
+  features["global_loads"] = globalLoads;
+  features["global_stores"] = globalStores;
+  features["shared_loads"] = sharedLoads;
+  features["shared_stores"] = sharedStores;
+  features["vector_width"] = vectorWidth;
+
+  int64_t unrolledLoops = 0, maxUnroll = 0;
+  gridLevel.walk([&](mlir::AffineForOp forOp) {
+    auto attr = forOp->getAttrOfType<mlir::StringAttr>(std::string("affine.loop"));
+    if (!attr || attr.getValue() != "unroll") return;
+    unrolledLoops += 1;
+    maxUnroll = std::max(maxUnroll, Analyzer::getTripCount(forOp));
+  });
+  features["unrolled_loops"] = unrolledLoops;
+  features["max_unroll"] = maxUnroll;
+}
+
+}
+
+const std::vector<std::string>& FeatureExtractor::names() {
+  static const std::vector<std::string> result = {
+    "roofline_ms", "kernels", "blocks", "threads", "grid_x", "grid_y", "block_x", "block_y",
+    "registers", "local_words", "shared_alloc", "occupancy", "waves", "tail_efficiency",
+    "flops", "global_bytes", "shared_bytes", "intensity", "barriers", "bank_conflict", "sector_efficiency",
+    "global_loads", "global_stores", "shared_loads", "shared_stores", "vector_width", "unrolled_loops", "max_unroll"
+  };
+  return result;
+}
+
+std::vector<double> FeatureExtractor::extract(mlir::ModuleOp& module, const DeviceProfile& device) {
+  std::map<std::string, int64_t> calls;
+  module.walk([&](mlir::func::CallOp callOp) {
+    calls[callOp.getCallee().str()] += 1;
+  });
+
+  std::map<std::string, double> features;
+  double roofline = 0.0, heaviest = -1.0;
+  int64_t kernels = 0;
+  module.walk([&](mlir::func::FuncOp func) {
+    if (func.isExternal()) return;
+    auto symbol = func.getSymName().str();
+    auto times = calls.count(symbol) ? calls[symbol] : 1;
+    auto stats = RooflineEvaluator::collectKernels(func);
+    if (stats.empty()) {
+      roofline += AnalyticalEvaluator::funcLatency(AnalyticalEvaluator::collectStats(func), device) * times;
+      return;
+    }
+    // collectKernels() visits the grid levels in the same order.
+    int index = 0;
+    for (auto& op : func.getBody().front()) {
+      auto gridLevel = mlir::dyn_cast<mlir::AffineParallelOp>(&op);
+      if (!gridLevel || !gridLevel.getConstantRanges()) continue;
+      auto& kernel = stats[index++];
+      auto ms = RooflineEvaluator::kernelLatency(kernel, device) * times;
+      roofline += ms;
+      kernels += 1;
+      if (ms > heaviest) {
+        heaviest = ms;
+        describe(gridLevel, kernel, device, features);
+      }
+    }
+  });
+  features["roofline_ms"] = roofline;
+  features["kernels"] = kernels;
+
+  std::vector<double> result;
+  for (auto& name : names()) result.push_back(features.count(name) ? features[name] : 0.0);
+  return std::move(result);
+}
+
+bool LearnedEvaluator::load(const std::string& modelPath) {
+  BoostedTrees loaded;
+  if (!loaded.load(modelPath)) return false;
+  auto& known = FeatureExtractor::names();
+  std::vector<int> newColumns;
+  for (auto& feature : loaded.getFeatures()) {
+    auto iter = std::find(known.begin(), known.end(), feature);
+    if (iter == known.end()) llvm::errs() << "Cost model feature \"" << feature << "\" is unknown, it counts as 0\n";
+    newColumns.push_back(iter == known.end() ? -1 : iter - known.begin());
+  }
+  model = std::move(loaded);
+  columns = std::move(newColumns);
+  return true;
+}
+
+float LearnedEvaluator::evaluate(mlir::ModuleOp& module, const DeviceProfile& device) {
+  if (model.empty()) return RooflineEvaluator().evaluate(module, device);
+  auto extracted = FeatureExtractor::extract(module, device);
+  std::vector<double> values;
+  for (auto column : columns) values.push_back(column < 0 ? 0.0 : extracted[column]);
+  return static_cast<float>(std::exp(model.predict(values)));
+}
+
+bool LearnedEvaluator::train(const std::string& csvPath, const std::string& modelPath, const TreeParams& params) {
+  Samples samples;
+  if (!samples.loadCSV(csvPath, "latency")) return false;
+  // the latencies span orders of magnitude, the relative error matters.
+  for (int i = 0; i < samples.targets.size(); i++) {
+    if (samples.targets[i] > 0.0) continue;
+    samples.rows.erase(samples.rows.begin() + i);
+    samples.targets.erase(samples.targets.begin() + i);
+    i--;
+  }
+  for (auto& target : samples.targets) target = std::log(target);
+
+  BoostedTrees model;
+  if (!model.train(samples, params)) {
+    llvm::errs() << "No valid samples in \"" << csvPath << "\"\n";
+    return false;
+  }
+  return model.save(modelPath);
+}
+
+float RecordingEvaluator::evaluate(mlir::ModuleOp& module, const DeviceProfile& device) {
+  auto latency = inner->evaluate(module, device);
+  // the failed measurements carry no latency.
+  if (latency <= 0.0f || latency == FLT_MAX) return latency;
+  auto features = FeatureExtractor::extract(module, device);
+
+  std::lock_guard<std::mutex> lock(fileMutex);
+  bool header = !llvm::sys::fs::exists(csvPath);
+  std::error_code error;
+  llvm::raw_fd_ostream os(csvPath, error, llvm::sys::fs::OF_Append | llvm::sys::fs::OF_Text);
+  if (error) {
+    llvm::errs() << "Can't append to \"" << csvPath << "\": " << error.message() << "\n";
+    return latency;
+  }
+  if (header) {
+    for (auto& name : FeatureExtractor::names()) os << name << ",";
+    os << "latency\n";
+  }
+  for (auto value : features) os << value << ",";
+  os << latency << "\n";
+  return latency;
+}
+
+}
@@ -0,0 +1,90 @@
+#include "AutoTune/DeviceProfile.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <vector>
+#include <utility>
+
+namespace KernelCodeGen {
+
+namespace {
+
+const std::vector<std::pair<const char*, int64_t DeviceProfile::*>>& intFields() {
+  static const std::vector<std::pair<const char*, int64_t DeviceProfile::*>> result = {
+    {"warpSize", &DeviceProfile::warpSize}, {"maxThreadsPerBlock", &DeviceProfile::maxThreadsPerBlock},
+    {"maxSharedMemPerBlock", &DeviceProfile::maxSharedMemPerBlock},
+    {"maxRegistersPerThread", &DeviceProfile::maxRegistersPerThread},
+    {"maxVectorBytes", &DeviceProfile::maxVectorBytes}, {"smCount", &DeviceProfile::smCount},
+    {"maxWarpsPerSM", &DeviceProfile::maxWarpsPerSM}, {"maxBlocksPerSM", &DeviceProfile::maxBlocksPerSM},
+    {"registersPerSM", &DeviceProfile::registersPerSM}, {"sharedMemPerSM", &DeviceProfile::sharedMemPerSM},
+    {"registerAllocUnit", &DeviceProfile::registerAllocUnit}, {"sharedAllocUnit", &DeviceProfile::sharedAllocUnit},
+    {"reservedSharedMemPerBlock", &DeviceProfile::reservedSharedMemPerBlock}, {"l2Bytes", &DeviceProfile::l2Bytes},
+    {"l2LineBytes", &DeviceProfile::l2LineBytes}, {"l2Ways", &DeviceProfile::l2Ways}
+  };
+  return result;
+}
+
+const std::vector<std::pair<const char*, double DeviceProfile::*>>& floatFields() {
+  static const std::vector<std::pair<const char*, double DeviceProfile::*>> result = {
+    {"peakGFlops", &DeviceProfile::peakGFlops}, {"memBandwidthGBs", &DeviceProfile::memBandwidthGBs},
+    {"sharedBandwidthGBs", &DeviceProfile::sharedBandwidthGBs}, {"launchOverheadUs", &DeviceProfile::launchOverheadUs},
+    {"clockGHz", &DeviceProfile::clockGHz}, {"barrierCycles", &DeviceProfile::barrierCycles},
+    {"latencyScale", &DeviceProfile::latencyScale}, {"latencyOffsetUs", &DeviceProfile::latencyOffsetUs},
+    {"hostGFlops", &DeviceProfile::hostGFlops}, {"hostBandwidthGBs", &DeviceProfile::hostBandwidthGBs}
+  };
+  return result;
+}
+
+}
+
+bool DeviceProfile::load(const std::string& path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer) {
+    llvm::errs() << "Can't open device profile \"" << path << "\"\n";
+    return false;
+  }
+  auto parsed = llvm::json::parse(buffer.get()->getBuffer());
+  if (!parsed) {
+    llvm::errs() << "Bad device profile \"" << path << "\": " << llvm::toString(parsed.takeError()) << "\n";
+    return false;
+  }
+  auto object = parsed->getAsObject();
+  if (!object) {
+    llvm::errs() << "Device profile \"" << path << "\" is not a JSON object\n";
+    return false;
+  }
+
+  if (auto value = object->getString("name")) name = value->str();
+  for (auto& field : intFields()) {
+    if (auto value = object->getInteger(field.first)) this->*field.second = *value;
+  }
+  for (auto& field : floatFields()) {
+    if (auto value = object->getNumber(field.first)) this->*field.second = *value;
+  }
+  return true;
+}
+
+std::string DeviceProfile::toJson() const {
+  llvm::json::Object object;
+  object["name"] = name;
+  for (auto& field : intFields()) object[field.first] = this->*field.second;
+  for (auto& field : floatFields()) object[field.first] = this->*field.second;
+  return llvm::formatv("{0:2}", llvm::json::Value(std::move(object))).str();
+}
+
+bool DeviceProfile::save(const std::string& path) const {
+  std::error_code error;
+  llvm::raw_fd_ostream os(path, error, llvm::sys::fs::OF_Text);
+  if (error) {
+    llvm::errs() << "Can't write device profile \"" << path << "\": " << error.message() << "\n";
+    return false;
+  }
+  os << toJson() << "\n";
+  return true;
+}
+
+}
@@ -0,0 +1,377 @@
+#include "AutoTune/Evaluator.h"
+#include "AutoTune/ResourceFilter.h"
+#include "Optimizer/AccessAnalyzer.h"
+#include "Optimizer/MemoryTracer.h"
+#include "Optimizer/Analyzer.h"
+
+#include "mlir/Conversion/Passes.h"
+#include "mlir/Target/LLVMIR/Dialect/LLVMIR/LLVMToLLVMIRTranslation.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <mutex>
+#include <set>
+
+namespace KernelCodeGen {
+
+namespace {
+
+int64_t getLanes(mlir::Type type) {
+  if (auto vectorType = type.dyn_cast<mlir::VectorType>()) return vectorType.getNumElements();
+  return 1;
+}
+
+template <typename Stats>
+void access(mlir::Value memref, mlir::Type valueType, double times, Stats& stats) {
+  auto type = memref.getType().dyn_cast<mlir::MemRefType>();
+  if (!type) return;
+  auto bytes = times * Analyzer::getTypeBytes(valueType);
+  auto space = type.getMemorySpaceAsInt();
+  if (space == static_cast<int>(MemorySpace::shared)) stats.sharedBytes += bytes;
+  // local buffers are registers.
+  else if (space != static_cast<int>(MemorySpace::local)) stats.globalBytes += bytes;
+}
+
+// a host function has no barriers.
+void barrier(double times, FuncStats& stats) {}
+
+void barrier(double times, KernelStats& stats) {
+  stats.barriers += times;
+}
+
+template <typename Stats>
+void count(mlir::Block& block, double times, Stats& stats);
+
+template <typename Stats>
+void count(mlir::Operation* op, double times, Stats& stats) {
+  if (auto forOp = mlir::dyn_cast<mlir::AffineForOp>(op)) {
+    count(*forOp.getBody(), times * Analyzer::getTripCount(forOp), stats);
+    return;
+  }
+  if (auto parallelOp = mlir::dyn_cast<mlir::AffineParallelOp>(op)) {
+    double iters = 1.0;
+    if (auto ranges = parallelOp.getConstantRanges()) {
+      for (auto range : *ranges) iters *= range;
+    }
+    count(*parallelOp.getBody(), times * iters, stats);
+    return;
+  }
+  if (auto loadOp = mlir::dyn_cast<mlir::AffineLoadOp>(op)) {
+    access(loadOp.getMemRef(), loadOp.getResult().getType(), times, stats);
+  } else if (auto storeOp = mlir::dyn_cast<mlir::AffineStoreOp>(op)) {
+    access(storeOp.getMemRef(), storeOp.getValueToStore().getType(), times, stats);
+  } else if (auto vectorLoadOp = mlir::dyn_cast<mlir::AffineVectorLoadOp>(op)) {
+    access(vectorLoadOp.getMemRef(), vectorLoadOp.getResult().getType(), times, stats);
+  } else if (auto vectorStoreOp = mlir::dyn_cast<mlir::AffineVectorStoreOp>(op)) {
+    access(vectorStoreOp.getMemRef(), vectorStoreOp.getValueToStore().getType(), times, stats);
+  } else if (auto loadOp = mlir::dyn_cast<mlir::memref::LoadOp>(op)) {
+    access(loadOp.getMemRef(), loadOp.getResult().getType(), times, stats);
+  } else if (auto storeOp = mlir::dyn_cast<mlir::memref::StoreOp>(op)) {
+    access(storeOp.getMemRef(), storeOp.getValueToStore().getType(), times, stats);
+  } else if (auto loadOp = mlir::dyn_cast<mlir::vector::LoadOp>(op)) {
+    access(loadOp.getBase(), loadOp.getResult().getType(), times, stats);
+  } else if (auto storeOp = mlir::dyn_cast<mlir::vector::StoreOp>(op)) {
+    access(storeOp.getBase(), storeOp.getValueToStore().getType(), times, stats);
+  } else if (mlir::isa<mlir::gpu::BarrierOp>(op)) {
+    barrier(times, stats);
+  } else if (op->getNumResults() == 1 && !mlir::isa<mlir::arith::ConstantOp>(op)) {
+    auto dialect = op->getName().getDialectNamespace();
+    auto type = op->getResult(0).getType();
+    if ((dialect == "arith" || dialect == "math") && mlir::getElementTypeOrSelf(type).isa<mlir::FloatType>()) {
+      stats.flops += times * getLanes(type);
+    }
+  }
+  // affine.if and the others are counted as taken.
+  for (auto& region : op->getRegions()) {
+    for (auto& block : region) count(block, times, stats);
+  }
+}
+
+template <typename Stats>
+void count(mlir::Block& block, double times, Stats& stats) {
+  for (auto& op : block) count(&op, times, stats);
+}
+
+int64_t ceilDiv(int64_t x, int64_t y) {
+  return y == 0 ? 0 : (x + y - 1) / y;
+}
+
+std::map<std::string, int64_t> countCalls(mlir::ModuleOp& module) {
+  std::map<std::string, int64_t> calls;
+  module.walk([&](mlir::func::CallOp callOp) {
+    calls[callOp.getCallee().str()] += 1;
+  });
+  return calls;
+}
+
+}
+
+FuncStats AnalyticalEvaluator::collectStats(mlir::func::FuncOp func) {
+  FuncStats stats;
+  if (func.isExternal()) return stats;
+  for (auto& block : func.getBody()) count(block, 1.0, stats);
+  func.walk([&](mlir::AffineParallelOp parallelOp) {
+    if (!parallelOp->getParentOfType<mlir::AffineParallelOp>()) stats.kernels += 1;
+  });
+  return stats;
+}
+
+std::map<std::string, FuncStats> AnalyticalEvaluator::collectStats(mlir::ModuleOp& module) {
+  std::map<std::string, FuncStats> result;
+  auto calls = countCalls(module);
+  module.walk([&](mlir::func::FuncOp func) {
+    if (func.isExternal()) return;
+    auto symbol = func.getSymName().str();
+    auto stats = collectStats(func);
+    if (calls.count(symbol)) stats.calls = calls[symbol];
+    result[symbol] = stats;
+  });
+  return std::move(result);
+}
+
+double AnalyticalEvaluator::funcLatency(const FuncStats& stats, const DeviceProfile& device) {
+  double seconds = 0.0;
+  if (stats.kernels == 0) {
+    seconds = stats.flops / (device.hostGFlops * 1e9) + stats.globalBytes / (device.hostBandwidthGBs * 1e9);
+  } else {
+    auto compute = stats.flops / (device.peakGFlops * 1e9);
+    auto global = stats.globalBytes / (device.memBandwidthGBs * 1e9);
+    auto shared = stats.sharedBytes / (device.sharedBandwidthGBs * 1e9);
+    seconds = std::max({compute, global, shared}) + stats.kernels * device.launchOverheadUs * 1e-6;
+    return seconds * 1e3 * device.latencyScale + stats.kernels * device.latencyOffsetUs * 1e-3;
+  }
+  return seconds * 1e3;
+}
+
+float AnalyticalEvaluator::evaluate(mlir::ModuleOp& module, const DeviceProfile& device) {
+  double total = 0.0;
+  for (auto& item : collectStats(module)) {
+    total += funcLatency(item.second, device) * item.second.calls;
+  }
+  return static_cast<float>(total);
+}
+
+/*------------------------------roofline------------------------------*/
+std::vector<KernelStats> RooflineEvaluator::collectKernels(mlir::func::FuncOp func, int64_t traceBlocks) {
+  std::vector<KernelStats> result;
+  if (func.isExternal()) return result;
+  for (auto& op : func.getBody().front()) {
+    auto gridLevel = mlir::dyn_cast<mlir::AffineParallelOp>(&op);
+    if (!gridLevel || !gridLevel.getConstantRanges()) continue;
+    KernelStats kernel;
+    kernel.symbol = func.getSymName().str();
+    for (auto range : *gridLevel.getConstantRanges()) kernel.grid.push_back(range);
+    gridLevel.getBody()->walk<mlir::WalkOrder::PreOrder>([&](mlir::AffineParallelOp blockLevel) {
+      if (!kernel.block.empty() || !blockLevel.getConstantRanges()) return;
+      for (auto range : *blockLevel.getConstantRanges()) kernel.block.push_back(range);
+    });
+    for (auto dim : kernel.grid) kernel.blocks *= dim;
+    for (auto dim : kernel.block) kernel.threads *= dim;
+
+    // counted for one block, the thread level multiplies by the threads.
+    count(*gridLevel.getBody(), 1.0, kernel);
+    // every thread of the block meets the same barriers.
+    kernel.barriers /= kernel.threads;
+    kernel.sharedAlloc = Analyzer::getSharedBytes(gridLevel);
+    kernel.registers = Analyzer::estimateRegisters(gridLevel).total();
+    if (traceBlocks > 0) {
+      auto trace = MemoryTracer::trace(gridLevel, traceBlocks);
+      kernel.bankConflictDegree = trace.bankConflictDegree();
+      kernel.sectorEfficiency = trace.sectorEfficiency();
+    } else {
+      kernel.bankConflictDegree = AccessAnalyzer::bankConflictDegree(AccessAnalyzer::bankConflicts(gridLevel));
+      kernel.sectorEfficiency = AccessAnalyzer::sectorEfficiency(AccessAnalyzer::coalescings(gridLevel));
+    }
+    result.push_back(std::move(kernel));
+  }
+  return std::move(result);
+}
+
+double RooflineEvaluator::kernelLatency(const KernelStats& kernel, const DeviceProfile& device) {
+  auto occupancy = Analyzer::getOccupancy(kernel.blocks, kernel.threads, kernel.registers, kernel.sharedAlloc, device);
+  auto slots = std::max<int64_t>(1, occupancy.blocksPerSM * device.smCount);
+  auto smFlops = device.peakGFlops * 1e9 / device.smCount;
+  auto smShared = device.sharedBandwidthGBs * 1e9 / device.smCount;
+
+  // a wave of n resident blocks: compute and shared traffic are limited per SM, global traffic per device,
+  // and the barrier stalls are hidden by the other blocks resident on the SM.
+  auto waveTime = [&](int64_t n) {
+    double resident = ceilDiv(n, device.smCount);
+    auto compute = resident * kernel.flops / smFlops;
+    auto shared = resident * kernel.sharedBytes * kernel.bankConflictDegree / smShared;
+    auto global = n * kernel.globalBytes / std::max(kernel.sectorEfficiency, 1e-3) / (device.memBandwidthGBs * 1e9);
+    auto barriers = kernel.barriers * device.barrierCycles / (device.clockGHz * 1e9) / resident;
+    return std::max({compute, shared, global}) + barriers;
+  };
+
+  auto fullWaves = kernel.blocks / slots;
+  auto tail = kernel.blocks % slots;
+  auto seconds = fullWaves * waveTime(slots) + (tail ? waveTime(tail) : 0.0);
+  return (seconds + device.launchOverheadUs * 1e-6) * 1e3 * device.latencyScale + device.latencyOffsetUs * 1e-3;
+}
+
+float RooflineEvaluator::evaluate(mlir::ModuleOp& module, const DeviceProfile& device) {
+  auto calls = countCalls(module);
+  double total = 0.0;
+  module.walk([&](mlir::func::FuncOp func) {
+    if (func.isExternal()) return;
+    auto symbol = func.getSymName().str();
+    auto times = calls.count(symbol) ? calls[symbol] : 1;
+    auto kernels = collectKernels(func, traceBlocks);
+    // the functions left on the host keep the analytical model.
+    if (kernels.empty()) {
+      total += AnalyticalEvaluator::funcLatency(AnalyticalEvaluator::collectStats(func), device) * times;
+      return;
+    }
+    for (auto& kernel : kernels) total += kernelLatency(kernel, device) * times;
+  });
+  return static_cast<float>(total);
+}
+
+/*--------------------------------host--------------------------------*/
+mlir::ModuleOp HostEvaluator::buildBenchModule(mlir::ModuleOp& module, std::vector<std::string>& entries) {
+  auto bench = mlir::dyn_cast<mlir::ModuleOp>(module->clone());
+  auto loc = bench.getLoc();
+
+  // the graph allocates and calls at the module level, which can't be lowered.
+  std::vector<mlir::Operation*> graphOps;
+  std::vector<mlir::func::FuncOp> funcs;
+  for (auto& op : bench.getBody()->getOperations()) {
+    if (auto func = mlir::dyn_cast<mlir::func::FuncOp>(op)) {
+      if (!func.isExternal()) funcs.push_back(func);
+    } else {
+      graphOps.push_back(&op);
+    }
+  }
+  for (auto iter = graphOps.rbegin(); iter != graphOps.rend(); ++iter) {
+    (*iter)->dropAllUses();
+    (*iter)->erase();
+  }
+
+  // a thread runs the whole block, so barriers are useless and a shuffle sees only its own lane.
+  bench.walk([&](mlir::gpu::BarrierOp barrierOp) {
+    barrierOp.erase();
+  });
+  bench.walk([&](mlir::gpu::ShuffleOp shflOp) {
+    mlir::OpBuilder b(shflOp);
+    auto valid = b.create<mlir::arith::ConstantIntOp>(shflOp.getLoc(), 1, 1);
+    shflOp.getResult(0).replaceAllUsesWith(shflOp.value());
+    shflOp.getResult(1).replaceAllUsesWith(valid.getResult());
+    shflOp.erase();
+  });
+
+  mlir::OpBuilder builder(bench.getContext());
+  builder.setInsertionPointToEnd(bench.getBody());
+  for (auto func : funcs) {
+    auto inputs = func.getFunctionType().getInputs();
+    bool staticArgs = true;
+    for (auto type : inputs) {
+      auto memrefType = type.dyn_cast<mlir::MemRefType>();
+      staticArgs = staticArgs && memrefType && memrefType.hasStaticShape();
+    }
+    if (!staticArgs) {
+      llvm::errs() << "Skip the host evaluation of " << func.getSymName() << "\n";
+      continue;
+    }
+    auto entryName = "bench_" + func.getSymName().str();
+    auto entry = builder.create<mlir::func::FuncOp>(loc, entryName, builder.getFunctionType({}, {}));
+    auto& block = *entry.addEntryBlock();
+    auto b = mlir::OpBuilder::atBlockEnd(&block);
+    llvm::SmallVector<mlir::Value> args;
+    for (auto type : inputs) {
+      auto memrefType = type.dyn_cast<mlir::MemRefType>();
+      auto arg = b.create<mlir::memref::AllocOp>(loc, memrefType).getResult();
+      args.push_back(arg);
+      // zero indices stay in bounds, and a finite constant keeps NaNs and denormals out of the timings.
+      auto elementType = memrefType.getElementType();
+      mlir::Value fill;
+      if (elementType.isa<mlir::FloatType>()) {
+        fill = b.create<mlir::arith::ConstantOp>(loc, b.getFloatAttr(elementType, 1.0));
+      } else {
+        fill = b.create<mlir::arith::ConstantOp>(loc, b.getZeroAttr(elementType));
+      }
+      mlir::buildAffineLoopNest(b, loc, mlir::SmallVector<int64_t>(memrefType.getRank(), 0), memrefType.getShape(),
+        mlir::SmallVector<int64_t>(memrefType.getRank(), 1),
+        [&](mlir::OpBuilder& nestedBuilder, mlir::Location nestedLoc, mlir::ValueRange ivs) {
+          nestedBuilder.create<mlir::AffineStoreOp>(nestedLoc, fill, arg, ivs);
+        });
+    }
+    auto callOp = b.create<mlir::func::CallOp>(loc, func, args);
+    for (auto arg : args) b.create<mlir::memref::DeallocOp>(loc, arg);
+    // the results the callee allocated are freed as well, the ones which return an argument are not.
+    auto returnOp = mlir::dyn_cast<mlir::func::ReturnOp>(func.front().getTerminator());
+    std::set<mlir::Operation*> freed;
+    for (int i = 0; returnOp && i < returnOp.getNumOperands(); i++) {
+      auto allocOp = returnOp.getOperand(i).getDefiningOp<mlir::memref::AllocOp>();
+      if (!allocOp || !freed.insert(allocOp).second) continue;
+      b.create<mlir::memref::DeallocOp>(loc, callOp.getResult(i));
+    }
+    b.create<mlir::func::ReturnOp>(loc);
+    entries.push_back(entryName);
+  }
+  return bench;
+}
+
+bool HostEvaluator::lowerToLLVM(mlir::ModuleOp& module) {
+  mlir::PassManager pm(module.getContext());
+  pm.addPass(mlir::createLowerAffinePass());
+  pm.addPass(mlir::createConvertSCFToCFPass());
+  pm.addPass(mlir::createConvertVectorToLLVMPass());
+  pm.addPass(mlir::createConvertMathToLLVMPass());
+  pm.addPass(mlir::arith::createConvertArithmeticToLLVMPass());
+  pm.addPass(mlir::createMemRefToLLVMPass());
+  pm.addPass(mlir::cf::createConvertControlFlowToLLVMPass());
+  pm.addPass(mlir::createConvertFuncToLLVMPass());
+  pm.addPass(mlir::createReconcileUnrealizedCastsPass());
+  return mlir::succeeded(pm.run(module));
+}
+
+float HostEvaluator::evaluate(mlir::ModuleOp& module, const DeviceProfile& device) {
+  static std::once_flag initTarget;
+  std::call_once(initTarget, []() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+  });
+
+  auto calls = countCalls(module);
+  std::vector<std::string> entries;
+  auto bench = buildBenchModule(module, entries);
+  mlir::registerLLVMDialectTranslation(*bench.getContext());
+  if (entries.empty() || !lowerToLLVM(bench)) {
+    llvm::errs() << "Failed to lower the module for the host evaluation\n";
+    bench->erase();
+    return FLT_MAX;
+  }
+
+  mlir::ExecutionEngineOptions options;
+  options.transformer = mlir::makeOptimizingTransformer(/*optLevel=*/2, /*sizeLevel=*/0, /*targetMachine=*/nullptr);
+  auto maybeEngine = mlir::ExecutionEngine::create(bench, options);
+  bench->erase();
+  if (!maybeEngine) {
+    llvm::errs() << "Failed to create the execution engine: " << llvm::toString(maybeEngine.takeError()) << "\n";
+    return FLT_MAX;
+  }
+  auto& engine = maybeEngine.get();
+
+  double total = 0.0;
+  for (auto& entry : entries) {
+    double best = DBL_MAX;
+    // the first run warms up the caches and the lazy symbol resolution.
+    for (int i = 0; i <= repeats; i++) {
+      auto start = std::chrono::steady_clock::now();
+      if (auto error = engine->invokePacked(entry)) {
+        llvm::errs() << "Failed to run " << entry << ": " << llvm::toString(std::move(error)) << "\n";
+        return FLT_MAX;
+      }
+      auto end = std::chrono::steady_clock::now();
+      if (i != 0) best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    auto symbol = entry.substr(std::string("bench_").size());
+    total += best * (calls.count(symbol) ? calls[symbol] : 1);
+  }
+  return static_cast<float>(total);
+}
+
+}
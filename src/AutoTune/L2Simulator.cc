@@ -0,0 +1,127 @@
+#include "AutoTune/L2Simulator.h"
+
+#include <algorithm>
+
+namespace KernelCodeGen {
+
+namespace {
+
+int64_t ceilDiv(int64_t x, int64_t y) {
+  return y == 0 ? 0 : (x + y - 1) / y;
+}
+
+// set associative with LRU replacement. The lines are hashed to the sets like the L2 of a GPU does,
+// mapping by the low bits would make the power of two row strides of the tiles fight for a few sets.
+class L2Cache {
+public:
+  L2Cache(const L2Config& l2) : ways(std::max<int64_t>(1, l2.ways)) {
+    sets = std::max<int64_t>(1, l2.sizeBytes / (l2.lineBytes * ways));
+    tags.assign(sets * ways, -1);
+    stamps.assign(sets * ways, 0);
+  }
+
+  bool access(int64_t line) {
+    auto hash = (static_cast<uint64_t>(line) * 0x9E3779B97F4A7C15ull) >> 20;
+    auto base = static_cast<int64_t>(hash % sets) * ways;
+    auto victim = base;
+    clock += 1;
+    for (auto way = base; way < base + ways; way++) {
+      if (tags[way] == line) {
+        stamps[way] = clock;
+        return true;
+      }
+      if (stamps[way] < stamps[victim]) victim = way;
+    }
+    tags[victim] = line;
+    stamps[victim] = clock;
+    return false;
+  }
+
+private:
+  int64_t ways;
+  int64_t sets;
+  uint64_t clock = 0;
+  std::vector<int64_t> tags;
+  std::vector<uint64_t> stamps;
+};
+
+// the lines of a rows x cols tile of a row major matrix starting at (row, col).
+void touch(L2Cache& cache, L2Stats& stats, int64_t base, int64_t rows, int64_t cols, int64_t row, int64_t col,
+           int64_t height, int64_t width, int64_t elementBytes) {
+  height = std::min(height, rows - row);
+  width = std::min(width, cols - col);
+  if (height <= 0 || width <= 0) return;
+  for (int64_t r = row; r < row + height; r++) {
+    auto first = base + (r * cols + col) * elementBytes;
+    auto last = first + width * elementBytes - 1;
+    for (auto line = first / stats.lineBytes; line <= last / stats.lineBytes; line++) {
+      stats.accesses += 1;
+      if (cache.access(line)) stats.hits += 1;
+    }
+  }
+}
+
+}
+
+L2Config L2Config::fromDevice(const DeviceProfile& device, int64_t blocksPerSM) {
+  L2Config l2;
+  l2.sizeBytes = device.l2Bytes;
+  l2.lineBytes = device.l2LineBytes;
+  l2.ways = device.l2Ways;
+  l2.concurrentBlocks = std::max<int64_t>(1, device.smCount * blocksPerSM);
+  return l2;
+}
+
+std::vector<std::pair<int64_t, int64_t>> L2Simulator::rasterize(int64_t gridM, int64_t gridN, int64_t groupSizeM) {
+  std::vector<std::pair<int64_t, int64_t>> order;
+  groupSizeM = std::max<int64_t>(1, groupSizeM);
+  for (int64_t pid = 0; pid < gridM * gridN; pid++) {
+    if (groupSizeM == 1) {
+      order.push_back({pid / gridN, pid % gridN});
+      continue;
+    }
+    // the last group may have fewer tile rows.
+    auto group = pid / (groupSizeM * gridN);
+    auto firstM = group * groupSizeM;
+    auto groupRows = std::min(gridM - firstM, groupSizeM);
+    auto local = pid % (groupSizeM * gridN);
+    order.push_back({firstM + local % groupRows, local / groupRows});
+  }
+  return order;
+}
+
+L2Stats L2Simulator::simulateGemm(const GemmTiling& tiling, const L2Config& l2, int64_t maxWaves) {
+  auto order = rasterize(ceilDiv(tiling.m, tiling.blockM), ceilDiv(tiling.n, tiling.blockN), tiling.groupSizeM);
+  return simulateGemm(tiling, order, l2, maxWaves);
+}
+
+L2Stats L2Simulator::simulateGemm(const GemmTiling& tiling, const std::vector<std::pair<int64_t, int64_t>>& order,
+                                  const L2Config& l2, int64_t maxWaves) {
+  L2Stats stats;
+  stats.lineBytes = l2.lineBytes;
+  stats.blocks = order.size();
+  if (order.empty() || tiling.blockK <= 0) return stats;
+
+  L2Cache cache(l2);
+  // B starts on the line after A.
+  auto baseA = int64_t(0);
+  auto baseB = ceilDiv(tiling.m * tiling.k * tiling.elementBytes, l2.lineBytes) * l2.lineBytes;
+  auto wave = std::max<int64_t>(1, l2.concurrentBlocks);
+  auto steps = ceilDiv(tiling.k, tiling.blockK);
+  for (int64_t start = 0, waves = 0; start < order.size(); start += wave, waves++) {
+    if (maxWaves > 0 && waves == maxWaves) break;
+    auto end = std::min<int64_t>(order.size(), start + wave);
+    for (int64_t step = 0; step < steps; step++) {
+      auto k = step * tiling.blockK;
+      for (auto block = start; block < end; block++) {
+        auto row = order[block].first * tiling.blockM, col = order[block].second * tiling.blockN;
+        touch(cache, stats, baseA, tiling.m, tiling.k, row, k, tiling.blockM, tiling.blockK, tiling.elementBytes);
+        touch(cache, stats, baseB, tiling.k, tiling.n, k, col, tiling.blockK, tiling.blockN, tiling.elementBytes);
+      }
+    }
+    stats.simulatedBlocks += end - start;
+  }
+  return stats;
+}
+
+}
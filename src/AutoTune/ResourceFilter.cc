@@ -0,0 +1,95 @@
+#include "AutoTune/ResourceFilter.h"
+#include "Optimizer/Analyzer.h"
+
+#include <algorithm>
+
+namespace KernelCodeGen {
+
+namespace {
+
+int64_t at(const TuneConfig& config, const std::string& key) {
+  auto iter = config.find(key);
+  return iter == config.end() ? 0 : iter->second;
+}
+
+int64_t ceilDiv(int64_t x, int64_t y) {
+  return y == 0 ? 0 : (x + y - 1) / y;
+}
+
+// registers reserved for indices, addresses and loop counters.
+const int64_t addressRegisters = 24;
+
+}
+
+ResourceUsage ResourceFilter::estimate(const std::string& optName, const TuneConfig& config, const OpShape& shape,
+                                       const DeviceProfile& device) {
+  ResourceUsage usage;
+  // a register holds 4 bytes, wider elements take more of them.
+  auto words = std::max<int64_t>(1, shape.elementBytes / 4);
+  int64_t buffers = 0;
+
+  if (optName == "Matmul" || optName == "BatchMatmul") {
+    auto BM = at(config, "BLOCK_SIZE_M"), BN = at(config, "BLOCK_SIZE_N"), BK = at(config, "BLOCK_SIZE_K");
+    auto TM = at(config, "THREAD_SIZE_M"), TN = at(config, "THREAD_SIZE_N");
+    usage.threads = TM && TN ? (BM / TM) * (BN / TN) : 0;
+    // smA and smB are double buffered.
+    usage.sharedBytes = 2 * BK * (BM + BN) * shape.elementBytes;
+    // tileC + fragA/fragB + tileA/tileB
+    buffers = TM * TN + TM + TN;
+    if (usage.threads) buffers += ceilDiv(BK * BM, usage.threads) + ceilDiv(BK * BN, usage.threads);
+  } else if (optName == "Binary" || optName == "ElementWise" || optName == "Gather") {
+    auto TM = at(config, "THREAD_SIZE_M"), TN = at(config, "THREAD_SIZE_N");
+    usage.threads = TM && TN ? (at(config, "BLOCK_SIZE_M") / TM) * (at(config, "BLOCK_SIZE_N") / TN) : 0;
+    // two fragments of a row.
+    buffers = 2 * TN;
+  } else if (optName == "LayerNorm") {
+    auto threadSize = at(config, "THREAD_SIZE");
+    usage.threads = threadSize ? at(config, "BLOCK_SIZE") / threadSize : 0;
+    // input, scale and bias staged in shared memory.
+    usage.sharedBytes = 3 * at(config, "BLOCK_SIZE") * shape.elementBytes;
+    buffers = at(config, "VECTORIZE_WIDTH") + 4;
+  } else if (optName == "FMHA") {
+    auto blockSize = at(config, "BLOCK_SIZE"), slice = at(config, "Slice");
+    auto Br = shape.k ? at(config, "HdxBr") / shape.k : 0;
+    auto Bc = Br ? at(config, "BrxBc") / Br : 0;
+    auto BrTileS = at(config, "BrTileS"), BcTileS = at(config, "BcTileS");
+    auto BrTileO = at(config, "BrTileO"), HdTileO = at(config, "HdTileO");
+    usage.threads = blockSize;
+    // smQ, smK/smV, smP, smMax/smSum/smFac
+    usage.sharedBytes = (slice * Br + 2 * slice * Bc + Br * Bc + 3 * Br) * shape.elementBytes;
+    // tileO, tileS, ldgQ/ldgK/ldgV, fragQ/fragK, rowMax/rowSum, factor, fragP/fragV, rowSumO
+    buffers = BrTileO * HdTileO + BrTileS * BcTileS + 2 * BrTileS + BcTileS + 2 * BrTileS + 3 * BrTileO + HdTileO;
+    if (blockSize) buffers += ceilDiv(slice * Br, blockSize) + 2 * ceilDiv(slice * Bc, blockSize);
+  }
+
+  usage.registers = buffers * words + addressRegisters;
+  usage.blocksPerSM = Analyzer::getBlocksPerSM(usage.threads, usage.registers, usage.sharedBytes, device);
+  usage.occupancy = 1.0f * usage.blocksPerSM * ceilDiv(usage.threads, device.warpSize) / device.maxWarpsPerSM;
+  return usage;
+}
+
+bool ResourceFilter::feasible(const ResourceUsage& usage, const DeviceProfile& device, float minOccupancy,
+                              std::string* reason) {
+  auto reject = [&](const std::string& why) {
+    if (reason) *reason = why;
+    return false;
+  };
+  if (usage.threads <= 0 || usage.threads > device.maxThreadsPerBlock) return reject("threads per block");
+  if (usage.sharedBytes > device.maxSharedMemPerBlock) return reject("shared memory");
+  if (usage.registers > device.maxRegistersPerThread) return reject("registers");
+  if (usage.blocksPerSM == 0) return reject("no block fits on a SM");
+  if (usage.occupancy < minOccupancy) return reject("occupancy");
+  return true;
+}
+
+std::vector<TuneConfig> ResourceFilter::filter(const std::string& optName, const std::vector<TuneConfig>& configs,
+                                               const OpShape& shape, const DeviceProfile& device, float minOccupancy) {
+  std::vector<TuneConfig> result;
+  for (auto& config : configs) {
+    auto usage = estimate(optName, config, shape, device);
+    if (feasible(usage, device, minOccupancy)) result.push_back(config);
+  }
+  return std::move(result);
+}
+
+}
@@ -0,0 +1,481 @@
+#include "AutoTune/SearchSpace.h"
+#include "AutoTune/L2Simulator.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace KernelCodeGen {
+
+namespace {
+
+std::vector<int> pow2Range(int lower, int upper) {
+  std::vector<int> result;
+  for (int value = lower; value <= upper; value *= 2) {
+    result.push_back(value);
+  }
+  return result;
+}
+
+int64_t at(const TuneConfig& config, const std::string& key) {
+  auto iter = config.find(key);
+  return iter == config.end() ? 0 : iter->second;
+}
+
+bool divisible(int64_t x, int64_t y) {
+  return y > 0 && x % y == 0;
+}
+
+int64_t getElementBytes(mlir::Value value) {
+  auto type = value.getType().dyn_cast<mlir::MemRefType>();
+  if (!type) return 4;
+  return std::max<int64_t>(1, type.getElementTypeBitWidth() / 8);
+}
+
+std::string getDType(mlir::Value value) {
+  auto type = value.getType().dyn_cast<mlir::MemRefType>();
+  if (!type) return "f32";
+  std::string dtype;
+  llvm::raw_string_ostream os(dtype);
+  type.getElementType().print(os);
+  return os.str();
+}
+
+std::vector<int64_t> getShape(mlir::Value value) {
+  auto type = value.getType().dyn_cast<mlir::MemRefType>();
+  if (!type) return {};
+  auto shape = type.getShape();
+  return std::vector<int64_t>(shape.begin(), shape.end());
+}
+
+// collapse to rows x last dim, the same view as Rewriter::combineToTowDim.
+void setTwoDim(OpShape& opShape, const std::vector<int64_t>& shape) {
+  if (shape.empty()) return;
+  opShape.n = shape.back();
+  opShape.m = 1;
+  for (int i = 0; i < shape.size() - 1; i++) opShape.m *= shape[i];
+}
+
+// threads/block within the device and a whole number of warps.
+ParamSpace::Constraint threadsConstraint(std::function<int64_t(const TuneConfig&)> threads) {
+  return [threads](const TuneConfig& config, const OpShape& shape, const DeviceProfile& device) {
+    auto num = threads(config);
+    return num >= device.warpSize && num <= device.maxThreadsPerBlock && divisible(num, device.warpSize);
+  };
+}
+
+// vector loads must not be wider than the device allows and must align with the contiguous dim.
+ParamSpace::Constraint vectorConstraint(const std::string& widthKey, std::function<int64_t(const OpShape&)> contiguous) {
+  return [widthKey, contiguous](const TuneConfig& config, const OpShape& shape, const DeviceProfile& device) {
+    auto width = at(config, widthKey);
+    return width * shape.elementBytes <= device.maxVectorBytes && divisible(contiguous(shape), width);
+  };
+}
+
+// shared memory in elements, checked against the byte budget of one block.
+ParamSpace::Constraint sharedConstraint(std::function<int64_t(const TuneConfig&)> elements) {
+  return [elements](const TuneConfig& config, const OpShape& shape, const DeviceProfile& device) {
+    return elements(config) * shape.elementBytes <= device.maxSharedMemPerBlock;
+  };
+}
+
+// resident blocks of a matmul config per SM as bounded by its warps and shared memory, the registers are unknown
+// before the kernel is built.
+int64_t matmulBlocksPerSM(const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+  auto threads = (at(c, "BLOCK_SIZE_M") / at(c, "THREAD_SIZE_M")) * (at(c, "BLOCK_SIZE_N") / at(c, "THREAD_SIZE_N"));
+  auto warps = std::max<int64_t>(1, threads / d.warpSize);
+  auto shared = 2 * at(c, "BLOCK_SIZE_K") * (at(c, "BLOCK_SIZE_M") + at(c, "BLOCK_SIZE_N")) * s.elementBytes +
+                d.reservedSharedMemPerBlock;
+  return std::max<int64_t>(1, std::min({d.maxBlocksPerSM, d.maxWarpsPerSM / warps, d.sharedMemPerSM / shared}));
+}
+
+// GROUP_SIZE_M of every config is the group size with the least DRAM traffic L2Simulator predicts for the first
+// waves of its tiles. The blocks of a wave step through k together, so a few k steps show the reuse as well as all
+// of them and keep the simulation cheap; configs with the same block tile share the result.
+void chooseGroupSizeM(std::vector<TuneConfig>& configs, const OpShape& s, const DeviceProfile& d) {
+  std::map<std::tuple<int64_t, int64_t, int64_t>, int> chosen;
+  for (auto& config : configs) {
+    auto key = std::make_tuple(at(config, "BLOCK_SIZE_M"), at(config, "BLOCK_SIZE_N"), at(config, "BLOCK_SIZE_K"));
+    auto iter = chosen.find(key);
+    if (iter == chosen.end()) {
+      GemmTiling tiling;
+      tiling.m = s.m; tiling.n = s.n;
+      tiling.blockM = std::get<0>(key); tiling.blockN = std::get<1>(key); tiling.blockK = std::get<2>(key);
+      tiling.k = std::min(s.k, 4 * tiling.blockK);
+      tiling.elementBytes = s.elementBytes;
+      auto l2 = L2Config::fromDevice(d, matmulBlocksPerSM(config, s, d));
+      // a larger group only wins if it saves traffic, ties keep the plain row major launch.
+      int best = 1;
+      int64_t bestBytes = -1;
+      for (auto group : pow2Range(1, 16)) {
+        if (!divisible(s.m / tiling.blockM, group)) continue;
+        tiling.groupSizeM = group;
+        auto bytes = L2Simulator::simulateGemm(tiling, l2, /*maxWaves*/2).dramBytes();
+        if (bestBytes < 0 || bytes < bestBytes) {
+          best = group;
+          bestBytes = bytes;
+        }
+      }
+      iter = chosen.emplace(key, best).first;
+    }
+    config["GROUP_SIZE_M"] = iter->second;
+  }
+}
+
+}
+
+/*-------------------------------matmul-------------------------------*/
+// The warp layout of MatmulOptimizer::getAffineMap is fixed to 2x4 warps of 8x4 lanes,
+// so a block always has 16x16 threads and every thread owns a TM x TN tile.
+ParamSpace SearchSpace::matmulSpace() {
+  ParamSpace space;
+  space.params = {
+    {"BLOCK_SIZE_M", pow2Range(32, 256)}, {"BLOCK_SIZE_N", pow2Range(32, 256)}, {"BLOCK_SIZE_K", pow2Range(4, 32)},
+    {"THREAD_SIZE_M", pow2Range(2, 16)}, {"THREAD_SIZE_N", pow2Range(2, 16)}, {"VECTORIZE_WIDTH", pow2Range(1, 4)}
+  };
+  // GROUP_SIZE_M starts row major and is picked by the L2 simulator once the legal tiles are known.
+  space.fixed = {{"GROUP_SIZE_M", 1}, {"WARP_SIZE", 32}};
+  space.choose = chooseGroupSizeM;
+  auto threads = [](const TuneConfig& c) {
+    return (at(c, "BLOCK_SIZE_M") / at(c, "THREAD_SIZE_M")) * (at(c, "BLOCK_SIZE_N") / at(c, "THREAD_SIZE_N"));
+  };
+  space.constraints = {
+    [](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      return divisible(s.m, at(c, "BLOCK_SIZE_M")) && divisible(s.n, at(c, "BLOCK_SIZE_N")) && divisible(s.k, at(c, "BLOCK_SIZE_K"));
+    },
+    // Rewriter::swizzleGrid needs whole groups of tile rows.
+    [](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      return divisible(s.m / std::max<int64_t>(1, at(c, "BLOCK_SIZE_M")), at(c, "GROUP_SIZE_M"));
+    },
+    [](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      return at(c, "BLOCK_SIZE_M") / at(c, "THREAD_SIZE_M") == 16 && at(c, "BLOCK_SIZE_N") / at(c, "THREAD_SIZE_N") == 16;
+    },
+    threadsConstraint(threads),
+    [threads](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      auto width = at(c, "VECTORIZE_WIDTH");
+      auto ldgA = at(c, "BLOCK_SIZE_K") * at(c, "BLOCK_SIZE_M") / threads(c);
+      auto ldgB = at(c, "BLOCK_SIZE_K") * at(c, "BLOCK_SIZE_N") / threads(c);
+      return divisible(ldgA, width) && divisible(ldgB, width) && divisible(at(c, "BLOCK_SIZE_K"), width) &&
+             divisible(at(c, "THREAD_SIZE_M"), width) && divisible(at(c, "THREAD_SIZE_N"), width);
+    },
+    vectorConstraint("VECTORIZE_WIDTH", [](const OpShape& s) { return s.k; }),
+    vectorConstraint("VECTORIZE_WIDTH", [](const OpShape& s) { return s.n; }),
+    // tiles of A and B are double buffered by Rewriter::pipeline.
+    sharedConstraint([](const TuneConfig& c) {
+      return 2 * at(c, "BLOCK_SIZE_K") * (at(c, "BLOCK_SIZE_M") + at(c, "BLOCK_SIZE_N"));
+    })
+  };
+  return space;
+}
+
+/*----------------------------batch matmul----------------------------*/
+// 4 warps along x of 8x4 lanes, the C tile is written back with BLOCK_SIZE_M on both dims.
+ParamSpace SearchSpace::batchMatmulSpace() {
+  ParamSpace space;
+  space.params = {
+    {"BLOCK_SIZE_M", pow2Range(32, 256)}, {"BLOCK_SIZE_N", pow2Range(32, 256)}, {"BLOCK_SIZE_K", pow2Range(4, 32)},
+    {"THREAD_SIZE_M", pow2Range(2, 16)}, {"THREAD_SIZE_N", pow2Range(2, 16)}, {"VECTORIZE_WIDTH", pow2Range(1, 4)}
+  };
+  space.fixed = {{"WARP_SIZE", 32}};
+  auto threads = [](const TuneConfig& c) {
+    return (at(c, "BLOCK_SIZE_M") / at(c, "THREAD_SIZE_M")) * (at(c, "BLOCK_SIZE_N") / at(c, "THREAD_SIZE_N"));
+  };
+  space.constraints = {
+    [](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      return divisible(s.m, at(c, "BLOCK_SIZE_M")) && divisible(s.n, at(c, "BLOCK_SIZE_N")) && divisible(s.k, at(c, "BLOCK_SIZE_K"));
+    },
+    [](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      return at(c, "BLOCK_SIZE_M") == at(c, "BLOCK_SIZE_N") && at(c, "BLOCK_SIZE_N") / at(c, "THREAD_SIZE_N") == 16;
+    },
+    threadsConstraint(threads),
+    [threads](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      return divisible(threads(c), 4 * d.warpSize);
+    },
+    [threads](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      auto width = at(c, "VECTORIZE_WIDTH");
+      auto ldgA = at(c, "BLOCK_SIZE_K") * at(c, "BLOCK_SIZE_M") / threads(c);
+      auto ldgB = at(c, "BLOCK_SIZE_K") * at(c, "BLOCK_SIZE_N") / threads(c);
+      return divisible(ldgA, width) && divisible(ldgB, width) && divisible(at(c, "BLOCK_SIZE_K"), width) &&
+             divisible(at(c, "THREAD_SIZE_M"), width) && divisible(at(c, "THREAD_SIZE_N"), width);
+    },
+    vectorConstraint("VECTORIZE_WIDTH", [](const OpShape& s) { return s.k; }),
+    vectorConstraint("VECTORIZE_WIDTH", [](const OpShape& s) { return s.n; }),
+    sharedConstraint([](const TuneConfig& c) {
+      return 2 * at(c, "BLOCK_SIZE_K") * (at(c, "BLOCK_SIZE_M") + at(c, "BLOCK_SIZE_N"));
+    })
+  };
+  return space;
+}
+
+/*--------------------------elementwise like--------------------------*/
+// Tails are guarded by Rewriter::irregularMat, so only the block shape and vector width are constrained.
+ParamSpace SearchSpace::binarySpace() {
+  ParamSpace space;
+  space.params = {
+    {"BLOCK_SIZE_M", pow2Range(16, 128)}, {"BLOCK_SIZE_N", pow2Range(16, 128)},
+    {"THREAD_SIZE_M", pow2Range(1, 8)}, {"THREAD_SIZE_N", pow2Range(1, 8)}, {"VECTORIZE_WIDTH", pow2Range(1, 4)}
+  };
+  auto threads = [](const TuneConfig& c) {
+    return (at(c, "BLOCK_SIZE_M") / at(c, "THREAD_SIZE_M")) * (at(c, "BLOCK_SIZE_N") / at(c, "THREAD_SIZE_N"));
+  };
+  space.constraints = {
+    [](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      return at(c, "BLOCK_SIZE_M") <= s.m * at(c, "THREAD_SIZE_M") && at(c, "BLOCK_SIZE_N") <= s.n * at(c, "THREAD_SIZE_N");
+    },
+    threadsConstraint(threads),
+    [](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      return divisible(at(c, "THREAD_SIZE_N"), at(c, "VECTORIZE_WIDTH"));
+    },
+    vectorConstraint("VECTORIZE_WIDTH", [](const OpShape& s) { return s.n; })
+  };
+  return space;
+}
+
+// ElementWise and Gather split both dims with the *_M knobs, so the block is square.
+ParamSpace SearchSpace::elementWiseSpace() {
+  auto space = binarySpace();
+  space.constraints.push_back([](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+    return at(c, "BLOCK_SIZE_M") == at(c, "BLOCK_SIZE_N") && at(c, "THREAD_SIZE_M") == at(c, "THREAD_SIZE_N");
+  });
+  return space;
+}
+
+ParamSpace SearchSpace::gatherSpace() {
+  return elementWiseSpace();
+}
+
+/*------------------------------layernorm-----------------------------*/
+// One block reduces a row, the reduce loop is split by BLOCK_SIZE and needs 3 shared arrays of it.
+ParamSpace SearchSpace::layerNormSpace() {
+  ParamSpace space;
+  space.params = {
+    {"BLOCK_SIZE", pow2Range(128, 4096)}, {"THREAD_SIZE", pow2Range(1, 16)}, {"VECTORIZE_WIDTH", pow2Range(1, 4)}
+  };
+  space.constraints = {
+    [](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      return divisible(s.n, at(c, "BLOCK_SIZE"));
+    },
+    threadsConstraint([](const TuneConfig& c) { return at(c, "BLOCK_SIZE") / at(c, "THREAD_SIZE"); }),
+    [](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      return divisible(at(c, "THREAD_SIZE"), at(c, "VECTORIZE_WIDTH"));
+    },
+    vectorConstraint("VECTORIZE_WIDTH", [](const OpShape& s) { return s.n; }),
+    sharedConstraint([](const TuneConfig& c) { return 3 * at(c, "BLOCK_SIZE"); })
+  };
+  return space;
+}
+
+/*--------------------------------fmha--------------------------------*/
+// Br/Bc are enumerated and finalized to the HdxBr/BrxBc keys read by FMHAOptimizer.
+ParamSpace SearchSpace::fmhaSpace() {
+  ParamSpace space;
+  space.params = {
+    {"BLOCK_SIZE", pow2Range(64, 256)}, {"Br", pow2Range(32, 128)}, {"Bc", pow2Range(32, 128)},
+    {"WarpX_O", pow2Range(1, 4)}, {"Slice", pow2Range(4, 16)}, {"BrTileS", pow2Range(4, 8)},
+    {"BcTileS", pow2Range(4, 8)}, {"BrTileO", pow2Range(4, 8)}, {"HdTileO", pow2Range(4, 8)}
+  };
+  space.fixed = {{"Width", 4}, {"WARP_SIZE", 32}};
+  space.finalize = [](TuneConfig& c, const OpShape& s) {
+    c["HdxBr"] = static_cast<int>(s.k * c["Br"]);
+    c["BrxBc"] = c["Br"] * c["Bc"];
+    c.erase("Br");
+    c.erase("Bc");
+  };
+  auto Br = [](const TuneConfig& c, const OpShape& s) { return at(c, "HdxBr") / s.k; };
+  auto Bc = [Br](const TuneConfig& c, const OpShape& s) {
+    auto br = Br(c, s);
+    return br == 0 ? 0 : at(c, "BrxBc") / br;
+  };
+  auto warps = [](const TuneConfig& c, const DeviceProfile& d) { return at(c, "BLOCK_SIZE") / d.warpSize; };
+  space.constraints = {
+    [Br, Bc](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      return divisible(s.m, Br(c, s)) && divisible(s.n, Bc(c, s)) && divisible(s.k, at(c, "Slice"));
+    },
+    threadsConstraint([](const TuneConfig& c) { return at(c, "BLOCK_SIZE"); }),
+    // S = Q * K^T: every warp owns LaneY_S x LaneX_S lanes of BrTileS x BcTileS.
+    [Br, Bc, warps](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      auto br = Br(c, s), bc = Bc(c, s);
+      if (!divisible(bc, at(c, "BcTileS"))) return false;
+      auto laneX = bc / at(c, "BcTileS");
+      if (!divisible(d.warpSize, laneX)) return false;
+      auto laneY = d.warpSize / laneX;
+      return warps(c, d) * laneY * at(c, "BrTileS") == br &&
+             at(c, "BLOCK_SIZE") * at(c, "BrTileS") * at(c, "BcTileS") == br * bc;
+    },
+    // O = P * V: WarpX_O warps along the head dim.
+    [Br, warps](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      auto br = Br(c, s);
+      auto warpX = at(c, "WarpX_O");
+      if (!divisible(warps(c, d), warpX) || !divisible(s.k, at(c, "HdTileO") * warpX)) return false;
+      auto laneX = s.k / at(c, "HdTileO") / warpX;
+      if (!divisible(d.warpSize, laneX)) return false;
+      auto laneY = d.warpSize / laneX;
+      return (warps(c, d) / warpX) * laneY * at(c, "BrTileO") == br &&
+             at(c, "BLOCK_SIZE") * at(c, "BrTileO") * at(c, "HdTileO") == br * s.k;
+    },
+    [Br, Bc](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      auto width = at(c, "Width");
+      auto perLoad = at(c, "BLOCK_SIZE") * width;
+      return divisible(at(c, "Slice"), width) && divisible(at(c, "Slice") * Br(c, s), perLoad) &&
+             divisible(at(c, "Slice") * Bc(c, s), perLoad) && divisible(at(c, "BrTileS"), width) &&
+             divisible(at(c, "BcTileS"), width) && divisible(at(c, "BrTileO"), width) && divisible(at(c, "HdTileO"), width);
+    },
+    vectorConstraint("Width", [](const OpShape& s) { return s.k; }),
+    // tiles of Q, double buffered K/V, S and the max/sum/factor rows.
+    [Br, Bc](const TuneConfig& c, const OpShape& s, const DeviceProfile& d) {
+      auto br = Br(c, s), bc = Bc(c, s), slice = at(c, "Slice");
+      return (slice * br + 2 * slice * bc + br * bc + 3 * br) * s.elementBytes <= d.maxSharedMemPerBlock;
+    }
+  };
+  return space;
+}
+
+const ParamSpace* SearchSpace::getParamSpace(const std::string& optName) {
+  static const std::map<std::string, ParamSpace> spaces = {
+    {"Matmul", matmulSpace()}, {"BatchMatmul", batchMatmulSpace()}, {"Binary", binarySpace()},
+    {"ElementWise", elementWiseSpace()}, {"Gather", gatherSpace()}, {"LayerNorm", layerNormSpace()},
+    {"FMHA", fmhaSpace()}
+  };
+  auto iter = spaces.find(optName);
+  if (iter == spaces.end()) return nullptr;
+  return &(iter->second);
+}
+
+bool SearchSpace::isLegal(const std::string& optName, const TuneConfig& config, const OpShape& shape,
+                          const DeviceProfile& device) {
+  auto space = getParamSpace(optName);
+  if (!space) return false;
+  return space->isLegal(config, shape, device);
+}
+
+std::vector<TuneConfig> SearchSpace::generate(const std::string& optName, const OpShape& shape,
+                                              const DeviceProfile& device) {
+  std::vector<TuneConfig> result;
+  auto space = getParamSpace(optName);
+  if (!space) return result;
+
+  // cartesian product of the knobs, odometer style.
+  auto& params = space->params;
+  std::vector<int> index(params.size(), 0);
+  while (true) {
+    TuneConfig config = space->fixed;
+    for (int i = 0; i < params.size(); i++) {
+      config[params[i].first] = params[i].second[index[i]];
+    }
+    if (space->finalize) space->finalize(config, shape);
+    if (space->isLegal(config, shape, device)) result.push_back(std::move(config));
+
+    int i = params.size() - 1;
+    for (; i >= 0; i--) {
+      if (++index[i] < params[i].second.size()) break;
+      index[i] = 0;
+    }
+    if (i < 0) break;
+  }
+  if (space->choose) space->choose(result, shape, device);
+  return std::move(result);
+}
+
+std::vector<OpShape> SearchSpace::collectShapes(Optimizer& opt, mlir::ModuleOp& module) {
+  std::vector<OpShape> result;
+  if (!opt.applicable(module)) return result;
+
+  // Optimizers are built without rtti, so downcast by name.
+  if (opt == MatmulOptimizer()) {
+    auto& matmul = static_cast<MatmulOptimizer&>(opt);
+    for (auto& item : matmul.matmulBuffers) {
+      auto func = item.first;
+      auto A = getShape(item.second.A), C = getShape(item.second.C);
+      if (A.size() != 2 || C.size() != 2) continue;
+      OpShape shape;
+      shape.symbol = func.getSymName().str();
+      shape.m = C[0]; shape.n = C[1];
+      shape.k = A[0] == C[0] ? A[1] : A[0];
+      shape.elementBytes = getElementBytes(item.second.C);
+      shape.dtype = getDType(item.second.C);
+      result.push_back(shape);
+    }
+  } else if (opt == BatchMatmulOptimizer()) {
+    auto& batchMatmul = static_cast<BatchMatmulOptimizer&>(opt);
+    for (auto& item : batchMatmul.batchMatmulBuffers) {
+      auto& desc = item.second.matmul;
+      OpShape shape;
+      shape.symbol = item.first.getSymName().str();
+      shape.m = desc.m; shape.n = desc.n; shape.k = desc.k;
+      shape.batch.assign(desc.batch.begin(), desc.batch.end());
+      shape.elementBytes = getElementBytes(item.second.C);
+      shape.dtype = getDType(item.second.C);
+      result.push_back(shape);
+    }
+  } else if (opt == FMHAOptimizer()) {
+    auto& fmha = static_cast<FMHAOptimizer&>(opt);
+    for (auto& item : fmha.call2bufferMap) {
+      auto& desc = item.second.matmul1;
+      OpShape shape;
+      shape.symbol = item.first.getCallee().str();
+      shape.m = desc.m; shape.n = desc.n; shape.k = desc.k;
+      shape.batch.assign(desc.batch.begin(), desc.batch.end());
+      shape.elementBytes = getElementBytes(item.second.O);
+      shape.dtype = getDType(item.second.O);
+      result.push_back(shape);
+    }
+  } else if (opt == BinaryOptimizer()) {
+    auto& binary = static_cast<BinaryOptimizer&>(opt);
+    for (auto& item : binary.binaryBuffers) {
+      OpShape shape;
+      shape.symbol = item.first.getSymName().str();
+      setTwoDim(shape, getShape(item.second.C));
+      shape.elementBytes = getElementBytes(item.second.C);
+      shape.dtype = getDType(item.second.C);
+      result.push_back(shape);
+    }
+  } else if (opt == ElementWiseOptimizer()) {
+    auto& elementWise = static_cast<ElementWiseOptimizer&>(opt);
+    for (auto& item : elementWise.elementWiseBuffers) {
+      OpShape shape;
+      shape.symbol = item.first.getSymName().str();
+      setTwoDim(shape, getShape(item.second.input));
+      shape.elementBytes = getElementBytes(item.second.input);
+      shape.dtype = getDType(item.second.input);
+      result.push_back(shape);
+    }
+  } else if (opt == GatherOptimizer()) {
+    auto& gather = static_cast<GatherOptimizer&>(opt);
+    for (auto& item : gather.gatherBuffers) {
+      OpShape shape;
+      shape.symbol = item.first.getSymName().str();
+      setTwoDim(shape, getShape(item.second.output));
+      shape.elementBytes = getElementBytes(item.second.output);
+      shape.dtype = getDType(item.second.output);
+      result.push_back(shape);
+    }
+  } else if (opt == LayerNormOptimizer()) {
+    auto& layerNorm = static_cast<LayerNormOptimizer&>(opt);
+    for (auto& item : layerNorm.layerNormBuffers) {
+      OpShape shape;
+      shape.symbol = item.first.getSymName().str();
+      auto dims = getShape(item.second.input);
+      // LayerNorm_{shape}_axis_{axis}: rows before the axis, the rest is reduced.
+      auto pos = shape.symbol.rfind("_axis_");
+      int axis = pos == std::string::npos ? dims.size() - 1 : std::stoi(shape.symbol.substr(pos + 6));
+      if (axis < 0) axis += dims.size();
+      shape.m = 1; shape.n = 1;
+      for (int i = 0; i < dims.size(); i++) {
+        if (i < axis) shape.m *= dims[i];
+        else shape.n *= dims[i];
+      }
+      shape.elementBytes = getElementBytes(item.second.input);
+      shape.dtype = getDType(item.second.input);
+      result.push_back(shape);
+    }
+  }
+
+  // calls of the same function (e.g. two identical attention blocks) are tuned once.
+  std::vector<OpShape> unique;
+  std::set<std::string> symbols;
+  for (auto& shape : result) {
+    if (symbols.insert(shape.symbol).second) unique.push_back(shape);
+  }
+  return std::move(unique);
+}
+
+}
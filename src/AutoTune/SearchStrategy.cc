@@ -0,0 +1,247 @@
+#include "AutoTune/SearchStrategy.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <set>
+
+namespace KernelCodeGen {
+
+void SearchStrategy::run(const std::vector<TuneConfig>& space_, const Measure& measure,
+                         const TuneBudget& budget, int batchSize, int seeds) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    space = space_;
+    measured.clear();
+    bestIndex = -1;
+    bestLatency = FLT_MAX;
+  }
+  // the same space gives the same proposals.
+  rng.seed(0);
+  reset();
+  batchSize = std::max(1, batchSize);
+  seeds = std::min<int>(std::max(0, seeds), space.size());
+
+  int seeded = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (true) {
+    int remaining = batchSize;
+    if (budget.maxCandidates > 0) remaining = std::min<int>(batchSize, budget.maxCandidates - measured.size());
+    if (remaining <= 0) break;
+    if (budget.maxSeconds > 0) {
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      if (elapsed.count() >= budget.maxSeconds) break;
+    }
+
+    std::vector<int> batch;
+    if (seeded < seeds) {
+      for (; seeded < seeds && batch.size() < remaining; seeded++) batch.push_back(seeded);
+    } else {
+      batch = propose(remaining);
+    }
+    if (batch.empty()) break;
+    std::vector<TuneConfig> configs;
+    for (auto index : batch) configs.push_back(space[index]);
+    auto latencies = measure(configs);
+    assert(latencies.size() == batch.size());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < batch.size(); i++) {
+      measured[batch[i]] = latencies[i];
+      if (latencies[i] < bestLatency) {
+        bestLatency = latencies[i];
+        bestIndex = batch[i];
+      }
+    }
+  }
+}
+
+bool SearchStrategy::getBest(TuneConfig& config, float& latency) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (bestIndex == -1) return false;
+  config = space[bestIndex];
+  latency = bestLatency;
+  return true;
+}
+
+int SearchStrategy::getMeasuredNumber() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return measured.size();
+}
+
+/*-----------------------------exhaustive-----------------------------*/
+std::vector<int> ExhaustiveSearch::propose(int batchSize) {
+  std::vector<int> batch;
+  for (; next < space.size() && batch.size() < batchSize; next++) {
+    if (!measured.count(next)) batch.push_back(next);
+  }
+  return batch;
+}
+
+/*-------------------------------random-------------------------------*/
+void RandomSearch::reset() {
+  order.resize(space.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), rng);
+  next = 0;
+}
+
+std::vector<int> RandomSearch::propose(int batchSize) {
+  std::vector<int> batch;
+  for (; next < order.size() && batch.size() < batchSize; next++) {
+    if (!measured.count(order[next])) batch.push_back(order[next]);
+  }
+  return batch;
+}
+
+/*-------------------------------genetic------------------------------*/
+void GeneticSearch::reset() {
+  indexOf.clear();
+  knobValues.clear();
+  std::map<std::string, std::set<int>> values;
+  for (int i = 0; i < space.size(); i++) {
+    indexOf[space[i]] = i;
+    for (auto& item : space[i]) values[item.first].insert(item.second);
+  }
+  for (auto& item : values) {
+    knobValues[item.first] = std::vector<int>(item.second.begin(), item.second.end());
+  }
+}
+
+int GeneticSearch::randomUnmeasured() {
+  if (measured.size() >= space.size()) return -1;
+  std::uniform_int_distribution<int> dist(0, space.size() - 1);
+  for (int i = 0; i < 32; i++) {
+    auto index = dist(rng);
+    if (!measured.count(index)) return index;
+  }
+  for (int i = 0; i < space.size(); i++) {
+    if (!measured.count(i)) return i;
+  }
+  return -1;
+}
+
+// tournament of 3 among the fittest measured configs.
+int GeneticSearch::select() {
+  std::vector<std::pair<float, int>> elite;
+  for (auto& item : measured) {
+    if (item.second != FLT_MAX) elite.push_back({item.second, item.first});
+  }
+  std::sort(elite.begin(), elite.end());
+  if (elite.size() > population) elite.resize(population);
+  std::uniform_int_distribution<int> dist(0, elite.size() - 1);
+  int best = dist(rng);
+  for (int i = 0; i < 2; i++) best = std::min(best, dist(rng));
+  return elite[best].second;
+}
+
+std::vector<int> GeneticSearch::propose(int batchSize) {
+  std::vector<int> batch;
+  std::set<int> chosen;
+  int valid = 0;
+  for (auto& item : measured) valid += item.second != FLT_MAX;
+
+  std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+  for (int n = 0; n < batchSize; n++) {
+    int child = -1;
+    // the first generation is random.
+    for (int retry = 0; valid >= 2 && valid >= std::min<int>(population, space.size()) / 2 && retry < 8; retry++) {
+      auto& father = space[select()];
+      auto& mother = space[select()];
+      TuneConfig config;
+      // the parents may differ in their optional knobs, a knob the mother lacks comes from the father.
+      for (auto& item : father) {
+        auto iter = mother.find(item.first);
+        config[item.first] = coin(rng) < 0.5f || iter == mother.end() ? item.second : iter->second;
+      }
+      if (coin(rng) < mutation && !knobValues.empty()) {
+        auto knob = knobValues.begin();
+        std::advance(knob, std::uniform_int_distribution<int>(0, knobValues.size() - 1)(rng));
+        auto& values = knob->second;
+        config[knob->first] = values[std::uniform_int_distribution<int>(0, values.size() - 1)(rng)];
+      }
+      auto iter = indexOf.find(config);
+      if (iter != indexOf.end() && !measured.count(iter->second) && !chosen.count(iter->second)) {
+        child = iter->second;
+        break;
+      }
+    }
+    if (child == -1) {
+      for (int retry = 0; retry < 8 && (child == -1 || chosen.count(child)); retry++) child = randomUnmeasured();
+      if (child == -1 || chosen.count(child)) break;
+    }
+    chosen.insert(child);
+    batch.push_back(child);
+  }
+  return batch;
+}
+
+/*------------------------------surrogate-----------------------------*/
+double SurrogateSearch::distance(int x, int y) {
+  double result = 0.0;
+  for (auto& item : space[x]) {
+    auto iter = space[y].find(item.first);
+    if (iter == space[y].end()) continue;
+    auto diff = std::log2(std::max(item.second, 1)) - std::log2(std::max(iter->second, 1));
+    result += diff * diff;
+  }
+  return std::sqrt(result);
+}
+
+std::vector<int> SurrogateSearch::propose(int batchSize) {
+  std::vector<int> unmeasured;
+  for (int i = 0; i < space.size(); i++) {
+    if (!measured.count(i)) unmeasured.push_back(i);
+  }
+  // the regression needs at least one measured config, whatever the warmup.
+  if (measured.size() < std::max(warmup, 1)) {
+    std::shuffle(unmeasured.begin(), unmeasured.end(), rng);
+    if (unmeasured.size() > batchSize) unmeasured.resize(batchSize);
+    return unmeasured;
+  }
+
+  // the configs which can't be applied pull their neighbours down.
+  float worst = 0.0f;
+  for (auto& item : measured) {
+    if (item.second != FLT_MAX) worst = std::max(worst, item.second);
+  }
+  auto target = [&](float latency) {
+    return std::log(std::max(1e-6f, latency == FLT_MAX ? 2.0f * std::max(worst, 1e-3f) : latency));
+  };
+
+  std::vector<std::pair<double, int>> scores;
+  for (auto index : unmeasured) {
+    std::vector<std::pair<double, float>> nearest;
+    for (auto& item : measured) nearest.push_back({distance(index, item.first), item.second});
+    auto k = std::min<int>(neighbours, nearest.size());
+    std::partial_sort(nearest.begin(), nearest.begin() + k, nearest.end(),
+      [](const std::pair<double, float>& x, const std::pair<double, float>& y) { return x.first < y.first; });
+    double weights = 0.0, mean = 0.0;
+    for (int i = 0; i < k; i++) {
+      auto weight = 1.0 / (nearest[i].first + 1e-3);
+      mean += weight * target(nearest[i].second);
+      weights += weight;
+    }
+    mean /= weights;
+    scores.push_back({mean - beta * nearest[0].first, index});
+  }
+  std::sort(scores.begin(), scores.end());
+
+  std::vector<int> batch;
+  for (int i = 0; i < scores.size() && batch.size() < batchSize; i++) batch.push_back(scores[i].second);
+  return batch;
+}
+
+std::unique_ptr<SearchStrategy> createSearchStrategy(SearchMethod method) {
+  switch (method) {
+    case SearchMethod::Exhaustive: return std::make_unique<ExhaustiveSearch>();
+    case SearchMethod::Random: return std::make_unique<RandomSearch>();
+    case SearchMethod::Genetic: return std::make_unique<GeneticSearch>();
+    case SearchMethod::Surrogate: return std::make_unique<SurrogateSearch>();
+  }
+  return nullptr;
+}
+
+}
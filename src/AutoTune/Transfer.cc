@@ -0,0 +1,72 @@
+#include "AutoTune/Transfer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace KernelCodeGen {
+
+double Transfer::intensity(int64_t m, int64_t n, int64_t k, int64_t batch, int64_t elementBytes) {
+  double flops = 2.0 * batch * m * n * k;
+  double bytes = 1.0 * batch * elementBytes * (m * k + k * n + m * n);
+  return flops / bytes;
+}
+
+double Transfer::distance(const TuningRecord& record, const OpShape& shape) {
+  int64_t batch = 1;
+  for (auto b : shape.batch) batch *= b;
+  auto logDiff = [](double x, double y) {
+    auto diff = std::log2(std::max(x, 1.0)) - std::log2(std::max(y, 1.0));
+    return diff * diff;
+  };
+  double result = logDiff(record.m, shape.m) + logDiff(record.n, shape.n) +
+                  logDiff(record.k, shape.k) + logDiff(record.batch, batch);
+  // the intensity decides whether a tile is memory or compute bound, weight it as much as all dims.
+  auto recordIntensity = intensity(record.m, record.n, record.k, record.batch, shape.elementBytes);
+  auto shapeIntensity = intensity(shape.m, shape.n, shape.k, batch, shape.elementBytes);
+  result += 4.0 * logDiff(recordIntensity, shapeIntensity);
+  return std::sqrt(result);
+}
+
+TuneConfig Transfer::adapt(const std::string& optName, const TuneConfig& config, const TuningRecord& record,
+                           const OpShape& shape) {
+  auto result = config;
+  if (optName == "FMHA" && record.k != 0 && result.count("HdxBr")) {
+    // keep Br, the head dim may differ.
+    result["HdxBr"] = static_cast<int>(result["HdxBr"] / record.k * shape.k);
+  }
+  return result;
+}
+
+std::vector<TuneConfig> Transfer::nearestConfigs(const TuningDatabase& database, const TuningKey& key,
+                                                 const std::vector<OpShape>& shapes, const DeviceProfile& device, int topK) {
+  std::vector<TuneConfig> result;
+  if (shapes.empty() || topK <= 0) return result;
+
+  std::vector<std::pair<double, TuningRecord>> neighbours;
+  database.forEachRecord([&](const std::string& str, const TuningRecord& record) {
+    TuningKey other;
+    if (!TuningKey::parse(str, other)) return;
+    if (other.optimizer != key.optimizer || other.dtype != key.dtype || other.device != key.device ||
+        other.version != key.version || other.symbol == key.symbol) return;
+    neighbours.push_back({distance(record, shapes[0]), record});
+  });
+  std::stable_sort(neighbours.begin(), neighbours.end(),
+    [](const std::pair<double, TuningRecord>& x, const std::pair<double, TuningRecord>& y) {
+      return x.first < y.first;
+    });
+
+  for (auto& neighbour : neighbours) {
+    if (result.size() >= topK) break;
+    auto config = adapt(key.optimizer, neighbour.second.config, neighbour.second, shapes[0]);
+    bool legal = true;
+    for (auto& shape : shapes) {
+      legal = legal && SearchSpace::isLegal(key.optimizer, config, shape, device);
+    }
+    if (!legal) continue;
+    if (std::find(result.begin(), result.end(), config) != result.end()) continue;
+    result.push_back(std::move(config));
+  }
+  return result;
+}
+
+}
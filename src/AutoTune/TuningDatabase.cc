@@ -0,0 +1,239 @@
+#include "AutoTune/TuningDatabase.h"
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Process.h"
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <sstream>
+
+namespace KernelCodeGen {
+
+namespace {
+
+const char magic[] = "KCGTDB01";
+const size_t magicSize = 8;
+
+uint32_t floatBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+float bitsFloat(uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+}
+
+std::string TuningKey::str() const {
+  return optimizer + "\t" + symbol + "\t" + dtype + "\t" + device + "\t" + std::to_string(version);
+}
+
+bool TuningKey::parse(const std::string& str, TuningKey& key) {
+  std::vector<std::string> fields;
+  std::stringstream stream(str);
+  std::string field;
+  while (std::getline(stream, field, '\t')) fields.push_back(field);
+  if (fields.size() != 5) return false;
+  key.optimizer = fields[0];
+  key.symbol = fields[1];
+  key.dtype = fields[2];
+  key.device = fields[3];
+  return !llvm::StringRef(fields[4]).getAsInteger(10, key.version);
+}
+
+TuningKey TuningDatabase::makeKey(const std::string& optName, const std::vector<OpShape>& shapes,
+                                  const DeviceProfile& device, uint64_t evaluatorDigest) {
+  TuningKey key;
+  key.optimizer = optName;
+  auto digest = static_cast<uint64_t>(llvm::hash_combine(device.toJson(), evaluatorDigest));
+  key.device = device.name + "#" + llvm::utohexstr(digest);
+  // tuneFunction keys every function on its own, the symbols of several shapes are joined in a stable order.
+  std::vector<std::string> symbols;
+  for (auto& shape : shapes) symbols.push_back(shape.symbol);
+  std::sort(symbols.begin(), symbols.end());
+  for (int i = 0; i < symbols.size(); i++) {
+    if (i != 0) key.symbol += ",";
+    key.symbol += symbols[i];
+  }
+  key.dtype = shapes.empty() ? "" : shapes[0].dtype;
+  return key;
+}
+
+std::string TuningDatabase::serialize(const TuneConfig& config) {
+  std::string result;
+  for (auto& item : config) {
+    result += item.first + "=" + std::to_string(item.second) + ";";
+  }
+  return result;
+}
+
+bool TuningDatabase::deserialize(llvm::StringRef str, TuneConfig& config) {
+  config.clear();
+  while (!str.empty()) {
+    llvm::StringRef item;
+    std::tie(item, str) = str.split(';');
+    if (item.empty()) continue;
+    auto pair = item.split('=');
+    int value;
+    if (pair.first.empty() || pair.second.getAsInteger(10, value)) return false;
+    config[pair.first.str()] = value;
+  }
+  return true;
+}
+
+TuningDatabase::TuningDatabase() = default;
+TuningDatabase::~TuningDatabase() = default;
+
+bool TuningDatabase::decode(const char* data, const char* end, TuningRecord& record) {
+  using namespace llvm::support;
+  if (end - data < 4) return false;
+  auto configLen = endian::read32le(data); data += 4;
+  if (end - data < configLen + 4 + 4 * 8) return false;
+  if (!deserialize(llvm::StringRef(data, configLen), record.config)) return false;
+  data += configLen;
+  record.latency = bitsFloat(endian::read32le(data)); data += 4;
+  record.m = endian::read64le(data); data += 8;
+  record.n = endian::read64le(data); data += 8;
+  record.k = endian::read64le(data); data += 8;
+  record.batch = endian::read64le(data);
+  return true;
+}
+
+bool TuningDatabase::open(const std::string& path_) {
+  path = path_;
+  mapped.reset();
+  index.clear();
+  appended.clear();
+  validSize = -1;
+  if (!llvm::sys::fs::exists(path)) return true;
+
+  // large files are mmaped by MemoryBuffer, a null terminator would force a copy.
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+  if (!buffer) {
+    llvm::errs() << "Can't open tuning database \"" << path << "\"\n";
+    return false;
+  }
+  auto start = (*buffer)->getBufferStart();
+  auto data = start;
+  auto end = (*buffer)->getBufferEnd();
+  // an empty file or a magic cut short by a crash is an empty database, the first record rewrites the magic.
+  if (end - data < magicSize && std::memcmp(data, magic, end - data) == 0) {
+    if (data != end) validSize = 0;
+    return true;
+  }
+  if (std::memcmp(data, magic, magicSize) != 0) {
+    llvm::errs() << "\"" << path << "\" is not a tuning database\n";
+    return false;
+  }
+  data += magicSize;
+
+  using namespace llvm::support;
+  int skipped = 0;
+  // the end of the last whole record.
+  auto last = data;
+  while (data < end) {
+    if (end - data < 4) break;
+    auto keyLen = endian::read32le(data); data += 4;
+    if (end - data < keyLen + 4) break;
+    llvm::StringRef key(data, keyLen); data += keyLen;
+    auto record = data;
+    auto configLen = endian::read32le(data); data += 4;
+    if (end - data < configLen + 4 + 4 * 8) break;
+    data += configLen + 4 + 4 * 8;
+    last = data;
+    // a corrupt record is dropped, an earlier record of its key stays.
+    TuningRecord decoded;
+    if (!decode(record, end, decoded)) {
+      skipped++;
+      continue;
+    }
+    index[key] = record;
+  }
+  if (last != end) {
+    // records appended after the partial one would be read out of alignment, record() cuts it off first.
+    llvm::errs() << "Truncated record in tuning database \"" << path << "\", it is dropped by the next record\n";
+    validSize = last - start;
+  }
+  if (skipped) {
+    llvm::errs() << "Skipped " << skipped << " corrupt records in tuning database \"" << path << "\"\n";
+  }
+  mapped = std::move(*buffer);
+  return true;
+}
+
+bool TuningDatabase::lookup(const TuningKey& key, TuningRecord& record) const {
+  auto keyStr = key.str();
+  auto iter = appended.find(keyStr);
+  if (iter != appended.end()) {
+    record = iter->second;
+    return true;
+  }
+  auto found = index.find(keyStr);
+  return found != index.end() && decode(found->second, mapped->getBufferEnd(), record);
+}
+
+void TuningDatabase::forEachRecord(
+    const std::function<void(const std::string& key, const TuningRecord& record)>& fn) const {
+  for (auto& item : index) {
+    auto key = item.first.str();
+    TuningRecord record;
+    if (appended.count(key) || !decode(item.second, mapped->getBufferEnd(), record)) continue;
+    fn(key, record);
+  }
+  for (auto& item : appended) fn(item.first, item.second);
+}
+
+void TuningDatabase::record(const TuningKey& key, const TuningRecord& record) {
+  auto keyStr = key.str();
+  appended[keyStr] = record;
+  if (path.empty()) return;
+
+  if (validSize >= 0) {
+    int fd;
+    auto ec = llvm::sys::fs::openFileForReadWrite(path, fd, llvm::sys::fs::CD_OpenExisting, llvm::sys::fs::OF_None);
+    if (!ec) {
+      ec = llvm::sys::fs::resize_file(fd, validSize);
+      llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+    }
+    if (ec) {
+      llvm::errs() << "Can't cut the truncated record off tuning database \"" << path << "\": " << ec.message()
+                   << ", the record isn't saved\n";
+      return;
+    }
+    validSize = -1;
+  }
+
+  uint64_t size = 0;
+  bool fresh = llvm::sys::fs::file_size(path, size) || size == 0;
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_Append);
+  if (ec) {
+    llvm::errs() << "Can't open tuning database \"" << path << "\": " << ec.message() << "\n";
+    return;
+  }
+  if (fresh) os.write(magic, magicSize);
+
+  using namespace llvm::support;
+  auto configStr = serialize(record.config);
+  endian::write<uint32_t>(os, keyStr.size(), little);
+  os << keyStr;
+  endian::write<uint32_t>(os, configStr.size(), little);
+  os << configStr;
+  endian::write<uint32_t>(os, floatBits(record.latency), little);
+  endian::write<int64_t>(os, record.m, little);
+  endian::write<int64_t>(os, record.n, little);
+  endian::write<int64_t>(os, record.k, little);
+  endian::write<int64_t>(os, record.batch, little);
+}
+
+}
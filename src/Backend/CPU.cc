@@ -0,0 +1,780 @@
+#include "Backend/CPU.h"
+#include "Optimizer/Analyzer.h"
+#include "enum.h"
+#include "log.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace KernelCodeGen {
+
+namespace {
+
+const char* prologue = R"(#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__FLT16_MAX__)
+typedef _Float16 half_t;
+#endif
+
+template <typename T, int N> struct kcg_vec { T data[N]; };
+
+template <typename T, int N> inline kcg_vec<T, N> kcg_load(const T* ptr) {
+  kcg_vec<T, N> result;
+  std::memcpy(&result, ptr, sizeof(result));
+  return result;
+}
+
+template <typename T, int N> inline void kcg_store(T* ptr, const kcg_vec<T, N>& value) {
+  std::memcpy(ptr, &value, sizeof(value));
+}
+
+template <typename To, typename From> inline To kcg_bitcast(const From& value) {
+  To result;
+  std::memcpy(&result, &value, sizeof(result));
+  return result;
+}
+
+// the thread a lane of __shfl_down_sync / __shfl_sync reads, the lanes of a warp are consecutive threads.
+inline int64_t kcg_shfl_down(int64_t tid, int64_t offset, int64_t width) {
+  return tid % width + offset < width ? tid + offset : tid;
+}
+
+inline int64_t kcg_shfl_idx(int64_t tid, int64_t lane, int64_t width) {
+  return tid - tid % width + lane % width;
+}
+
+)";
+
+const char* runtimePrologue = R"(extern "C" void kcg_parallel_for(int64_t begin, int64_t end, int64_t grain,
+                                 void (*fn)(int64_t begin, int64_t end, void* context), void* context);
+
+// the blocks of a grid as chunks of the work stealing runtime, see Backend/CPURuntime.h of KernelCodeGen.
+template <typename F> inline void kcg_parallel_blocks(int64_t blocks, int64_t grain, F body) {
+  kcg_parallel_for(0, blocks, grain, [](int64_t begin, int64_t end, void* context) {
+    auto& body = *static_cast<F*>(context);
+    for (int64_t block = begin; block < end; block++) body(block);
+  }, &body);
+}
+
+)";
+
+std::string getCType(mlir::Type type) {
+  if (type.isF16()) return "half_t";
+  if (type.isF32()) return "float";
+  if (type.isF64()) return "double";
+  if (auto intType = type.dyn_cast<mlir::IntegerType>()) {
+    if (intType.getWidth() == 1) return "bool";
+    return "int" + std::to_string(intType.getWidth()) + "_t";
+  }
+  // the indices of big tensors overflow an int on the host.
+  if (type.isa<mlir::IndexType>()) return "int64_t";
+  if (auto vectorType = type.dyn_cast<mlir::VectorType>()) {
+    return "kcg_vec<" + getCType(vectorType.getElementType()) + ", " + std::to_string(vectorType.getNumElements()) + ">";
+  }
+  llvm::errs() << "Unsupported type on CPU: " << type << "\n";
+  return "void";
+}
+
+// the shared and the local buffers are arrays, the others are flat pointers like in CUDAGen.
+bool isTile(mlir::MemRefType type) {
+  auto memorySpace = type.getMemorySpaceAsInt();
+  return memorySpace == static_cast<int>(MemorySpace::shared) || memorySpace == static_cast<int>(MemorySpace::local);
+}
+
+std::string declare(mlir::Value value, const std::string& name) {
+  auto type = value.getType().dyn_cast<mlir::MemRefType>();
+  if (!type) return getCType(value.getType()) + " " + name;
+  auto element = getCType(type.getElementType());
+  if (!isTile(type)) return element + "* " + name;
+  auto result = element + " " + name;
+  for (auto dim : type.getShape()) result += "[" + std::to_string(dim) + "]";
+  return result;
+}
+
+std::string getLiteral(mlir::arith::ConstantFloatOp floatOp) {
+  auto value = floatOp.value();
+  bool losesInfo = false;
+  value.convert(llvm::APFloat::IEEEdouble(), llvm::APFloat::rmNearestTiesToEven, &losesInfo);
+  auto number = value.convertToDouble();
+  if (std::isinf(number)) return number < 0 ? "-INFINITY" : "INFINITY";
+  if (std::isnan(number)) return "NAN";
+  bool isDouble = floatOp.getType().isF64();
+  std::ostringstream os;
+  os << std::setprecision(isDouble ? 17 : 9) << number;
+  auto result = os.str();
+  if (result.find_first_of(".e") == std::string::npos) result += ".0";
+  return isDouble ? result : result + "f";
+}
+
+std::string getRelation(mlir::arith::CmpFPredicate predicate) {
+  switch (predicate) {
+    case mlir::arith::CmpFPredicate::OEQ: case mlir::arith::CmpFPredicate::UEQ: return " == ";
+    case mlir::arith::CmpFPredicate::ONE: case mlir::arith::CmpFPredicate::UNE: return " != ";
+    case mlir::arith::CmpFPredicate::OGT: case mlir::arith::CmpFPredicate::UGT: return " > ";
+    case mlir::arith::CmpFPredicate::OGE: case mlir::arith::CmpFPredicate::UGE: return " >= ";
+    case mlir::arith::CmpFPredicate::OLT: case mlir::arith::CmpFPredicate::ULT: return " < ";
+    case mlir::arith::CmpFPredicate::OLE: case mlir::arith::CmpFPredicate::ULE: return " <= ";
+    default: llvm::errs() << "Unsupported cmpf predicate on CPU\n";
+  }
+  return " == ";
+}
+
+// gpu.shuffle reads the value of another thread, so like gpu.barrier it needs every thread to be done before.
+bool hasSync(mlir::Operation* op) {
+  auto result = op->walk([](mlir::Operation* inner) {
+    if (mlir::isa<mlir::gpu::BarrierOp, mlir::gpu::ShuffleOp>(inner)) return mlir::WalkResult::interrupt();
+    return mlir::WalkResult::advance();
+  });
+  return result.wasInterrupted();
+}
+
+// RAII helper to manage increasing/decreasing the indentation.
+struct Indent {
+  Indent(int &level) : level(level) { ++level; }
+  ~Indent() { --level; }
+  int &level;
+};
+
+/// @brief a stretch of the block level between two barriers.
+/// A run (no op) is a sequence of barrier free ops, one loop nest over the threads runs it. An affine.for or
+/// an affine.if which contains a barrier is executed by the block as a whole, its body is split again.
+struct Phase {
+  mlir::Operation* op = nullptr;
+  std::vector<mlir::Operation*> ops;
+  std::vector<Phase> body;
+  std::vector<Phase> elseBody;
+};
+
+class CPUGenerator {
+public:
+  CPUGenerator(CPUParallel parallel_, int64_t grain_) : parallel(parallel_), grain(grain_) {}
+  std::string codegen(mlir::ModuleOp module);
+
+private:
+  void codegen(mlir::AffineParallelOp gridLevel);
+  void codegenThreads(mlir::AffineParallelOp blockLevel);
+  void codegen(const std::vector<Phase>& phases);
+  void codegenRun(const std::vector<mlir::Operation*>& ops);
+  void codegen(mlir::Block& block);
+  void codegen(mlir::Operation* op);
+  void codegenHeader(mlir::AffineForOp forOp);
+  void codegen(mlir::AffineIfOp ifOp);
+  void codegen(mlir::gpu::ShuffleOp shflOp);
+
+  std::vector<Phase> split(mlir::Block& block);
+  static void number(const std::vector<Phase>& phases, int& runs, llvm::DenseMap<mlir::Operation*, int>& runOf);
+  static std::vector<mlir::Value> collectArgs(mlir::AffineParallelOp gridLevel, std::vector<mlir::Operation*>& constants);
+
+  std::string codegen(mlir::AffineExpr expr, mlir::ValueRange operands, unsigned numDims);
+  std::string codegenBound(mlir::AffineMap map, mlir::ValueRange operands, bool lower);
+  std::string codegenAccess(mlir::Value memref, const std::vector<std::string>& indices);
+  std::string codegenAccess(mlir::Value memref, mlir::AffineMap map, mlir::ValueRange operands);
+  std::string codegenCondition(mlir::AffineIfOp ifOp);
+
+  void assign(mlir::Value result, const std::string& expression, const std::string& prefix = "temp");
+  std::string getName(mlir::Value value);
+  std::string newName(const std::string& prefix) {
+    return prefix + std::to_string(nameCounter++);
+  }
+  void indent() {
+    for (int i = 0; i < curIndent; i++) source << "  ";
+  }
+
+  CPUParallel parallel;
+  int64_t grain;
+  std::stringstream source;
+  int curIndent = 0;
+  int64_t kernelCounter = 0;
+  int64_t nameCounter = 0;
+  llvm::DenseMap<mlir::Value, std::string> names;
+  // the values and the local buffers used on both sides of a barrier, they have a copy per thread.
+  llvm::DenseMap<mlir::Value, std::string> copies;
+  // the constants and the shared buffers of the block level, declared once per block before the thread loops.
+  llvm::DenseSet<mlir::Operation*> hoisted;
+  bool declaring = false;
+  std::vector<mlir::Value> threadIVs;
+  std::vector<int64_t> threadDims;
+};
+
+std::string CPUGenerator::getName(mlir::Value value) {
+  auto iter = names.find(value);
+  if (iter == names.end()) {
+    llvm::errs() << "value not exists\n";
+    return "false";
+  }
+  return iter->second;
+}
+
+void CPUGenerator::assign(mlir::Value result, const std::string& expression, const std::string& prefix) {
+  indent();
+  if (copies.count(result)) {
+    source << getName(result) << " = " << expression << ";\n";
+    return;
+  }
+  auto name = newName(prefix);
+  names[result] = name;
+  source << getCType(result.getType()) << " " << name << " = " << expression << ";\n";
+}
+
+std::string CPUGenerator::codegen(mlir::AffineExpr expr, mlir::ValueRange operands, unsigned numDims) {
+  if (auto dimExpr = expr.dyn_cast<mlir::AffineDimExpr>()) {
+    return getName(operands[dimExpr.getPosition()]);
+  }
+  if (auto symbolExpr = expr.dyn_cast<mlir::AffineSymbolExpr>()) {
+    return getName(operands[numDims + symbolExpr.getPosition()]);
+  }
+  if (auto constExpr = expr.dyn_cast<mlir::AffineConstantExpr>()) {
+    return std::to_string(constExpr.getValue());
+  }
+  auto binaryExpr = expr.dyn_cast<mlir::AffineBinaryOpExpr>();
+  assert(binaryExpr);
+  auto lhs = codegen(binaryExpr.getLHS(), operands, numDims);
+  auto rhs = codegen(binaryExpr.getRHS(), operands, numDims);
+  switch (binaryExpr.getKind()) {
+    case mlir::AffineExprKind::Add: return "(" + lhs + " + " + rhs + ")";
+    case mlir::AffineExprKind::CeilDiv: return "((" + lhs + " + " + rhs + " - 1)" + " / " + rhs + ")";
+    case mlir::AffineExprKind::FloorDiv: return "(" + lhs + " / " + rhs + ")";
+    case mlir::AffineExprKind::Mod: return "(" + lhs + " % " + rhs + ")";
+    case mlir::AffineExprKind::Mul: return "(" + lhs + " * " + rhs + ")";
+    default: assert(false);
+  }
+  return "0";
+}
+
+std::string CPUGenerator::codegenBound(mlir::AffineMap map, mlir::ValueRange operands, bool lower) {
+  // a lower bound is the max of its results, an upper bound the min.
+  std::string result;
+  for (auto expr : map.getResults()) {
+    auto bound = codegen(expr, operands, map.getNumDims());
+    if (result.empty()) result = bound;
+    else result = std::string(lower ? "std::max" : "std::min") + "<int64_t>(" + result + ", " + bound + ")";
+  }
+  return result;
+}
+
+std::string CPUGenerator::codegenAccess(mlir::Value memref, const std::vector<std::string>& indices) {
+  auto type = memref.getType().dyn_cast<mlir::MemRefType>();
+  auto result = getName(memref);
+  if (isTile(type)) {
+    for (auto& index : indices) result += "[" + index + "]";
+    return result;
+  }
+  auto shape = type.getShape();
+  std::string offset;
+  int64_t stride = 1;
+  for (int i = indices.size() - 1; i >= 0; i--) {
+    auto term = stride == 1 ? indices[i] : indices[i] + " * " + std::to_string(stride);
+    offset = offset.empty() ? term : term + " + " + offset;
+    stride *= shape[i];
+  }
+  return result + "[" + (offset.empty() ? std::string("0") : offset) + "]";
+}
+
+std::string CPUGenerator::codegenAccess(mlir::Value memref, mlir::AffineMap map, mlir::ValueRange operands) {
+  std::vector<std::string> indices;
+  for (auto expr : map.getResults()) indices.push_back(codegen(expr, operands, map.getNumDims()));
+  return codegenAccess(memref, indices);
+}
+
+void CPUGenerator::codegenHeader(mlir::AffineForOp forOp) {
+  auto iter = newName("i");
+  names[forOp.getInductionVar()] = iter;
+  auto attr = forOp->getAttrOfType<mlir::StringAttr>(std::string("affine.loop"));
+  if (attr && attr.getValue() == "unroll") {
+    indent();
+    source << "#pragma GCC unroll " << std::max<int64_t>(1, std::min<int64_t>(Analyzer::getTripCount(forOp), 64)) << "\n";
+  }
+  indent();
+  source << "for (int64_t " << iter << " = "
+         << codegenBound(forOp.getLowerBoundMap(), forOp.getLowerBoundOperands(), true) << "; "
+         << iter << " < " << codegenBound(forOp.getUpperBoundMap(), forOp.getUpperBoundOperands(), false) << "; "
+         << iter << " += " << forOp.getStep() << ") {\n";
+}
+
+std::string CPUGenerator::codegenCondition(mlir::AffineIfOp ifOp) {
+  auto iset = ifOp.getIntegerSet();
+  std::string result;
+  for (int i = 0; i < iset.getNumConstraints(); i += 1) {
+    result += codegen(iset.getConstraint(i), ifOp.getOperands(), iset.getNumDims());
+    result += iset.isEq(i) ? " == 0 && " : " >= 0 && ";
+  }
+  return result + "true";
+}
+
+void CPUGenerator::codegen(mlir::AffineIfOp ifOp) {
+  indent();
+  source << "if (" << codegenCondition(ifOp) << ") {\n";
+  {
+    Indent level(curIndent);
+    codegen(*ifOp.getThenBlock());
+  }
+  if (ifOp.hasElse()) {
+    indent();
+    source << "} else {\n";
+    Indent level(curIndent);
+    codegen(*ifOp.getElseBlock());
+  }
+  indent();
+  source << "}\n";
+}
+
+void CPUGenerator::codegen(mlir::gpu::ShuffleOp shflOp) {
+  auto value = shflOp.value();
+  // a value which isn't carried is the same for every thread.
+  if (!copies.count(value)) {
+    assign(shflOp.getResult(0), getName(value));
+    return;
+  }
+  std::string lane;
+  switch (shflOp.mode()) {
+    case mlir::gpu::ShuffleMode::DOWN: lane = "kcg_shfl_down("; break;
+    case mlir::gpu::ShuffleMode::IDX: lane = "kcg_shfl_idx("; break;
+    default: llvm::errs() << "Unsupport shfl mode\n";
+  }
+  lane += "tid, " + getName(shflOp.offset()) + ", " + getName(shflOp.width()) + ")";
+  assign(shflOp.getResult(0), copies[value] + "[" + lane + "]");
+}
+
+void CPUGenerator::codegen(mlir::Block& block) {
+  for (auto& op : block.without_terminator()) codegen(&op);
+}
+
+void CPUGenerator::codegen(mlir::Operation* op) {
+  if (hoisted.count(op) && !declaring) return;
+  llvm::TypeSwitch<mlir::Operation*>(op)
+    .Case<mlir::arith::ConstantIndexOp>([&](auto constOp) {
+      auto name = newName("const");
+      names[constOp.getResult()] = name;
+      indent();
+      source << "constexpr int64_t " << name << " = " << constOp.value() << ";\n";
+    })
+    .Case<mlir::arith::ConstantFloatOp>([&](auto floatOp) {
+      auto name = newName("const");
+      names[floatOp.getResult()] = name;
+      indent();
+      source << "constexpr " << getCType(floatOp.getType()) << " " << name << " = " << getLiteral(floatOp) << ";\n";
+    })
+    .Case<mlir::arith::ConstantIntOp>([&](auto intOp) {
+      auto name = newName("const");
+      names[intOp.getResult()] = name;
+      indent();
+      source << "constexpr " << getCType(intOp.getType()) << " " << name << " = ";
+      if (intOp.getType().isInteger(1)) source << (intOp.value() ? "true" : "false") << ";\n";
+      else source << intOp.value() << ";\n";
+    })
+    .Case<mlir::arith::AddFOp>([&](auto addOp) {
+      assign(addOp.getResult(), getName(addOp.getLhs()) + " + " + getName(addOp.getRhs()));
+    })
+    .Case<mlir::arith::SubFOp>([&](auto subOp) {
+      assign(subOp.getResult(), getName(subOp.getLhs()) + " - " + getName(subOp.getRhs()));
+    })
+    .Case<mlir::arith::MulFOp>([&](auto mulOp) {
+      assign(mulOp.getResult(), getName(mulOp.getLhs()) + " * " + getName(mulOp.getRhs()));
+    })
+    .Case<mlir::arith::DivFOp>([&](auto divOp) {
+      assign(divOp.getResult(), getName(divOp.getLhs()) + " / " + getName(divOp.getRhs()));
+    })
+    .Case<mlir::arith::MaxFOp>([&](auto maxOp) {
+      assign(maxOp.getResult(), "std::max(" + getName(maxOp.getLhs()) + ", " + getName(maxOp.getRhs()) + ")");
+    })
+    .Case<mlir::arith::CmpFOp>([&](auto cmpOp) {
+      assign(cmpOp.getResult(), getName(cmpOp.getLhs()) + getRelation(cmpOp.getPredicate()) + getName(cmpOp.getRhs()));
+    })
+    .Case<mlir::arith::BitcastOp>([&](auto castOp) {
+      auto result = castOp.getResult();
+      assign(result, "kcg_bitcast<" + getCType(result.getType()) + ">(" + getName(castOp.getOperand()) + ")");
+    })
+    .Case<mlir::math::PowFOp>([&](auto powOp) {
+      assign(powOp.getResult(), "std::pow(" + getName(powOp.getLhs()) + ", " + getName(powOp.getRhs()) + ")");
+    })
+    .Case<mlir::math::ExpOp>([&](auto expOp) {
+      assign(expOp.getResult(), "std::exp(" + getName(expOp.getOperand()) + ")");
+    })
+    .Case<mlir::math::TanhOp>([&](auto tanhOp) {
+      assign(tanhOp.getResult(), "std::tanh(" + getName(tanhOp.getOperand()) + ")");
+    })
+    .Case<mlir::math::SqrtOp>([&](auto sqrtOp) {
+      assign(sqrtOp.getResult(), "std::sqrt(" + getName(sqrtOp.getOperand()) + ")");
+    })
+    .Case<mlir::math::LogOp>([&](auto logOp) {
+      assign(logOp.getResult(), "std::log(" + getName(logOp.getOperand()) + ")");
+    })
+    .Case<mlir::memref::AllocOp>([&](auto allocOp) {
+      auto result = allocOp.getResult();
+      // a carried buffer is declared with its copies.
+      if (copies.count(result)) return;
+      auto type = result.getType().template dyn_cast<mlir::MemRefType>();
+      if (!isTile(type)) {
+        llvm::errs() << "Unsupported global alloc in a CPU kernel\n";
+        return;
+      }
+      auto name = newName("buf");
+      names[result] = name;
+      indent();
+      bool shared = type.getMemorySpaceAsInt() == static_cast<int>(MemorySpace::shared);
+      source << (shared ? "alignas(64) " : "") << declare(result, name) << ";\n";
+    })
+    .Case<mlir::memref::DeallocOp>([&](auto) {})
+    .Case<mlir::AffineApplyOp>([&](auto applyOp) {
+      auto map = applyOp.getAffineMap();
+      assert(map.getNumResults() == 1);
+      assign(applyOp.getResult(), codegen(map.getResult(0), applyOp.getMapOperands(), map.getNumDims()), "idx");
+    })
+    .Case<mlir::AffineLoadOp>([&](auto loadOp) {
+      auto access = codegenAccess(loadOp.getMemref(), loadOp.getAffineMap(), loadOp.getMapOperands());
+      assign(loadOp.getResult(), access, "R");
+    })
+    .Case<mlir::AffineStoreOp>([&](auto storeOp) {
+      indent();
+      source << codegenAccess(storeOp.getMemref(), storeOp.getAffineMap(), storeOp.getMapOperands())
+             << " = " << getName(storeOp.getValue()) << ";\n";
+    })
+    .Case<mlir::AffineVectorLoadOp>([&](auto loadOp) {
+      auto vectorType = loadOp.getVectorType();
+      auto access = codegenAccess(loadOp.getMemref(), loadOp.getAffineMap(), loadOp.getMapOperands());
+      assign(loadOp.getResult(), "kcg_load<" + getCType(vectorType.getElementType()) + ", " +
+             std::to_string(vectorType.getNumElements()) + ">(&" + access + ")", "vec");
+    })
+    .Case<mlir::AffineVectorStoreOp>([&](auto storeOp) {
+      indent();
+      source << "kcg_store(&" << codegenAccess(storeOp.getMemref(), storeOp.getAffineMap(), storeOp.getMapOperands())
+             << ", " << getName(storeOp.getValue()) << ");\n";
+    })
+    .Case<mlir::memref::LoadOp>([&](auto loadOp) {
+      std::vector<std::string> indices;
+      for (auto index : loadOp.getIndices()) indices.push_back(getName(index));
+      assign(loadOp.getResult(), codegenAccess(loadOp.getMemRef(), indices), "R");
+    })
+    .Case<mlir::memref::StoreOp>([&](auto storeOp) {
+      std::vector<std::string> indices;
+      for (auto index : storeOp.getIndices()) indices.push_back(getName(index));
+      indent();
+      source << codegenAccess(storeOp.getMemRef(), indices) << " = " << getName(storeOp.getValueToStore()) << ";\n";
+    })
+    .Case<mlir::AffineForOp>([&](auto forOp) {
+      codegenHeader(forOp);
+      {
+        Indent level(curIndent);
+        codegen(*forOp.getBody());
+      }
+      indent();
+      source << "}\n";
+    })
+    .Case<mlir::AffineIfOp>([&](auto ifOp) {
+      codegen(ifOp);
+    })
+    .Case<mlir::AffineParallelOp>([&](auto parallelOp) {
+      codegenThreads(parallelOp);
+    })
+    .Case<mlir::gpu::ShuffleOp>([&](auto shflOp) {
+      codegen(shflOp);
+    })
+    // the barriers are the boundaries of the thread loops.
+    .Case<mlir::gpu::BarrierOp, mlir::AffineYieldOp>([&](auto) {})
+    .Default([&](mlir::Operation* other) {
+      llvm::errs() << "Unsupported op on CPU: " << other->getName() << "\n";
+    });
+}
+
+std::vector<Phase> CPUGenerator::split(mlir::Block& block) {
+  std::vector<Phase> phases;
+  Phase run;
+  auto flush = [&]() {
+    if (run.ops.empty()) return;
+    phases.push_back(std::move(run));
+    run = Phase();
+  };
+  for (auto& op : block.without_terminator()) {
+    if (hoisted.count(&op)) continue;
+    if (mlir::isa<mlir::gpu::BarrierOp>(&op)) {
+      flush();
+    } else if (mlir::isa<mlir::gpu::ShuffleOp>(&op)) {
+      // the shuffled value must be written by every thread first.
+      flush();
+      run.ops.push_back(&op);
+    } else if (!hasSync(&op)) {
+      run.ops.push_back(&op);
+    } else {
+      flush();
+      Phase phase;
+      phase.op = &op;
+      if (auto forOp = mlir::dyn_cast<mlir::AffineForOp>(&op)) {
+        phase.body = split(*forOp.getBody());
+      } else if (auto ifOp = mlir::dyn_cast<mlir::AffineIfOp>(&op)) {
+        phase.body = split(*ifOp.getThenBlock());
+        if (ifOp.hasElse()) phase.elseBody = split(*ifOp.getElseBlock());
+      } else {
+        llvm::errs() << "Unsupported barrier inside " << op.getName() << " on CPU\n";
+      }
+      phases.push_back(std::move(phase));
+    }
+  }
+  flush();
+  return phases;
+}
+
+void CPUGenerator::number(const std::vector<Phase>& phases, int& runs, llvm::DenseMap<mlir::Operation*, int>& runOf) {
+  for (auto& phase : phases) {
+    if (!phase.op) {
+      for (auto op : phase.ops) runOf[op] = runs;
+      runs++;
+      continue;
+    }
+    number(phase.body, runs, runOf);
+    number(phase.elseBody, runs, runOf);
+  }
+}
+
+void CPUGenerator::codegenRun(const std::vector<mlir::Operation*>& ops) {
+  // the straight line runs are lanes of a SIMD loop, the ones with loops are better left to the compiler.
+  bool simd = true;
+  for (auto op : ops) {
+    op->walk([&](mlir::Operation* inner) {
+      if (mlir::isa<mlir::AffineForOp, mlir::AffineIfOp>(inner)) simd = false;
+    });
+  }
+  std::string tid;
+  for (int i = 0; i < threadIVs.size(); i++) {
+    auto iter = getName(threadIVs[i]);
+    if (simd && i + 1 == threadIVs.size()) {
+      indent();
+      source << "#pragma omp simd\n";
+    }
+    indent();
+    source << "for (int64_t " << iter << " = 0; " << iter << " < " << threadDims[i] << "; " << iter << "++) {\n";
+    curIndent++;
+    tid = tid.empty() ? iter : "(" + tid + " * " + std::to_string(threadDims[i]) + " + " + iter + ")";
+  }
+  if (!copies.empty()) {
+    indent();
+    source << "const int64_t tid = " << (tid.empty() ? std::string("0") : tid) << ";\n";
+  }
+  for (auto op : ops) codegen(op);
+  for (int i = 0; i < threadIVs.size(); i++) {
+    curIndent--;
+    indent();
+    source << "}\n";
+  }
+}
+
+void CPUGenerator::codegen(const std::vector<Phase>& phases) {
+  for (auto& phase : phases) {
+    if (!phase.op) {
+      codegenRun(phase.ops);
+    } else if (auto forOp = mlir::dyn_cast<mlir::AffineForOp>(phase.op)) {
+      codegenHeader(forOp);
+      {
+        Indent level(curIndent);
+        codegen(phase.body);
+      }
+      indent();
+      source << "}\n";
+    } else if (auto ifOp = mlir::dyn_cast<mlir::AffineIfOp>(phase.op)) {
+      // the block takes the branch as a whole, like the threads of a CUDA block must around a barrier.
+      for (auto operand : ifOp.getOperands()) {
+        if (copies.count(operand) || std::count(threadIVs.begin(), threadIVs.end(), operand)) {
+          llvm::errs() << "A barrier under a thread dependent affine.if can't run on CPU\n";
+        }
+      }
+      indent();
+      source << "if (" << codegenCondition(ifOp) << ") {\n";
+      {
+        Indent level(curIndent);
+        codegen(phase.body);
+      }
+      if (!phase.elseBody.empty()) {
+        indent();
+        source << "} else {\n";
+        Indent level(curIndent);
+        codegen(phase.elseBody);
+      }
+      indent();
+      source << "}\n";
+    }
+  }
+}
+
+void CPUGenerator::codegenThreads(mlir::AffineParallelOp blockLevel) {
+  int64_t threads = 0;
+  threadDims = Analyzer::getParallelNumber(blockLevel, threads);
+  threadIVs.clear();
+  auto ivs = blockLevel.getIVs();
+  for (int i = 0; i < ivs.size(); i++) {
+    names[ivs[i]] = "t" + std::to_string(i);
+    threadIVs.push_back(ivs[i]);
+  }
+
+  std::vector<mlir::Operation*> uniform;
+  blockLevel.walk<mlir::WalkOrder::PreOrder>([&](mlir::Operation* op) {
+    auto allocOp = mlir::dyn_cast<mlir::memref::AllocOp>(op);
+    bool shared = allocOp && allocOp.getType().getMemorySpaceAsInt() == static_cast<int>(MemorySpace::shared);
+    if (!mlir::isa<mlir::arith::ConstantOp>(op) && !shared) return;
+    hoisted.insert(op);
+    uniform.push_back(op);
+  });
+  declaring = true;
+  for (auto op : uniform) codegen(op);
+  declaring = false;
+
+  auto phases = split(*blockLevel.getBody());
+  int runs = 0;
+  llvm::DenseMap<mlir::Operation*, int> runOf;
+  number(phases, runs, runOf);
+  auto getRun = [&](mlir::Operation* op) {
+    for (; op && op != blockLevel.getOperation(); op = op->getParentOp()) {
+      auto iter = runOf.find(op);
+      if (iter != runOf.end()) return iter->second;
+    }
+    return -1;
+  };
+
+  // a value used by another run than its own outlives the thread loop which defines it.
+  std::vector<mlir::Value> carried;
+  blockLevel.walk<mlir::WalkOrder::PreOrder>([&](mlir::Operation* op) {
+    auto run = getRun(op);
+    if (run < 0 || hoisted.count(op)) return;
+    for (auto result : op->getResults()) {
+      for (auto user : result.getUsers()) {
+        if (getRun(user) == run) continue;
+        carried.push_back(result);
+        break;
+      }
+    }
+  });
+  if (runs > 1) {
+    indent();
+    source << "// " << runs << " thread loops split at the barriers\n";
+  }
+  for (auto value : carried) {
+    auto name = newName("carried");
+    indent();
+    source << declare(value, name + "[" + std::to_string(threads) + "]") << ";\n";
+    names[value] = name + "[tid]";
+    copies[value] = name;
+  }
+  codegen(phases);
+}
+
+std::vector<mlir::Value> CPUGenerator::collectArgs(mlir::AffineParallelOp gridLevel,
+                                                   std::vector<mlir::Operation*>& constants) {
+  std::vector<mlir::Value> args;
+  llvm::DenseSet<mlir::Value> seen;
+  gridLevel.walk<mlir::WalkOrder::PreOrder>([&](mlir::Operation* op) {
+    for (auto operand : op->getOperands()) {
+      auto owner = operand.getDefiningOp();
+      if (!owner) owner = operand.getParentBlock()->getParentOp();
+      if (gridLevel->isAncestor(owner) || !seen.insert(operand).second) continue;
+      // the constants of the function are copied into the kernel.
+      if (mlir::isa<mlir::arith::ConstantOp>(owner)) constants.push_back(owner);
+      else args.push_back(operand);
+    }
+  });
+  // the arguments of the function first and in their order, like CUDAGen.
+  std::stable_sort(args.begin(), args.end(), [](mlir::Value x, mlir::Value y) {
+    auto xArg = x.dyn_cast<mlir::BlockArgument>(), yArg = y.dyn_cast<mlir::BlockArgument>();
+    if (!xArg || !yArg) return xArg && !yArg;
+    return xArg.getArgNumber() < yArg.getArgNumber();
+  });
+  return args;
+}
+
+void CPUGenerator::codegen(mlir::AffineParallelOp gridLevel) {
+  names.clear();
+  copies.clear();
+  hoisted.clear();
+  nameCounter = 0;
+
+  int64_t blocks = 0;
+  std::vector<int64_t> gridDims = Analyzer::getParallelNumber(gridLevel, blocks);
+  std::vector<int64_t> blockDims;
+  gridLevel.walk<mlir::WalkOrder::PreOrder>([&](mlir::AffineParallelOp parallelOp) {
+    int64_t threads = 0;
+    if (parallelOp != gridLevel && blockDims.empty()) blockDims = Analyzer::getParallelNumber(parallelOp, threads);
+  });
+  indent();
+  source << "// grid dims:(";
+  for (auto dim : gridDims) source << dim << ", ";
+  source << "), block dims:(";
+  for (auto dim : blockDims) source << dim << ", ";
+  source << ")\n";
+
+  std::vector<mlir::Operation*> constants;
+  auto args = collectArgs(gridLevel, constants);
+  indent();
+  source << "extern \"C\" void kernel" << kernelCounter++ << "(";
+  for (int i = 0; i < args.size(); i++) {
+    auto name = "arg" + std::to_string(i);
+    names[args[i]] = name;
+    source << (i ? ", " : "") << declare(args[i], name);
+  }
+  source << ") {\n";
+  {
+    Indent level(curIndent);
+    for (auto op : constants) codegen(op);
+    indent();
+    if (parallel == CPUParallel::WorkStealing) {
+      source << "kcg_parallel_blocks(" << blocks << ", " << grain << ", [&](int64_t block) {\n";
+    } else {
+      source << "#pragma omp parallel for schedule(static)\n";
+      indent();
+      source << "for (int64_t block = 0; block < " << blocks << "; block++) {\n";
+    }
+    {
+      Indent level(curIndent);
+      // the last iv is x, the fastest one.
+      auto ivs = gridLevel.getIVs();
+      int64_t stride = 1;
+      for (int i = ivs.size() - 1; i >= 0; i--) {
+        auto name = "b" + std::to_string(i);
+        names[ivs[i]] = name;
+        indent();
+        source << "const int64_t " << name << " = block";
+        if (stride > 1) source << " / " << stride;
+        if (i > 0) source << " % " << gridDims[i];
+        source << ";\n";
+        stride *= gridDims[i];
+      }
+      codegen(*gridLevel.getBody());
+    }
+    indent();
+    source << (parallel == CPUParallel::WorkStealing ? "});\n" : "}\n");
+  }
+  indent();
+  source << "}\n\n";
+}
+
+std::string CPUGenerator::codegen(mlir::ModuleOp module) {
+  source << prologue;
+  if (parallel == CPUParallel::WorkStealing) source << runtimePrologue;
+  // the same walk as CUDAGen, so the kernels get the same names.
+  module.walk<mlir::WalkOrder::PreOrder>([&](mlir::func::FuncOp func) {
+    if (func.isExternal()) return;
+    for (auto& op : func.getBody().front()) {
+      if (auto gridLevel = mlir::dyn_cast<mlir::AffineParallelOp>(&op)) codegen(gridLevel);
+    }
+  });
+  return source.str();
+}
+
+}
+
+// Public API
+std::string CPUGen(mlir::ModuleOp &module, CPUParallel parallel, int64_t grain) {
+  auto sourceStr = CPUGenerator(parallel, grain).codegen(module);
+  if (KCGLog::level == Log::Debug) {
+    llvm::errs() << sourceStr;
+  }
+  return sourceStr;
+}
+
+}
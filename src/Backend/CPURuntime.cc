@@ -0,0 +1,268 @@
+#include "Backend/CPURuntime.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+namespace KernelCodeGen {
+
+namespace {
+
+thread_local WorkStealingPool* currentPool = nullptr;
+thread_local int currentWorker = -1;
+// the nesting of the ranges on this thread, only the outermost one counts as busy time.
+thread_local int rangeDepth = 0;
+thread_local uint64_t stealSeed = 0;
+
+std::mutex globalMutex;
+std::atomic<WorkStealingPool*> globalPool{nullptr};
+
+uint64_t now() {
+  auto time = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+}
+
+int defaultThreads() {
+  if (auto env = std::getenv("KCG_NUM_THREADS")) {
+    int threads = std::atoi(env);
+    if (threads > 0) return threads;
+  }
+  int threads = std::thread::hardware_concurrency();
+  return threads > 0 ? threads : 1;
+}
+
+uint64_t nextRandom(uint64_t& seed) {
+  // xorshift64, the victims only need to differ between the thieves.
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return seed;
+}
+
+}
+
+WorkStealingPool::WorkStealingPool(int threads_) {
+  if (threads_ <= 0) threads_ = defaultThreads();
+  // the caller of parallelFor helps, so threads_ - 1 workers keep threads_ cores busy.
+  for (int i = 0; i < threads_; i++) {
+    workers.push_back(std::make_unique<Worker>());
+    workers.back()->seed = 0x9E3779B97F4A7C15ull * (i + 1);
+  }
+  for (int i = 0; i < threads_ - 1; i++) {
+    threads.emplace_back([this, i]() { run(i); });
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& thread : threads) thread.join();
+}
+
+int WorkStealingPool::slot() const {
+  return currentPool == this && currentWorker >= 0 ? currentWorker : threads.size();
+}
+
+void WorkStealingPool::push(int id, Range range) {
+  {
+    std::lock_guard<std::mutex> lock(workers[id]->mutex);
+    workers[id]->ranges.push_back(std::move(range));
+  }
+  queued.fetch_add(1);
+  // a sleeper checks queued under sleepMutex after it counted itself, so either it sees the range or we see it.
+  if (sleeping.load() > 0) {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    wake.notify_one();
+  }
+}
+
+bool WorkStealingPool::pop(int id, Range& range) {
+  auto& worker = *workers[id];
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  if (worker.ranges.empty()) return false;
+  range = std::move(worker.ranges.back());
+  worker.ranges.pop_back();
+  queued.fetch_sub(1);
+  return true;
+}
+
+bool WorkStealingPool::steal(int id, Range& range) {
+  if (queued.load() == 0) return false;
+  int size = workers.size();
+  if (stealSeed == 0) stealSeed = workers[id]->seed ^ reinterpret_cast<uintptr_t>(&range);
+  int start = nextRandom(stealSeed) % size;
+  for (int i = 0; i < size; i++) {
+    int victim = (start + i) % size;
+    if (victim == id) continue;
+    auto& worker = *workers[victim];
+    // a busy victim is skipped rather than waited for, the thief comes back while queued is not 0.
+    std::unique_lock<std::mutex> lock(worker.mutex, std::try_to_lock);
+    if (!lock.owns_lock() || worker.ranges.empty()) continue;
+    range = std::move(worker.ranges.front());
+    worker.ranges.pop_front();
+    queued.fetch_sub(1);
+    workers[id]->steals.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+void WorkStealingPool::execute(int id, Range range) {
+  auto& job = *range.job;
+  while (range.end - range.begin > job.grain) {
+    // split at a multiple of the grain, the chunks keep the alignment of the range.
+    auto chunks = (range.end - range.begin + job.grain - 1) / job.grain;
+    auto middle = range.begin + chunks / 2 * job.grain;
+    push(id, Range{range.job, middle, range.end});
+    range.end = middle;
+  }
+
+  auto& worker = *workers[id];
+  auto start = rangeDepth == 0 ? now() : 0;
+  rangeDepth++;
+  job.fn(range.begin, range.end, job.context);
+  rangeDepth--;
+  if (rangeDepth == 0) worker.busyNs.fetch_add(now() - start, std::memory_order_relaxed);
+  worker.chunks.fetch_add(1, std::memory_order_relaxed);
+
+  auto count = range.end - range.begin;
+  if (job.remaining.fetch_sub(count) == count) {
+    std::lock_guard<std::mutex> lock(job.mutex);
+    job.done = true;
+    job.finished.notify_all();
+  }
+}
+
+void WorkStealingPool::run(int id) {
+  currentPool = this;
+  currentWorker = id;
+  auto& worker = *workers[id];
+  auto idleStart = now();
+  while (true) {
+    Range range;
+    if (take(id, range)) {
+      worker.idleNs.fetch_add(now() - idleStart, std::memory_order_relaxed);
+      execute(id, std::move(range));
+      idleStart = now();
+      continue;
+    }
+    // spin a little before sleeping, so a burst of small kernels doesn't pay a wake up for every one.
+    bool found = false;
+    for (int i = 0; i < 64 && !found; i++) {
+      std::this_thread::yield();
+      found = queued.load() > 0;
+    }
+    if (found) continue;
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleeping.fetch_add(1);
+    wake.wait(lock, [&]() { return stopping || queued.load() > 0; });
+    sleeping.fetch_sub(1);
+    if (stopping) break;
+  }
+  worker.idleNs.fetch_add(now() - idleStart, std::memory_order_relaxed);
+}
+
+void WorkStealingPool::parallelFor(int64_t begin, int64_t end, int64_t grain, kcg_range_fn fn, void* context) {
+  if (end <= begin) return;
+  auto total = end - begin;
+  if (grain <= 0) grain = std::max<int64_t>(1, total / (8 * static_cast<int64_t>(workers.size())));
+  auto id = slot();
+  auto job = std::make_shared<Job>();
+  job->fn = fn;
+  job->context = context;
+  // without workers the caller runs the range in one piece.
+  job->grain = threads.empty() ? total : grain;
+  job->remaining = total;
+  if (total <= job->grain) {
+    execute(id, Range{job, begin, end});
+    return;
+  }
+
+  push(id, Range{job, begin, end});
+  // help with any range until the ones of this job are done, a worker takes its own halves first.
+  auto& worker = *workers[id];
+  while (job->remaining.load() > 0) {
+    Range range;
+    if (take(id, range)) {
+      execute(id, std::move(range));
+      continue;
+    }
+    // the last ranges run on other threads, wake up now and then in case one of them splits again.
+    auto start = now();
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait_for(lock, std::chrono::microseconds(50), [&]() { return job->done; });
+    if (rangeDepth == 0) worker.idleNs.fetch_add(now() - start, std::memory_order_relaxed);
+  }
+}
+
+std::vector<kcg_worker_stats> WorkStealingPool::getStats() const {
+  std::vector<kcg_worker_stats> result;
+  for (auto& worker : workers) {
+    kcg_worker_stats stats;
+    stats.busyNs = worker->busyNs.load();
+    stats.idleNs = worker->idleNs.load();
+    stats.chunks = worker->chunks.load();
+    stats.steals = worker->steals.load();
+    result.push_back(stats);
+  }
+  return result;
+}
+
+void WorkStealingPool::resetStats() {
+  for (auto& worker : workers) {
+    worker->busyNs = 0;
+    worker->idleNs = 0;
+    worker->chunks = 0;
+    worker->steals = 0;
+  }
+}
+
+WorkStealingPool& WorkStealingPool::global() {
+  auto pool = globalPool.load(std::memory_order_acquire);
+  if (pool) return *pool;
+  std::lock_guard<std::mutex> lock(globalMutex);
+  pool = globalPool.load();
+  if (!pool) {
+    pool = new WorkStealingPool();
+    globalPool.store(pool, std::memory_order_release);
+  }
+  return *pool;
+}
+
+void WorkStealingPool::resetGlobal(int threads) {
+  std::lock_guard<std::mutex> lock(globalMutex);
+  delete globalPool.exchange(nullptr);
+  globalPool.store(new WorkStealingPool(threads), std::memory_order_release);
+}
+
+}
+
+extern "C" {
+
+void kcg_parallel_for(int64_t begin, int64_t end, int64_t grain, kcg_range_fn fn, void* context) {
+  KernelCodeGen::WorkStealingPool::global().parallelFor(begin, end, grain, fn, context);
+}
+
+void kcg_runtime_set_threads(int threads) {
+  KernelCodeGen::WorkStealingPool::resetGlobal(threads);
+}
+
+int kcg_runtime_num_threads() {
+  return KernelCodeGen::WorkStealingPool::global().getThreads();
+}
+
+int kcg_runtime_stats(kcg_worker_stats* stats, int capacity) {
+  auto all = KernelCodeGen::WorkStealingPool::global().getStats();
+  int count = std::min<int>(capacity, all.size());
+  std::copy(all.begin(), all.begin() + count, stats);
+  return count;
+}
+
+void kcg_runtime_reset_stats() {
+  KernelCodeGen::WorkStealingPool::global().resetStats();
+}
+
+}
@@ -96,7 +96,7 @@ struct Indent {
 /// the way. The only data member is the current indentation level.
 class CUDAGenerator {
 public:
-  CUDAGenerator() {
+  explicit CUDAGenerator(const DeviceProfile* device_) : device(device_) {
     kernelCounter = 0;
     varCounter = 0;
     valueNameMap.clear();
@@ -144,6 +144,8 @@ private:
       source << "  ";
   }
   int curIndent = -1;
+  // the target of the launch bounds, nullptr leaves the registers to ptxas.
+  const DeviceProfile* device;
 };
 
 // Helper Macro to bump the indentation level and print the leading spaces for
@@ -1035,6 +1037,17 @@ void CUDAGenerator::codegen(mlir::AffineParallelOp node) {
   for (auto dim : blockDims) source << dim << ", ";
   source << ")\n";
 
+  // minBlocks makes ptxas cap the registers so that many blocks of the estimate stay resident on the device,
+  // it spills when the estimate is below the real usage. Without a device only the block size is bound.
+  int64_t minBlocks = 0;
+  if (device) {
+    auto occupancy = Analyzer::getOccupancy(node, *device);
+    minBlocks = std::max<int64_t>(1, occupancy.blocksPerSM);
+    indent();
+    source << "// estimated registers:" << occupancy.registers << ", shared bytes:" << occupancy.sharedBytes
+           << ", occupancy:" << occupancy.occupancy << " (" << occupancy.limiter << ") on " << device->name << "\n";
+  }
+
   // kernel prototype
   indent();
   /*---------------重排args-----------------*/
@@ -1055,7 +1068,9 @@ void CUDAGenerator::codegen(mlir::AffineParallelOp node) {
   }
   inputVars.insert(inputVars.end(), outputVars.begin(), outputVars.end());
   /*--------------------------------*/
-  source << "__global__ void " << getKernelName() << "(";
+  source << "__global__ void __launch_bounds__(" << totalNumber;
+  if (minBlocks) source << ", " << minBlocks;
+  source << ") " << getKernelName() << "(";
   varDeclear(inputVars[0]);
   for (int i = 1; i < inputVars.size(); i += 1) {
     source << ", ";
@@ -1167,12 +1182,12 @@ void CUDAGenerator::codegen(mlir::ModuleOp module) {
 
 
 // Public API
-std::string CUDAGen(mlir::ModuleOp &module) {
+std::string CUDAGen(mlir::ModuleOp &module, const DeviceProfile* device) {
   source.clear();
   source.str("");
   source << "#include \"cuda_runtime.h\"\n";
   // source << "namespace " + module.getName().value().str() + " {\n";
-  CUDAGenerator().codegen(module); 
+  CUDAGenerator(device).codegen(module); 
   // source << "}\n";
   std::string sourceStr = source.str();
   if (KCGLog::level == Log::Debug) {
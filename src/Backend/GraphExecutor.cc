@@ -0,0 +1,354 @@
+#include "Backend/GraphExecutor.h"
+
+#include "mlir/Interfaces/SideEffectInterfaces.h"
+#include "mlir/Interfaces/ViewLikeInterface.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <set>
+
+namespace KernelCodeGen {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// the argument of the callee a memref is a view of, -1 if it is local to the callee.
+int getArgument(mlir::func::FuncOp func, mlir::Value value) {
+  while (auto view = value.getDefiningOp<mlir::ViewLikeOpInterface>()) value = view.getViewSource();
+  auto arg = value.dyn_cast<mlir::BlockArgument>();
+  if (!arg || arg.getOwner() != &func.front()) return -1;
+  return arg.getArgNumber();
+}
+
+// the arguments the callee stores to, unknown effects count as writes to every argument.
+std::vector<bool> getWrittenArgs(mlir::func::FuncOp func) {
+  std::vector<bool> written(func.getNumArguments(), false);
+  func.walk([&](mlir::Operation* op) {
+    auto effectOp = mlir::dyn_cast<mlir::MemoryEffectOpInterface>(op);
+    if (!effectOp) {
+      // the ops with regions are covered by the ops inside them.
+      if (op->getNumRegions() == 0 && !mlir::isa<mlir::func::ReturnOp>(op)) written.assign(written.size(), true);
+      return;
+    }
+    llvm::SmallVector<mlir::MemoryEffects::EffectInstance> effects;
+    effectOp.getEffects(effects);
+    for (auto& effect : effects) {
+      if (!mlir::isa<mlir::MemoryEffects::Write>(effect.getEffect())) continue;
+      auto value = effect.getValue();
+      // a write to no value in particular may hit any argument.
+      if (!value) {
+        written.assign(written.size(), true);
+        continue;
+      }
+      auto index = getArgument(func, value);
+      if (index >= 0) written[index] = true;
+    }
+  });
+  return written;
+}
+
+// the argument every result returns, -1 for the memrefs the callee allocates.
+std::vector<int> getReturnedArgs(mlir::func::FuncOp func) {
+  std::vector<int> returned(func.getNumResults(), -1);
+  auto returnOp = mlir::dyn_cast<mlir::func::ReturnOp>(func.front().getTerminator());
+  if (!returnOp) return returned;
+  for (int i = 0; i < returnOp.getNumOperands(); i++) {
+    auto arg = returnOp.getOperand(i).dyn_cast<mlir::BlockArgument>();
+    if (arg && arg.getOwner() == &func.front()) returned[i] = arg.getArgNumber();
+  }
+  return returned;
+}
+
+}
+
+struct GraphExecutor::RunState {
+  // the deps of every node which didn't finish yet.
+  std::vector<std::atomic<int>> pending;
+  std::vector<void*> data;
+  std::vector<GraphReport::NodeTime> times;
+  Clock::time_point start;
+  std::atomic<bool> failed{false};
+};
+
+struct GraphExecutor::Batch {
+  GraphExecutor* executor;
+  RunState* state;
+  std::vector<int> nodes;
+};
+
+std::string GraphReport::toJson() const {
+  llvm::json::Array array;
+  for (auto& node : nodes) {
+    array.push_back(llvm::json::Object{{"function", node.symbol}, {"startMs", node.startMs}, {"endMs", node.endMs}});
+  }
+  llvm::json::Array path;
+  for (auto id : criticalPath) path.push_back(id);
+  llvm::json::Object report{
+    {"wallMs", wallMs}, {"workMs", workMs}, {"criticalPathMs", criticalPathMs},
+    {"parallelism", parallelism()}, {"speedup", wallMs > 0.0 ? workMs / wallMs : 1.0},
+    {"criticalPath", std::move(path)}, {"nodes", std::move(array)}
+  };
+  return llvm::formatv("{0:2}", llvm::json::Value(std::move(report))).str() + "\n";
+}
+
+bool GraphExecutor::build(mlir::ModuleOp module) {
+  nodes.clear();
+  buffers.clear();
+  inputs.clear();
+  outputs.clear();
+
+  std::map<std::string, mlir::func::FuncOp> funcs;
+  for (auto func : module.getOps<mlir::func::FuncOp>()) funcs[func.getSymName().str()] = func;
+
+  // the value of every buffer, the PlaceHolders first and the call results as they are defined.
+  llvm::DenseMap<mlir::Value, int> bufferIds;
+  std::vector<bool> placeHolder;
+  auto addBuffer = [&](mlir::Value value) {
+    auto type = value.getType().dyn_cast<mlir::MemRefType>();
+    if (!type || !type.hasStaticShape()) return -1;
+    int id = buffers.size();
+    buffers.push_back(Buffer{type.getShape().vec(), (type.getElementTypeBitWidth() + 7) / 8});
+    placeHolder.push_back(value.getDefiningOp<mlir::memref::AllocOp>() != nullptr);
+    bufferIds[value] = id;
+    return id;
+  };
+
+  // compiled every time: the JIT may hold the code of another module (e.g. the graph before optimize()) for the
+  // same symbols, a module it compiled before is found by its digest.
+  bool compiled = jit.compile(module);
+
+  std::vector<int> lastWriter;
+  std::vector<std::vector<int>> readers;
+  std::vector<bool> written;
+  for (auto& op : module.getBody()->getOperations()) {
+    if (auto allocOp = mlir::dyn_cast<mlir::memref::AllocOp>(op)) {
+      if (addBuffer(allocOp.getResult()) < 0) {
+        llvm::errs() << "The graph executor needs PlaceHolders of static shapes\n";
+        return false;
+      }
+      continue;
+    }
+    auto callOp = mlir::dyn_cast<mlir::func::CallOp>(op);
+    if (!callOp) continue;
+    auto symbol = callOp.getCallee().str();
+    auto iter = funcs.find(symbol);
+    if (iter == funcs.end() || iter->second.isExternal()) {
+      llvm::errs() << "No body for the call of " << symbol << "\n";
+      return false;
+    }
+    if (!compiled || !jit.has(symbol)) {
+      llvm::errs() << "The graph executor can't run " << symbol << " on the host\n";
+      return false;
+    }
+
+    GraphNode node;
+    node.symbol = symbol;
+    for (auto operand : callOp.getOperands()) {
+      auto found = bufferIds.find(operand);
+      if (found == bufferIds.end()) {
+        llvm::errs() << "An operand of " << symbol << " is no buffer of the graph\n";
+        return false;
+      }
+      node.args.push_back(found->second);
+    }
+    auto writes = getWrittenArgs(iter->second);
+    auto returned = getReturnedArgs(iter->second);
+    int id = nodes.size();
+    lastWriter.resize(buffers.size(), -1);
+    readers.resize(buffers.size());
+    written.resize(buffers.size(), false);
+
+    std::set<int> deps;
+    for (int i = 0; i < node.args.size(); i++) {
+      auto buffer = node.args[i];
+      if (lastWriter[buffer] >= 0) deps.insert(lastWriter[buffer]);
+      if (writes[i]) deps.insert(readers[buffer].begin(), readers[buffer].end());
+    }
+    for (int i = 0; i < node.args.size(); i++) {
+      auto buffer = node.args[i];
+      if (!writes[i]) {
+        readers[buffer].push_back(id);
+        continue;
+      }
+      lastWriter[buffer] = id;
+      readers[buffer].clear();
+      written[buffer] = true;
+    }
+
+    for (int i = 0; i < callOp.getNumResults(); i++) {
+      auto result = callOp.getResult(i);
+      if (returned[i] >= 0) {
+        node.results.push_back(node.args[returned[i]]);
+        bufferIds[result] = node.args[returned[i]];
+        continue;
+      }
+      auto buffer = addBuffer(result);
+      if (buffer < 0) {
+        llvm::errs() << symbol << " returns more than static memrefs\n";
+        return false;
+      }
+      node.results.push_back(buffer);
+      lastWriter.push_back(id);
+      readers.emplace_back();
+      written.push_back(true);
+    }
+
+    deps.erase(id);
+    node.deps.assign(deps.begin(), deps.end());
+    for (auto dep : node.deps) nodes[dep].users.push_back(id);
+    nodes.push_back(std::move(node));
+  }
+
+  written.resize(buffers.size(), false);
+  readers.resize(buffers.size());
+  for (int i = 0; i < buffers.size(); i++) {
+    if (placeHolder[i] && !written[i]) inputs.push_back(i);
+  }
+  // a buffer is an output if its last writer is the last call which touches it.
+  std::set<int> seen;
+  for (int id = 0; id < nodes.size(); id++) {
+    for (auto buffer : nodes[id].results) {
+      if (!seen.insert(buffer).second || lastWriter[buffer] != id) continue;
+      bool read = false;
+      for (auto reader : readers[buffer]) read |= reader != id;
+      if (!read) outputs.push_back(buffer);
+    }
+  }
+  return true;
+}
+
+std::vector<std::vector<int64_t>> GraphExecutor::getInputShapes() const {
+  std::vector<std::vector<int64_t>> result;
+  for (auto buffer : inputs) result.push_back(buffers[buffer].shape);
+  return result;
+}
+
+std::vector<std::vector<int64_t>> GraphExecutor::getOutputShapes() const {
+  std::vector<std::vector<int64_t>> result;
+  for (auto buffer : outputs) result.push_back(buffers[buffer].shape);
+  return result;
+}
+
+bool GraphExecutor::callNode(RunState& state, int id) {
+  auto& node = nodes[id];
+  std::vector<HostBuffer> args, results;
+  for (auto buffer : node.args) args.push_back(HostBuffer{state.data[buffer], buffers[buffer].shape});
+  for (auto buffer : node.results) results.push_back(HostBuffer{state.data[buffer], buffers[buffer].shape});
+  auto& time = state.times[id];
+  time.symbol = node.symbol;
+  time.startMs = elapsedMs(state.start);
+  bool success = jit.call(node.symbol, args, results);
+  time.endMs = elapsedMs(state.start);
+  return success;
+}
+
+void GraphExecutor::runNode(RunState& state, int id) {
+  while (id >= 0) {
+    // after a failure the nodes only count down their users, so the run still comes to an end.
+    if (!state.failed.load() && !callNode(state, id)) state.failed = true;
+
+    Batch ready{this, &state, {}};
+    for (auto user : nodes[id].users) {
+      if (state.pending[user].fetch_sub(1) == 1) ready.nodes.push_back(user);
+    }
+    // a chain goes on in this thread, a fork runs its branches on the pool and waits for them.
+    id = ready.nodes.size() == 1 ? ready.nodes.front() : -1;
+    if (ready.nodes.size() > 1) {
+      auto& target = pool ? *pool : WorkStealingPool::global();
+      target.parallelFor(0, ready.nodes.size(), 1, &GraphExecutor::runBatch, &ready);
+    }
+  }
+}
+
+void GraphExecutor::runBatch(int64_t begin, int64_t end, void* context) {
+  auto& batch = *static_cast<Batch*>(context);
+  for (auto i = begin; i < end; i++) batch.executor->runNode(*batch.state, batch.nodes[i]);
+}
+
+bool GraphExecutor::run(const std::vector<HostBuffer>& inputs_, std::vector<HostBuffer>& outputs_,
+                        GraphReport* report) {
+  if (inputs_.size() != inputs.size() || outputs_.size() != outputs.size()) {
+    llvm::errs() << "The graph takes " << inputs.size() << " inputs and " << outputs.size() << " outputs, got "
+                 << inputs_.size() << " and " << outputs_.size() << "\n";
+    return false;
+  }
+  RunState state;
+  state.data.assign(buffers.size(), nullptr);
+  auto bind = [&](const std::vector<HostBuffer>& given, const std::vector<int>& ids, const char* kind) {
+    for (int i = 0; i < ids.size(); i++) {
+      auto& shape = buffers[ids[i]].shape;
+      if (!given[i].data || (!given[i].shape.empty() && given[i].shape != shape)) {
+        llvm::errs() << "The " << kind << " " << i << " of the graph is null or has a wrong shape\n";
+        return false;
+      }
+      state.data[ids[i]] = given[i].data;
+    }
+    return true;
+  };
+  if (!bind(inputs_, inputs, "input") || !bind(outputs_, outputs, "output")) return false;
+
+  // the intermediates live as long as the run.
+  std::vector<std::vector<char>> storage;
+  for (int i = 0; i < buffers.size(); i++) {
+    if (state.data[i]) continue;
+    int64_t bytes = buffers[i].elementBytes;
+    for (auto dim : buffers[i].shape) bytes *= dim;
+    storage.emplace_back(bytes, 0);
+    state.data[i] = storage.back().data();
+  }
+
+  state.pending = std::vector<std::atomic<int>>(nodes.size());
+  Batch roots{this, &state, {}};
+  for (int i = 0; i < nodes.size(); i++) {
+    state.pending[i] = nodes[i].deps.size();
+    if (nodes[i].deps.empty()) roots.nodes.push_back(i);
+  }
+  state.times.resize(nodes.size());
+  state.start = Clock::now();
+  if (!concurrent) {
+    // the program order is a topological order.
+    for (int i = 0; i < nodes.size() && !state.failed; i++) state.failed = !callNode(state, i);
+  } else if (!roots.nodes.empty()) {
+    auto& target = pool ? *pool : WorkStealingPool::global();
+    target.parallelFor(0, roots.nodes.size(), 1, &GraphExecutor::runBatch, &roots);
+  }
+  auto wallMs = elapsedMs(state.start);
+  if (state.failed) return false;
+
+  if (report) {
+    report->nodes = state.times;
+    report->wallMs = wallMs;
+    report->workMs = 0.0;
+    // nodes come in a topological order, the longest chain ending at a node extends one of its deps.
+    std::vector<double> finish(nodes.size(), 0.0);
+    std::vector<int> previous(nodes.size(), -1);
+    int last = -1;
+    for (int i = 0; i < nodes.size(); i++) {
+      auto cost = state.times[i].endMs - state.times[i].startMs;
+      report->workMs += cost;
+      for (auto dep : nodes[i].deps) {
+        if (finish[dep] <= finish[i]) continue;
+        finish[i] = finish[dep];
+        previous[i] = dep;
+      }
+      finish[i] += cost;
+      if (last < 0 || finish[i] > finish[last]) last = i;
+    }
+    report->criticalPathMs = last >= 0 ? finish[last] : 0.0;
+    report->criticalPath.clear();
+    for (auto id = last; id >= 0; id = previous[id]) report->criticalPath.push_back(id);
+    std::reverse(report->criticalPath.begin(), report->criticalPath.end());
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,283 @@
+#include "Backend/HostJIT.h"
+#include "AutoTune/Evaluator.h"
+
+#include "mlir/Target/LLVMIR/Dialect/LLVMIR/LLVMToLLVMIRTranslation.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <set>
+
+namespace KernelCodeGen {
+
+namespace {
+
+bool isHostFunc(mlir::func::FuncOp func) {
+  auto attr = func->getAttrOfType<mlir::StringAttr>(std::string("func.state"));
+  return !func.isExternal() && attr && attr.getValue() == "cpu";
+}
+
+// a ranked memref descriptor: allocated and aligned pointers, offset, sizes and strides.
+int64_t getDescriptorSize(int64_t rank) {
+  return 3 + 2 * rank;
+}
+
+int64_t getNumElements(const std::vector<int64_t>& shape) {
+  int64_t result = 1;
+  for (auto dim : shape) result *= dim;
+  return result;
+}
+
+void fillDescriptor(int64_t* descriptor, void* data, const std::vector<int64_t>& shape) {
+  int64_t rank = shape.size();
+  descriptor[0] = descriptor[1] = reinterpret_cast<intptr_t>(data);
+  descriptor[2] = 0;
+  int64_t stride = 1;
+  for (int64_t i = rank - 1; i >= 0; i--) {
+    descriptor[3 + i] = shape[i];
+    descriptor[3 + rank + i] = stride;
+    stride *= shape[i];
+  }
+}
+
+bool matches(const HostBuffer& buffer, const std::vector<int64_t>& shape) {
+  return buffer.data && (buffer.shape.empty() || buffer.shape == shape);
+}
+
+}
+
+HostJIT::~HostJIT() = default;
+
+bool HostJIT::compile(mlir::ModuleOp module) {
+  static std::once_flag initTarget;
+  std::call_once(initTarget, []() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+  });
+
+  // the graph allocates and calls at the module level, which can't be lowered, and the gpu functions go to the backends.
+  auto jitModule = mlir::dyn_cast<mlir::ModuleOp>(module->clone());
+  std::vector<mlir::Operation*> dropped;
+  std::vector<mlir::func::FuncOp> funcs;
+  for (auto& op : jitModule.getBody()->getOperations()) {
+    auto func = mlir::dyn_cast<mlir::func::FuncOp>(op);
+    if (func && isHostFunc(func)) funcs.push_back(func);
+    else dropped.push_back(&op);
+  }
+  for (auto iter = dropped.rbegin(); iter != dropped.rend(); ++iter) {
+    (*iter)->dropAllUses();
+    (*iter)->erase();
+  }
+  if (funcs.empty()) {
+    jitModule->erase();
+    return false;
+  }
+
+  std::string text;
+  llvm::raw_string_ostream os(text);
+  jitModule.print(os);
+  uint64_t digest = std::hash<std::string>()(os.str());
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cached = engines.find(digest);
+    if (cached != engines.end()) {
+      for (auto& item : cached->second.entries) entries[item.first] = item.second;
+      jitModule->erase();
+      return true;
+    }
+  }
+
+  std::map<std::string, HostSignature> signatures;
+  mlir::OpBuilder builder(jitModule.getContext());
+  for (auto func : funcs) {
+    HostSignature signature;
+    bool valid = true;
+    auto collect = [&](mlir::TypeRange types, std::vector<std::vector<int64_t>>& shapes, std::vector<int64_t>& bytes) {
+      for (auto type : types) {
+        auto memrefType = type.dyn_cast<mlir::MemRefType>();
+        if (!memrefType || !memrefType.hasStaticShape()) {
+          valid = false;
+          return;
+        }
+        shapes.push_back(memrefType.getShape().vec());
+        bytes.push_back((memrefType.getElementTypeBitWidth() + 7) / 8);
+      }
+    };
+    auto type = func.getFunctionType();
+    collect(type.getInputs(), signature.argShapes, signature.argElementBytes);
+    collect(type.getResults(), signature.resultShapes, signature.resultElementBytes);
+    auto symbol = func.getSymName().str();
+    if (!valid) {
+      llvm::errs() << "Skip the JIT of " << symbol << ", it takes or returns more than static memrefs\n";
+      func.erase();
+      continue;
+    }
+    // the C interface takes every memref as a pointer to its descriptor.
+    func->setAttr(std::string("llvm.emit_c_interface"), builder.getUnitAttr());
+    signatures[symbol] = std::move(signature);
+  }
+
+  mlir::registerLLVMDialectTranslation(*jitModule.getContext());
+  if (signatures.empty() || !HostEvaluator::lowerToLLVM(jitModule)) {
+    llvm::errs() << "Failed to lower the host functions for the JIT\n";
+    jitModule->erase();
+    return false;
+  }
+
+  // the target machine of the host lets the LLVM vectorizers use the native vector width.
+  Compiled compiled;
+  auto machineBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (machineBuilder) {
+    auto machine = machineBuilder->createTargetMachine();
+    if (machine) compiled.targetMachine = std::move(*machine);
+    else llvm::consumeError(machine.takeError());
+  } else {
+    llvm::consumeError(machineBuilder.takeError());
+  }
+  mlir::ExecutionEngineOptions options;
+  options.transformer = mlir::makeOptimizingTransformer(optLevel, /*sizeLevel=*/0, compiled.targetMachine.get());
+  auto maybeEngine = mlir::ExecutionEngine::create(jitModule, options);
+  jitModule->erase();
+  if (!maybeEngine) {
+    llvm::errs() << "Failed to create the execution engine: " << llvm::toString(maybeEngine.takeError()) << "\n";
+    return false;
+  }
+  compiled.engine = std::move(*maybeEngine);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& item : signatures) {
+    auto packed = compiled.engine->lookupPacked("_mlir_ciface_" + item.first);
+    if (!packed) {
+      llvm::errs() << "No entry point for " << item.first << ": " << llvm::toString(packed.takeError()) << "\n";
+      continue;
+    }
+    Entry entry;
+    entry.packed = *packed;
+    entry.signature = item.second;
+    entries[item.first] = entry;
+    compiled.entries[item.first] = std::move(entry);
+  }
+  engines[digest] = std::move(compiled);
+  return true;
+}
+
+bool HostJIT::has(const std::string& symbol) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.count(symbol) != 0;
+}
+
+const HostSignature* HostJIT::getSignature(const std::string& symbol) {
+  auto entry = lookup(symbol);
+  return entry ? &entry->signature : nullptr;
+}
+
+const HostJIT::Entry* HostJIT::lookup(const std::string& symbol) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto iter = entries.find(symbol);
+  if (iter == entries.end()) {
+    llvm::errs() << "No jitted function " << symbol << "\n";
+    return nullptr;
+  }
+  // the nodes of a std::map stay in place, the entry outlives the lock.
+  return &iter->second;
+}
+
+bool HostJIT::invoke(const Entry& entry, const std::vector<HostBuffer>& args, std::vector<int64_t>& resultDescriptors) {
+  auto& signature = entry.signature;
+  if (args.size() != signature.argShapes.size()) {
+    llvm::errs() << "Expected " << signature.argShapes.size() << " arguments, got " << args.size() << "\n";
+    return false;
+  }
+  std::vector<std::vector<int64_t>> argDescriptors;
+  for (int i = 0; i < args.size(); i++) {
+    auto& shape = signature.argShapes[i];
+    if (!matches(args[i], shape)) {
+      llvm::errs() << "Argument " << i << " is null or has a wrong shape\n";
+      return false;
+    }
+    argDescriptors.emplace_back(getDescriptorSize(shape.size()));
+    fillDescriptor(argDescriptors.back().data(), args[i].data, shape);
+  }
+  int64_t resultSize = 0;
+  for (auto& shape : signature.resultShapes) resultSize += getDescriptorSize(shape.size());
+  resultDescriptors.assign(resultSize, 0);
+
+  // the returned memrefs come back through a pointer to their descriptors, as one struct, before the arguments.
+  std::vector<void*> pointers;
+  if (resultSize) pointers.push_back(resultDescriptors.data());
+  for (auto& descriptor : argDescriptors) pointers.push_back(descriptor.data());
+  // the packed interface takes a pointer to every argument.
+  std::vector<void*> packed;
+  for (auto& pointer : pointers) packed.push_back(&pointer);
+  entry.packed(packed.data());
+  return true;
+}
+
+void HostJIT::release(const Entry& entry, const std::vector<HostBuffer>& args,
+                      const std::vector<int64_t>& resultDescriptors) {
+  std::set<intptr_t> freed;
+  for (auto& arg : args) freed.insert(reinterpret_cast<intptr_t>(arg.data));
+  int64_t position = 0;
+  for (auto& shape : entry.signature.resultShapes) {
+    auto allocated = resultDescriptors[position];
+    position += getDescriptorSize(shape.size());
+    // a function may return one of its arguments, or the same buffer twice.
+    if (!allocated || !freed.insert(allocated).second) continue;
+    std::free(reinterpret_cast<void*>(allocated));
+  }
+}
+
+bool HostJIT::call(const std::string& symbol, const std::vector<HostBuffer>& args, std::vector<HostBuffer>& results) {
+  auto entry = lookup(symbol);
+  if (!entry) return false;
+  auto& signature = entry->signature;
+  if (results.size() != signature.resultShapes.size()) {
+    llvm::errs() << symbol << " returns " << signature.resultShapes.size() << " memrefs, got "
+                 << results.size() << " result buffers\n";
+    return false;
+  }
+  for (int i = 0; i < results.size(); i++) {
+    if (matches(results[i], signature.resultShapes[i])) continue;
+    llvm::errs() << "Result " << i << " of " << symbol << " is null or has a wrong shape\n";
+    return false;
+  }
+
+  std::vector<int64_t> descriptors;
+  if (!invoke(*entry, args, descriptors)) return false;
+  int64_t position = 0;
+  for (int i = 0; i < results.size(); i++) {
+    auto& shape = signature.resultShapes[i];
+    auto elementBytes = signature.resultElementBytes[i];
+    auto descriptor = descriptors.data() + position;
+    position += getDescriptorSize(shape.size());
+    // the functions return identity layouts, the elements are contiguous from the offset on.
+    auto aligned = reinterpret_cast<char*>(descriptor[1]) + descriptor[2] * elementBytes;
+    std::memmove(results[i].data, aligned, getNumElements(shape) * elementBytes);
+  }
+  release(*entry, args, descriptors);
+  return true;
+}
+
+float HostJIT::measure(const std::string& symbol, const std::vector<HostBuffer>& args, int repeats) {
+  auto entry = lookup(symbol);
+  if (!entry) return -1.0f;
+  double best = DBL_MAX;
+  // the first run warms up the caches and the lazy symbol resolution.
+  for (int i = 0; i <= std::max(repeats, 1); i++) {
+    std::vector<int64_t> descriptors;
+    auto start = std::chrono::steady_clock::now();
+    if (!invoke(*entry, args, descriptors)) return -1.0f;
+    auto end = std::chrono::steady_clock::now();
+    release(*entry, args, descriptors);
+    if (i != 0) best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return static_cast<float>(best);
+}
+
+}
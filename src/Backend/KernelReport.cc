@@ -0,0 +1,76 @@
+#include "Backend/KernelReport.h"
+#include "AutoTune/Evaluator.h"
+#include "Optimizer/Analyzer.h"
+
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+
+namespace KernelCodeGen {
+
+namespace {
+
+// dim3 order: the last iv of an affine.parallel is x.
+llvm::json::Array toDim3(const std::vector<int64_t>& dims) {
+  llvm::json::Array result;
+  for (int i = 0; i < 3; i++) result.push_back(i < dims.size() ? dims[dims.size() - 1 - i] : 1);
+  return result;
+}
+
+llvm::json::Object describe(const std::string& name, const std::string& symbol, const KernelStats& kernel,
+                            const DeviceProfile& device) {
+  auto occupancy = Analyzer::getOccupancy(kernel.blocks, kernel.threads, kernel.registers, kernel.sharedAlloc, device);
+  // the stats count one block.
+  auto flops = kernel.flops * kernel.blocks, globalBytes = kernel.globalBytes * kernel.blocks;
+  return llvm::json::Object{
+    {"name", name}, {"function", symbol},
+    {"grid", toDim3(kernel.grid)}, {"block", toDim3(kernel.block)},
+    {"blocks", kernel.blocks}, {"threads", kernel.threads},
+    {"sharedBytes", kernel.sharedAlloc}, {"registers", kernel.registers},
+    {"occupancy", occupancy.occupancy}, {"occupancyLimiter", occupancy.limiter}, {"waves", occupancy.waves},
+    {"flops", flops}, {"globalBytes", globalBytes}, {"sharedTraffic", kernel.sharedBytes * kernel.blocks},
+    {"intensity", globalBytes > 0.0 ? flops / globalBytes : 0.0},
+    {"bankConflictDegree", kernel.bankConflictDegree}, {"sectorEfficiency", kernel.sectorEfficiency},
+    {"predictedMs", RooflineEvaluator::kernelLatency(kernel, device)}
+  };
+}
+
+}
+
+std::string KernelReportGen(mlir::ModuleOp& module, const DeviceProfile& device,
+                            const std::map<std::string, TuningRecord>& tuned) {
+  llvm::json::Array kernels;
+  // CUDAGen names the kernels kernel0, kernel1, ... over the functions in module order.
+  int64_t counter = 0;
+  module.walk<mlir::WalkOrder::PreOrder>([&](mlir::func::FuncOp func) {
+    if (func.isExternal()) return;
+    auto symbol = func.getSymName().str();
+    auto stats = RooflineEvaluator::collectKernels(func);
+    int index = 0;
+    for (auto& op : func.getBody().front()) {
+      auto gridLevel = mlir::dyn_cast<mlir::AffineParallelOp>(&op);
+      if (!gridLevel) continue;
+      auto name = std::string("kernel") + std::to_string(counter++);
+      llvm::json::Object object;
+      // collectKernels() skips the grids without constant ranges.
+      if (gridLevel.getConstantRanges()) {
+        object = describe(name, symbol, stats[index++], device);
+      } else {
+        object = llvm::json::Object{{"name", name}, {"function", symbol}};
+      }
+      auto iter = tuned.find(symbol);
+      if (iter != tuned.end()) {
+        llvm::json::Object config;
+        for (auto& item : iter->second.config) config[item.first] = item.second;
+        object["config"] = std::move(config);
+        object["tunedLatency"] = iter->second.latency;
+      }
+      kernels.push_back(std::move(object));
+    }
+  });
+
+  auto moduleName = module.getName() ? module.getName()->str() : std::string();
+  llvm::json::Object report{{"module", moduleName}, {"device", device.name}, {"kernels", std::move(kernels)}};
+  return llvm::formatv("{0:2}", llvm::json::Value(std::move(report))).str() + "\n";
+}
+
+}
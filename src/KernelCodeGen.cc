@@ -1,121 +1,366 @@
 #include "KernelCodeGen.h"
 #include "log.h"
 
+#include "llvm/Support/ThreadPool.h"
+
 namespace KernelCodeGen {
 
 Log KCGLog::level = Log::Release;
 
-mlir::ModuleOp& KernelCodeGenerator::optimize(ComputeDAG& graph_) {
-  graph = graph_;
-  mlir::Operation *cloned = graph.module->clone();
-  auto module = mlir::dyn_cast<mlir::ModuleOp>(cloned);
+std::vector<std::map<std::string, int>>* KernelCodeGenerator::getConfigs(Optimizer& opt) {
+  if (opt == FMHAOptimizer()) return &fmhaConfigs;
+  if (opt == MatmulOptimizer()) return &matmulConfigs;
+  if (opt == BinaryOptimizer()) return &binaryConfigs;
+  if (opt == ElementWiseOptimizer()) return &elementWiseConfigs;
+  if (opt == LayerNormOptimizer()) return &layerNormConfigs;
+  if (opt == GatherOptimizer()) return &gatherConfigs;
+  if (opt == BatchMatmulOptimizer()) return &batchMatmulConfigs;
+  return nullptr;
+}
 
-  saveBestModule(module);
+bool KernelCodeGenerator::acceptKernels(mlir::ModuleOp& module, const std::set<std::string>& targets) {
+  auto reject = [&](const std::string& symbol, const std::string& why) {
+    if (KCGLog::level == Log::Debug) llvm::errs() << "Rejected a kernel of " << symbol << ": " << why << "\n";
+    return false;
+  };
+  for (auto func : module.getOps<mlir::func::FuncOp>()) {
+    auto symbol = func.getSymName().str();
+    if (func.isExternal() || (!targets.empty() && targets.count(symbol) == 0)) continue;
+    for (auto& kernel : RooflineEvaluator::collectKernels(func)) {
+      auto occupancy = Analyzer::getOccupancy(kernel.blocks, kernel.threads, kernel.registers, kernel.sharedAlloc,
+                                              device);
+      ResourceUsage usage;
+      usage.threads = occupancy.threads;
+      usage.sharedBytes = occupancy.sharedBytes;
+      usage.registers = occupancy.registers;
+      usage.blocksPerSM = occupancy.blocksPerSM;
+      usage.occupancy = occupancy.occupancy;
+      std::string why;
+      if (!ResourceFilter::feasible(usage, device, minOccupancy, &why)) {
+        return reject(symbol, why + " (" + std::to_string(kernel.registers) + " registers estimated, bound by " +
+                              occupancy.limiter + ")");
+      }
+      if (maxBankConflict > 0.0 && kernel.bankConflictDegree > maxBankConflict) {
+        return reject(symbol, "bank conflict degree " + std::to_string(kernel.bankConflictDegree));
+      }
+    }
+  }
+  return true;
+}
 
-  for (auto& opt : opts) {
-    backupModule(module);
-    if (*opt == FMHAOptimizer()) {
-      for (auto& fmhaConfig : fmhaConfigs) {
-        FMHAOptimizer::fmhaConfig = fmhaConfig;
-        resetModule(module);
-        if (opt->applicable(module)) {
-          opt->applyOptimzer(module, builder);
-          auto curLatency = evaluate(module);
-          if (curLatency < minLatency) {
-            minLatency = curLatency;
-            saveBestModule(module);
-          }
+KernelCodeGenerator::Candidate KernelCodeGenerator::tuneCandidate(const std::string& optName,
+    const std::set<std::string>& targets, const std::map<std::string, int>& config, const std::string& moduleText) {
+  Candidate candidate;
+  candidate.config = config;
+
+  // Every candidate owns its context, so no IR is shared between the workers.
+  mlir::MLIRContext localContext;
+  localContext.disableMultithreading();
+  loadDialects(localContext);
+  auto owned = mlir::parseSourceString<mlir::ModuleOp>(moduleText, &localContext);
+  if (!owned) {
+    llvm::errs() << "Failed to parse the module of candidate\n";
+    return candidate;
+  }
+  auto module = owned.get();
+
+  auto opt = createOptimizer(optName);
+  if (!opt) return candidate;
+  opt->targets = targets;
+  if (!opt->setConfig(config) || !opt->applicable(module)) return candidate;
+
+  mlir::OpBuilder localBuilder(&localContext);
+  opt->applyOptimzer(module, localBuilder);
+  if (!acceptKernels(module, targets)) return candidate;
+  candidate.latency = evaluate(module);
+
+  llvm::raw_string_ostream os(candidate.moduleText);
+  module->print(os);
+  os.flush();
+  candidate.valid = true;
+  return candidate;
+}
+
+std::vector<KernelCodeGenerator::Candidate> KernelCodeGenerator::tuneParallel(Optimizer& opt,
+    const std::vector<std::map<std::string, int>>& configs, mlir::ModuleOp& module, llvm::ThreadPool& pool) {
+  std::string moduleText;
+  llvm::raw_string_ostream os(moduleText);
+  module->print(os);
+  os.flush();
+
+  std::vector<Candidate> candidates(configs.size());
+  for (size_t i = 0; i < configs.size(); i++) {
+    pool.async([&, i]() {
+      candidates[i] = tuneCandidate(opt.name, opt.targets, configs[i], moduleText);
+    });
+  }
+  pool.wait();
+  return candidates;
+}
+
+bool KernelCodeGenerator::tuneFunction(Optimizer& opt, const OpShape& shape,
+    const std::vector<std::map<std::string, int>>& defaults, mlir::ModuleOp& module, TuningRecord& winner) {
+  winner = TuningRecord();
+  winner.m = shape.m;
+  winner.n = shape.n;
+  winner.k = shape.k;
+  for (auto b : shape.batch) winner.batch *= b;
+
+  // a known signature skips the search.
+  TuningKey key;
+  TuningRecord hit;
+  if (database) {
+    key = TuningDatabase::makeKey(opt.name, {shape}, device, evaluator->digest());
+    if (database->lookup(key, hit)) {
+      // the hit passes the same checks as a candidate, a stricter occupancy floor or bank conflict limit searches again.
+      auto original = mlir::dyn_cast<mlir::ModuleOp>(module->clone());
+      if (opt.setConfig(hit.config) && opt.applicable(module)) {
+        opt.applyOptimzer(module, builder);
+        if (acceptKernels(module, opt.targets)) {
+          original->erase();
+          winner = hit;
+          return true;
         }
       }
-    } else if (*opt == MatmulOptimizer()) {
-      for (auto& matmulConfig : matmulConfigs) {
-        MatmulOptimizer::matmulConfig = matmulConfig;
-        resetModule(module);
-        if (opt->applicable(module)) {
-          opt->applyOptimzer(module, builder);
-          auto curLatency = evaluate(module);
-          if (curLatency < minLatency) {
-            minLatency = curLatency;
-            saveBestModule(module);
-          }
-        }
+      module->erase();
+      module = original;
+    }
+  }
+
+  auto configs = defaults;
+  if (searchSpace) {
+    auto generated = SearchSpace::generate(opt.name, shape, device);
+    if (!generated.empty()) configs = std::move(generated);
+  }
+
+  // unseen shapes start from the winners of the nearest tuned shapes.
+  std::vector<TuneConfig> transferred;
+  if (database && transferMode != TransferMode::Off) {
+    // the neighbours may come from another space, a fresh instance checks them the way the candidates are applied.
+    // an optimizer createOptimizer doesn't know can't be probed, it searches without transfer.
+    auto probe = createOptimizer(opt.name);
+    if (probe) {
+      probe->targets = opt.targets;
+      probe->reused = opt.reused;
+      for (auto& config : Transfer::nearestConfigs(*database, key, {shape}, device, transferTopK)) {
+        if (probe->setConfig(config) && probe->applicable(module)) transferred.push_back(config);
       }
-    } else if (*opt == BinaryOptimizer()) {
-      for (auto& binaryConfig : binaryConfigs) {
-        BinaryOptimizer::binaryConfig = binaryConfig;
-        resetModule(module);
-        if (opt->applicable(module)) {
-          opt->applyOptimzer(module, builder);
-          auto curLatency = evaluate(module);
-          if (curLatency < minLatency) {
-            minLatency = curLatency;
-            saveBestModule(module);
+    }
+    if (!transferred.empty()) {
+      if (transferMode == TransferMode::Seed) {
+        for (auto& config : configs) {
+          if (std::find(transferred.begin(), transferred.end(), config) == transferred.end()) {
+            transferred.push_back(config);
           }
         }
       }
-    } else if (*opt == ElementWiseOptimizer()) {
-      for (auto& elementWiseConfig : elementWiseConfigs) {
-        ElementWiseOptimizer::elementWiseConfig = elementWiseConfig;
-        resetModule(module);
-        if (opt->applicable(module)) {
-          opt->applyOptimzer(module, builder);
-          auto curLatency = evaluate(module);
-          if (curLatency < minLatency) {
-            minLatency = curLatency;
-            saveBestModule(module);
-          }
+      configs = transferred;
+    }
+  }
+
+  // drop the configs which can't launch or starve the SMs before any IR is cloned.
+  auto feasible = ResourceFilter::filter(opt.name, configs, shape, device, minOccupancy);
+  if (feasible.size() != configs.size() && KCGLog::level == Log::Debug) {
+    llvm::errs() << "Rejected " << configs.size() - feasible.size() << " of " << configs.size()
+                 << " configs of " << shape.symbol << " by resources\n";
+  }
+  configs = std::move(feasible);
+  if (configs.empty()) return false;
+  // the filter keeps the order, the transferred configs which survived it are still in front.
+  int seeds = 0;
+  while (seeds < static_cast<int>(configs.size()) &&
+         std::find(transferred.begin(), transferred.end(), configs[seeds]) != transferred.end()) {
+    seeds++;
+  }
+
+  // the strategy decides which configs are measured, the closures keep the best module.
+  std::string bestText;
+  mlir::ModuleOp bestCandidate;
+  SearchStrategy::Measure measure;
+  int batchSize = 1;
+  // one pool serves every batch the strategy measures.
+  std::unique_ptr<llvm::ThreadPool> pool;
+  if (tuneThreads != 1) {
+    auto threads = llvm::hardware_concurrency(tuneThreads);
+    batchSize = threads.compute_thread_count();
+    pool = std::make_unique<llvm::ThreadPool>(threads);
+    measure = [&](const std::vector<std::map<std::string, int>>& batch) {
+      auto candidates = tuneParallel(opt, batch, module, *pool);
+      std::vector<float> latencies;
+      for (auto& candidate : candidates) {
+        latencies.push_back(candidate.valid ? candidate.latency : FLT_MAX);
+        if (candidate.valid && (winner.config.empty() || candidate.latency < winner.latency)) {
+          winner.config = candidate.config;
+          winner.latency = candidate.latency;
+          bestText = std::move(candidate.moduleText);
         }
       }
-    } else if (*opt == LayerNormOptimizer()) {
-      for (auto& layerNormConfig : layerNormConfigs) {
-        LayerNormOptimizer::layerNormConfig = layerNormConfig;
-        resetModule(module);
-        if (opt->applicable(module)) {
-          opt->applyOptimzer(module, builder);
-          auto curLatency = evaluate(module);
-          if (curLatency < minLatency) {
-            minLatency = curLatency;
-            saveBestModule(module);
-          }
+      return latencies;
+    };
+  } else {
+    backupModule(module);
+    measure = [&](const std::vector<std::map<std::string, int>>& batch) {
+      std::vector<float> latencies;
+      for (auto& config : batch) {
+        resetModule(module, bestCandidate);
+        if (!opt.setConfig(config) || !opt.applicable(module)) {
+          latencies.push_back(FLT_MAX);
+          continue;
         }
-      }
-    } else if (*opt == GatherOptimizer()) {
-      for (auto& gatherConfig : gatherConfigs) {
-        GatherOptimizer::gatherConfig = gatherConfig;
-        resetModule(module);
-        if (opt->applicable(module)) {
-          opt->applyOptimzer(module, builder);
-          // bestModule->dump();
-          auto curLatency = evaluate(module);
-          if (curLatency < minLatency) {
-            minLatency = curLatency;
-            saveBestModule(module);
-          }
+        opt.applyOptimzer(module, builder);
+        if (!acceptKernels(module, opt.targets)) {
+          latencies.push_back(FLT_MAX);
+          continue;
         }
-      }
-    } else if (*opt == BatchMatmulOptimizer()) {
-      for (auto& batchMatmulConfig : batchMatmulConfigs) {
-        BatchMatmulOptimizer::batchMatmulConfig = batchMatmulConfig;
-        resetModule(module);
-        if (opt->applicable(module)) {
-          opt->applyOptimzer(module, builder);
-          // bestModule->dump();
-          auto curLatency = evaluate(module);
-          if (curLatency < minLatency) {
-            minLatency = curLatency;
-            saveBestModule(module);
-          }
+        auto curLatency = evaluate(module);
+        latencies.push_back(curLatency);
+        if (winner.config.empty() || curLatency < winner.latency) {
+          winner.config = config;
+          winner.latency = curLatency;
+          if (bestCandidate && bestCandidate != module) bestCandidate->erase();
+          bestCandidate = module;
         }
       }
-    } else if (opt->applicable(module)) {
-      opt->applyOptimzer(module, builder);
-      auto curLatency = evaluate(module);
-      if (curLatency < minLatency) {
-        minLatency = curLatency;
-        saveBestModule(module);
+      return latencies;
+    };
+  }
+
+  auto strategy = std::shared_ptr<SearchStrategy>(createSearchStrategy(searchMethod));
+  {
+    std::lock_guard<std::mutex> lock(searchMutex);
+    activeSearch = strategy;
+  }
+  strategy->run(configs, measure, tuneBudget, batchSize, seeds);
+  {
+    std::lock_guard<std::mutex> lock(searchMutex);
+    activeSearch.reset();
+  }
+
+  if (winner.config.empty()) {
+    if (tuneThreads == 1) {
+      resetModule(module);
+      eraseBackup();
+    }
+    return false;
+  }
+  if (tuneThreads != 1) {
+    // merge the winner back into the context of the generator.
+    auto parsed = mlir::parseSourceString<mlir::ModuleOp>(bestText, &context);
+    if (!parsed) {
+      llvm::errs() << "Failed to merge the best candidate of " << shape.symbol << "\n";
+      return false;
+    }
+    module->erase();
+    module = parsed.release();
+  } else {
+    // the last candidate is dropped unless it won.
+    if (module != bestCandidate) module->erase();
+    module = bestCandidate;
+    eraseBackup();
+  }
+
+  if (database) database->record(key, winner);
+  return true;
+}
+
+uint64_t KernelCodeGenerator::configDigest() {
+  // llvm::hash_combine has no overloads for floating point, the budget and thresholds are hashed in thousandths.
+  // the whole profile is hashed, a calibrated profile keeps the name of the device it was fitted on.
+  llvm::hash_code digest = llvm::hash_combine(searchSpace, device.toJson(), static_cast<int>(searchMethod),
+    tuneBudget.maxCandidates, static_cast<int64_t>(tuneBudget.maxSeconds * 1000),
+    static_cast<int64_t>(minOccupancy * 1000), static_cast<int64_t>(maxBankConflict * 1000),
+    static_cast<int>(transferMode), transferTopK,
+    evaluator->digest(), database != nullptr);
+  for (auto& opt : opts) {
+    digest = llvm::hash_combine(digest, opt->name);
+    // the config of the instance, the only one of an untuned optimizer like CpuMatmul, and the keys the candidates
+    // leave out otherwise.
+    for (auto& item : opt->getConfig()) digest = llvm::hash_combine(digest, item.first, item.second);
+    auto configs = getConfigs(*opt);
+    if (configs == nullptr) continue;
+    for (auto& config : *configs) {
+      for (auto& item : config) digest = llvm::hash_combine(digest, item.first, item.second);
+    }
+  }
+  return digest;
+}
+
+mlir::ModuleOp& KernelCodeGenerator::optimize(ComputeDAG& graph_) {
+  graph = graph_;
+  mlir::Operation *cloned = graph.module->clone();
+  auto module = mlir::dyn_cast<mlir::ModuleOp>(cloned);
+  tunedFunctions.clear();
+  reusedFunctions.clear();
+
+  // the functions whose content and configs are unchanged take their optimized body from the cache.
+  std::map<std::string, uint64_t> hashes;
+  if (incremental) {
+    auto digest = configDigest();
+    std::vector<mlir::func::FuncOp> funcs(module.getOps<mlir::func::FuncOp>().begin(),
+                                          module.getOps<mlir::func::FuncOp>().end());
+    for (auto func : funcs) {
+      auto symbol = func.getSymName().str();
+      auto hash = static_cast<uint64_t>(llvm::hash_combine(Analyzer::hashFunction(func), digest));
+      auto iter = functionCache.find(hash);
+      if (iter == functionCache.end()) {
+        hashes[symbol] = hash;
+        continue;
+      }
+      mlir::OpBuilder funcBuilder(func);
+      funcBuilder.insert(iter->second.funcOp->clone());
+      func.erase();
+      reusedFunctions.insert(symbol);
+      if (iter->second.tuned) tunedFunctions[symbol] = iter->second.record;
+    }
+    if (KCGLog::level == Log::Debug) {
+      llvm::errs() << "Reused " << reusedFunctions.size() << " of " << funcs.size() << " functions\n";
+    }
+  }
+
+  for (auto& opt : opts) {
+    auto configs = getConfigs(*opt);
+    opt->targets.clear();
+    opt->reused = reusedFunctions;
+    if (configs == nullptr) {
+      if (opt->applicable(module)) {
+        opt->applyOptimzer(module, builder);
+      }
+      opt->reused.clear();
+      continue;
+    }
+
+    // every function is tuned alone and keeps its own winner in the module,
+    // so the final module is assembled from the per-function winners.
+    // the candidates overwrite the config of the instance, it is restored for configDigest afterwards.
+    auto own = opt->getConfig();
+    auto shapes = SearchSpace::collectShapes(*opt, module);
+    for (auto& shape : shapes) {
+      opt->targets = {shape.symbol};
+      opt->setConfig(own);
+      TuningRecord winner;
+      if (tuneFunction(*opt, shape, *configs, module, winner)) {
+        tunedFunctions[shape.symbol] = winner;
       }
     }
+    opt->setConfig(own);
+    opt->targets.clear();
+    opt->reused.clear();
   }
+
+  // functions removed by a fusion are not cached, their symbols are gone from the module.
+  for (auto& item : hashes) {
+    auto func = module.lookupSymbol<mlir::func::FuncOp>(item.first);
+    if (!func) continue;
+    auto& cached = functionCache[item.second];
+    cached.funcOp = func.clone();
+    auto tuned = tunedFunctions.find(item.first);
+    cached.tuned = tuned != tunedFunctions.end();
+    if (cached.tuned) cached.record = tuned->second;
+  }
+
+  minLatency = evaluate(module);
+  saveBestModule(module);
+  module->erase();
   return bestModule;
 }
-}
+}
\ No newline at end of file
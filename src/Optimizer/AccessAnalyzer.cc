@@ -0,0 +1,326 @@
+#include "Optimizer/AccessAnalyzer.h"
+#include "Optimizer/Analyzer.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace KernelCodeGen {
+
+namespace {
+
+int64_t floorDiv(int64_t x, int64_t y) {
+  return x / y - ((x % y != 0) && ((x < 0) != (y < 0)));
+}
+
+}
+
+bool AccessAnalyzer::evalExpr(mlir::AffineExpr expr, const std::vector<int64_t>& dims,
+                              const std::vector<int64_t>& symbols, int64_t& result) {
+  if (auto constExpr = expr.dyn_cast<mlir::AffineConstantExpr>()) {
+    result = constExpr.getValue();
+    return true;
+  }
+  if (auto dimExpr = expr.dyn_cast<mlir::AffineDimExpr>()) {
+    result = dims[dimExpr.getPosition()];
+    return true;
+  }
+  if (auto symbolExpr = expr.dyn_cast<mlir::AffineSymbolExpr>()) {
+    result = symbols[symbolExpr.getPosition()];
+    return true;
+  }
+  auto binaryExpr = expr.dyn_cast<mlir::AffineBinaryOpExpr>();
+  if (!binaryExpr) return false;
+  int64_t lhs, rhs;
+  if (!evalExpr(binaryExpr.getLHS(), dims, symbols, lhs) || !evalExpr(binaryExpr.getRHS(), dims, symbols, rhs)) {
+    return false;
+  }
+  switch (expr.getKind()) {
+    case mlir::AffineExprKind::Add: result = lhs + rhs; return true;
+    case mlir::AffineExprKind::Mul: result = lhs * rhs; return true;
+    case mlir::AffineExprKind::Mod: {
+      if (rhs == 0) return false;
+      result = ((lhs % rhs) + rhs) % rhs;
+      return true;
+    }
+    case mlir::AffineExprKind::FloorDiv: {
+      if (rhs == 0) return false;
+      result = floorDiv(lhs, rhs);
+      return true;
+    }
+    case mlir::AffineExprKind::CeilDiv: {
+      if (rhs == 0) return false;
+      result = -floorDiv(-lhs, rhs);
+      return true;
+    }
+    default: return false;
+  }
+}
+
+namespace {
+
+// the thread ivs of one lane, the other ivs are evaluated at their first iteration.
+using LaneIVs = llvm::DenseMap<mlir::Value, int64_t>;
+
+bool evalValue(mlir::Value value, const LaneIVs& ivs, int64_t& result);
+
+bool evalMap(mlir::AffineMap map, mlir::ValueRange operands, const LaneIVs& ivs, std::vector<int64_t>& results) {
+  std::vector<int64_t> dims, symbols;
+  for (int i = 0; i < operands.size(); i++) {
+    int64_t value;
+    if (!evalValue(operands[i], ivs, value)) return false;
+    if (i < map.getNumDims()) dims.push_back(value);
+    else symbols.push_back(value);
+  }
+  results.clear();
+  for (auto expr : map.getResults()) {
+    int64_t result;
+    if (!AccessAnalyzer::evalExpr(expr, dims, symbols, result)) return false;
+    results.push_back(result);
+  }
+  return true;
+}
+
+bool evalValue(mlir::Value value, const LaneIVs& ivs, int64_t& result) {
+  auto iter = ivs.find(value);
+  if (iter != ivs.end()) {
+    result = iter->second;
+    return true;
+  }
+  if (auto arg = value.dyn_cast<mlir::BlockArgument>()) {
+    auto parentOp = arg.getOwner()->getParentOp();
+    if (auto forOp = mlir::dyn_cast<mlir::AffineForOp>(parentOp)) {
+      result = forOp.hasConstantLowerBound() ? forOp.getConstantLowerBound() : 0;
+      return true;
+    }
+    // the ivs of the grid level, the first block.
+    if (mlir::isa<mlir::AffineParallelOp>(parentOp)) {
+      result = 0;
+      return true;
+    }
+    return false;
+  }
+  if (auto constOp = value.getDefiningOp<mlir::arith::ConstantIndexOp>()) {
+    result = constOp.value();
+    return true;
+  }
+  if (auto applyOp = value.getDefiningOp<mlir::AffineApplyOp>()) {
+    std::vector<int64_t> results;
+    if (!evalMap(applyOp.getAffineMap(), applyOp.getMapOperands(), ivs, results)) return false;
+    result = results[0];
+    return true;
+  }
+  return false;
+}
+
+}
+
+bool AccessAnalyzer::getAccessOperands(mlir::Operation* op, AccessOperands& access) {
+  auto set = [&](mlir::Value memref, mlir::AffineMap map, mlir::ValueRange operands, mlir::Type valueType,
+                 bool isStore) {
+    access.memref = memref;
+    access.map = map;
+    access.operands.assign(operands.begin(), operands.end());
+    access.valueType = valueType;
+    access.isStore = isStore;
+  };
+  auto identity = [&](mlir::ValueRange indices) {
+    return mlir::AffineMap::getMultiDimIdentityMap(indices.size(), op->getContext());
+  };
+  if (auto loadOp = mlir::dyn_cast<mlir::AffineLoadOp>(op)) {
+    set(loadOp.getMemRef(), loadOp.getAffineMap(), loadOp.getMapOperands(), loadOp.getResult().getType(), false);
+  } else if (auto storeOp = mlir::dyn_cast<mlir::AffineStoreOp>(op)) {
+    set(storeOp.getMemRef(), storeOp.getAffineMap(), storeOp.getMapOperands(), storeOp.getValueToStore().getType(), true);
+  } else if (auto loadOp = mlir::dyn_cast<mlir::AffineVectorLoadOp>(op)) {
+    set(loadOp.getMemRef(), loadOp.getAffineMap(), loadOp.getMapOperands(), loadOp.getResult().getType(), false);
+  } else if (auto storeOp = mlir::dyn_cast<mlir::AffineVectorStoreOp>(op)) {
+    set(storeOp.getMemRef(), storeOp.getAffineMap(), storeOp.getMapOperands(), storeOp.getValueToStore().getType(), true);
+  } else if (auto loadOp = mlir::dyn_cast<mlir::memref::LoadOp>(op)) {
+    set(loadOp.getMemRef(), identity(loadOp.getIndices()), loadOp.getIndices(), loadOp.getResult().getType(), false);
+  } else if (auto storeOp = mlir::dyn_cast<mlir::memref::StoreOp>(op)) {
+    set(storeOp.getMemRef(), identity(storeOp.getIndices()), storeOp.getIndices(),
+        storeOp.getValueToStore().getType(), true);
+  } else {
+    return false;
+  }
+  return access.memref.getType().isa<mlir::MemRefType>();
+}
+
+std::vector<WarpAccess> AccessAnalyzer::collectAccesses(mlir::AffineParallelOp gridLevel, int64_t warpSize) {
+  mlir::AffineParallelOp blockLevel;
+  gridLevel.getBody()->walk<mlir::WalkOrder::PreOrder>([&](mlir::AffineParallelOp parallelOp) {
+    if (!blockLevel) blockLevel = parallelOp;
+  });
+
+  // threadIdx of every lane of the first warp, the last iv is threadIdx.x.
+  std::vector<LaneIVs> lanes(1);
+  if (blockLevel && blockLevel.getConstantRanges()) {
+    auto ranges = *blockLevel.getConstantRanges();
+    auto ivs = blockLevel.getIVs();
+    int64_t threads = 1;
+    for (auto range : ranges) threads *= range;
+    lanes.assign(std::min(warpSize, threads), LaneIVs());
+    for (int64_t lane = 0; lane < lanes.size(); lane++) {
+      auto rest = lane;
+      for (int i = ranges.size() - 1; i >= 0; i--) {
+        lanes[lane][ivs[i]] = rest % ranges[i];
+        rest /= ranges[i];
+      }
+    }
+  }
+
+  std::vector<WarpAccess> result;
+  gridLevel.walk<mlir::WalkOrder::PreOrder>([&](mlir::Operation* op) {
+    AccessOperands operands;
+    if (!getAccessOperands(op, operands)) return;
+    auto type = operands.memref.getType().cast<mlir::MemRefType>();
+
+    WarpAccess access;
+    access.op = op;
+    access.space = static_cast<MemorySpace>(type.getMemorySpaceAsInt());
+    access.isStore = operands.isStore;
+    access.bytesPerLane = Analyzer::getTypeBytes(operands.valueType);
+    for (auto parent = op->getParentOp(); parent && parent != gridLevel; parent = parent->getParentOp()) {
+      if (auto forOp = mlir::dyn_cast<mlir::AffineForOp>(parent)) access.times *= Analyzer::getTripCount(forOp);
+    }
+
+    llvm::SmallVector<int64_t> strides;
+    int64_t offset;
+    if (mlir::failed(mlir::getStridesAndOffset(type, strides, offset)) ||
+        llvm::any_of(strides, [](int64_t stride) { return mlir::ShapedType::isDynamicStrideOrOffset(stride); })) {
+      access.analyzable = false;
+    }
+    auto elementBytes = Analyzer::getTypeBytes(type.getElementType());
+    for (int i = 0; i < lanes.size() && access.analyzable; i++) {
+      std::vector<int64_t> indices;
+      if (!evalMap(operands.map, operands.operands, lanes[i], indices) || indices.size() != strides.size()) {
+        access.analyzable = false;
+        break;
+      }
+      int64_t element = 0;
+      for (int d = 0; d < indices.size(); d++) element += indices[d] * strides[d];
+      access.addresses.push_back(element * elementBytes);
+    }
+    if (!access.analyzable) access.addresses.clear();
+    result.push_back(std::move(access));
+  });
+  return std::move(result);
+}
+
+BankConflict AccessAnalyzer::bankConflict(const WarpAccess& access, int64_t banks, int64_t bankBytes) {
+  BankConflict result;
+  result.op = access.op;
+  result.times = access.times;
+  if (!access.analyzable || access.addresses.empty()) return result;
+
+  auto lanesPerPhase = std::max<int64_t>(1, banks * bankBytes / std::max(access.bytesPerLane, bankBytes));
+  result.wavefronts = 0;
+  result.idealWavefronts = 0;
+  for (int64_t start = 0; start < access.addresses.size(); start += lanesPerPhase) {
+    auto end = std::min<int64_t>(access.addresses.size(), start + lanesPerPhase);
+    // distinct words per bank, the lanes reading the same word are served together.
+    std::map<int64_t, std::set<int64_t>> words;
+    for (auto lane = start; lane < end; lane++) {
+      auto first = floorDiv(access.addresses[lane], bankBytes);
+      auto last = floorDiv(access.addresses[lane] + access.bytesPerLane - 1, bankBytes);
+      for (auto word = first; word <= last; word++) words[((word % banks) + banks) % banks].insert(word);
+    }
+    int64_t wavefronts = 1;
+    for (auto& item : words) wavefronts = std::max<int64_t>(wavefronts, item.second.size());
+    result.wavefronts += wavefronts;
+    result.idealWavefronts += 1;
+  }
+  return result;
+}
+
+std::vector<BankConflict> AccessAnalyzer::bankConflicts(mlir::AffineParallelOp gridLevel, int64_t warpSize) {
+  std::vector<BankConflict> result;
+  for (auto& access : collectAccesses(gridLevel, warpSize)) {
+    if (access.space != MemorySpace::shared) continue;
+    result.push_back(bankConflict(access));
+  }
+  return std::move(result);
+}
+
+double AccessAnalyzer::bankConflictDegree(const std::vector<BankConflict>& conflicts) {
+  double wavefronts = 0.0, ideal = 0.0;
+  for (auto& conflict : conflicts) {
+    wavefronts += conflict.wavefronts * conflict.times;
+    ideal += conflict.idealWavefronts * conflict.times;
+  }
+  return ideal > 0.0 ? wavefronts / ideal : 1.0;
+}
+
+Coalescing AccessAnalyzer::coalescing(const WarpAccess& access) {
+  Coalescing result;
+  result.op = access.op;
+  result.times = access.times;
+  if (!access.analyzable || access.addresses.empty()) return result;
+
+  std::set<int64_t> sectors, segments64, segments128;
+  std::vector<std::pair<int64_t, int64_t>> ranges;
+  for (auto address : access.addresses) {
+    auto last = address + access.bytesPerLane - 1;
+    for (auto sector = floorDiv(address, 32); sector <= floorDiv(last, 32); sector++) sectors.insert(sector);
+    for (auto segment = floorDiv(address, 64); segment <= floorDiv(last, 64); segment++) segments64.insert(segment);
+    for (auto segment = floorDiv(address, 128); segment <= floorDiv(last, 128); segment++) segments128.insert(segment);
+    ranges.push_back({address, last + 1});
+  }
+  // lanes reading the same bytes count once.
+  std::sort(ranges.begin(), ranges.end());
+  int64_t end = ranges[0].first;
+  for (auto& range : ranges) {
+    auto start = std::max(range.first, end);
+    if (range.second > start) result.usefulBytes += range.second - start;
+    end = std::max(end, range.second);
+  }
+  result.sectors = sectors.size();
+  result.segments64 = segments64.size();
+  result.segments128 = segments128.size();
+  return result;
+}
+
+std::vector<Coalescing> AccessAnalyzer::coalescings(mlir::AffineParallelOp gridLevel, int64_t warpSize) {
+  std::vector<Coalescing> result;
+  for (auto& access : collectAccesses(gridLevel, warpSize)) {
+    if (access.space != MemorySpace::global || !access.analyzable) continue;
+    result.push_back(coalescing(access));
+  }
+  return std::move(result);
+}
+
+double AccessAnalyzer::sectorEfficiency(const std::vector<Coalescing>& coalescings) {
+  double useful = 0.0, transferred = 0.0;
+  for (auto& coalescing : coalescings) {
+    useful += coalescing.usefulBytes * coalescing.times;
+    transferred += coalescing.sectors * 32 * coalescing.times;
+  }
+  return transferred > 0.0 ? useful / transferred : 1.0;
+}
+
+void AccessAnalyzer::dump(mlir::AffineParallelOp gridLevel, llvm::raw_ostream& os, int64_t warpSize) {
+  for (auto& access : collectAccesses(gridLevel, warpSize)) {
+    os << access.op->getName() << (access.space == MemorySpace::shared ? " shared " : " global ")
+       << access.bytesPerLane << "B x" << access.times;
+    if (!access.analyzable) {
+      os << ": not affine in the ivs\n";
+    } else if (access.space == MemorySpace::shared) {
+      auto conflict = bankConflict(access);
+      os << ": " << conflict.wavefronts << " wavefronts, degree " << conflict.degree() << "\n";
+    } else if (access.space == MemorySpace::global) {
+      auto result = coalescing(access);
+      os << ": " << result.sectors << " sectors, " << result.segments128 << " x 128B, efficiency "
+         << result.efficiency() << "\n";
+    } else {
+      os << "\n";
+    }
+  }
+  auto conflicts = bankConflicts(gridLevel, warpSize);
+  auto transactions = coalescings(gridLevel, warpSize);
+  os << "bank conflict degree " << bankConflictDegree(conflicts) << ", sector efficiency "
+     << sectorEfficiency(transactions) << "\n";
+}
+
+}
@@ -1,5 +1,7 @@
 #include "Optimizer/Analyzer.h"
 
+#include <algorithm>
+
 struct ConstPassGuard {
   ConstPassGuard() { visitor = 0;}
   ~ConstPassGuard() { visitor = 1;}
@@ -47,6 +49,142 @@ int Analyzer::getUsersNumber(mlir::Value::user_range users) {
   return count;
 }
 
+int64_t Analyzer::getTripCount(mlir::AffineForOp forOp) {
+  int64_t step = forOp.getStep();
+  if (forOp.hasConstantBounds()) {
+    auto lb = forOp.getConstantLowerBound(), ub = forOp.getConstantUpperBound();
+    return std::max<int64_t>(0, (ub - lb + step - 1) / step);
+  }
+  // min(tile, N - iv) like bounds of the tails, take the tile.
+  bool found = false;
+  int64_t ub = 0;
+  for (auto expr : forOp.getUpperBoundMap().getResults()) {
+    if (auto constExpr = expr.dyn_cast<mlir::AffineConstantExpr>()) {
+      ub = found ? std::min(ub, constExpr.getValue()) : constExpr.getValue();
+      found = true;
+    }
+  }
+  if (!found) return 1;
+  int64_t lb = forOp.hasConstantLowerBound() ? forOp.getConstantLowerBound() : 0;
+  return std::max<int64_t>(1, (ub - lb + step - 1) / step);
+}
+
+int64_t Analyzer::getTypeBytes(mlir::Type type) {
+  auto element = mlir::getElementTypeOrSelf(type);
+  int64_t bytes = 4;
+  if (element.isIntOrFloat()) bytes = std::max<int64_t>(1, element.getIntOrFloatBitWidth() / 8);
+  else if (element.isIndex()) bytes = 8;
+  if (auto vectorType = type.dyn_cast<mlir::VectorType>()) bytes *= vectorType.getNumElements();
+  return bytes;
+}
+
+uint64_t Analyzer::hashFunction(mlir::func::FuncOp funcOp) {
+  std::string text;
+  llvm::raw_string_ostream os(text);
+  // the generic form is stable across the custom printers of the dialects.
+  funcOp->print(os, mlir::OpPrintingFlags().printGenericOpForm());
+  os.flush();
+  return llvm::hash_combine(funcOp.getSymName(), text);
+}
+
+RegisterUsage Analyzer::estimateRegisters(mlir::AffineParallelOp gridLevel) {
+  auto words = [](mlir::Type type) {
+    return (getTypeBytes(type) + 3) / 4;
+  };
+  RegisterUsage usage;
+  gridLevel.walk([&](mlir::memref::AllocOp allocOp) {
+    auto type = allocOp.getType();
+    if (type.getMemorySpaceAsInt() != static_cast<int>(MemorySpace::local) || !type.hasStaticShape()) return;
+    usage.arrays += type.getNumElements() * words(type.getElementType());
+  });
+  gridLevel.walk([&](mlir::AffineForOp forOp) {
+    auto attr = forOp->getAttrOfType<mlir::StringAttr>(std::string("affine.loop"));
+    if (!attr || attr.getValue() != "unroll") return;
+    int64_t body = 0;
+    for (auto& op : forOp.getBody()->getOperations()) {
+      if (mlir::isa<mlir::AffineForOp>(op)) continue;
+      for (auto result : op.getResults()) {
+        if (mlir::getElementTypeOrSelf(result.getType()).isa<mlir::FloatType>()) body += words(result.getType());
+      }
+    }
+    usage.temporaries = std::max(usage.temporaries, body * getTripCount(forOp));
+  });
+  return usage;
+}
+
+int64_t Analyzer::getSharedBytes(mlir::AffineParallelOp gridLevel) {
+  int64_t bytes = 0;
+  gridLevel.walk([&](mlir::memref::AllocOp allocOp) {
+    auto type = allocOp.getType();
+    if (type.getMemorySpaceAsInt() != static_cast<int>(MemorySpace::shared) || !type.hasStaticShape()) return;
+    bytes += type.getNumElements() * getTypeBytes(type.getElementType());
+  });
+  return bytes;
+}
+
+int64_t Analyzer::getBlocksPerSM(int64_t threads, int64_t registers, int64_t sharedBytes,
+                                 const DeviceProfile& device) {
+  if (threads <= 0) return 0;
+  auto ceilDiv = [](int64_t x, int64_t y) { return (x + y - 1) / y; };
+  auto warps = ceilDiv(threads, device.warpSize);
+  auto blocks = std::min(device.maxBlocksPerSM, device.maxWarpsPerSM / warps);
+
+  auto registersPerWarp = ceilDiv(registers * device.warpSize, device.registerAllocUnit) * device.registerAllocUnit;
+  if (registersPerWarp > 0) blocks = std::min(blocks, device.registersPerSM / (registersPerWarp * warps));
+
+  auto sharedPerBlock = ceilDiv(sharedBytes + device.reservedSharedMemPerBlock, device.sharedAllocUnit) *
+                        device.sharedAllocUnit;
+  if (sharedPerBlock > 0) blocks = std::min(blocks, device.sharedMemPerSM / sharedPerBlock);
+  return std::max<int64_t>(0, blocks);
+}
+
+Occupancy Analyzer::getOccupancy(int64_t blocks, int64_t threads, int64_t registers, int64_t sharedBytes,
+                                 const DeviceProfile& device) {
+  Occupancy result;
+  result.blocks = blocks;
+  result.threads = threads;
+  result.warps = (threads + device.warpSize - 1) / device.warpSize;
+  result.registers = registers;
+  result.sharedBytes = sharedBytes;
+  result.blocksPerSM = getBlocksPerSM(threads, registers, sharedBytes, device);
+  result.activeWarps = result.blocksPerSM * result.warps;
+  result.occupancy = 1.0 * result.activeWarps / device.maxWarpsPerSM;
+
+  // the resource which alone gives the fewest blocks.
+  if (threads > 0) {
+    std::vector<std::pair<std::string, int64_t>> limits = {
+      {"warps", device.maxWarpsPerSM / result.warps},
+      {"blocks", device.maxBlocksPerSM},
+      {"registers", getBlocksPerSM(threads, registers, 0, device)},
+      {"shared memory", getBlocksPerSM(threads, 0, sharedBytes, device)}
+    };
+    for (auto& limit : limits) {
+      if (limit.second <= result.blocksPerSM) {
+        result.limiter = limit.first;
+        break;
+      }
+    }
+  }
+
+  auto slots = result.blocksPerSM * device.smCount;
+  if (slots > 0 && blocks > 0) {
+    result.waves = (blocks + slots - 1) / slots;
+    result.tailEfficiency = 1.0 * blocks / (result.waves * slots);
+  }
+  return result;
+}
+
+Occupancy Analyzer::getOccupancy(mlir::AffineParallelOp gridLevel, const DeviceProfile& device) {
+  int64_t blocks = 1, threads = 1;
+  getParallelNumber(gridLevel, blocks);
+  bool found = false;
+  gridLevel.getBody()->walk<mlir::WalkOrder::PreOrder>([&](mlir::AffineParallelOp blockLevel) {
+    if (found) return;
+    getParallelNumber(blockLevel, threads);
+    found = true;
+  });
+  return getOccupancy(blocks, threads, estimateRegisters(gridLevel).total(), getSharedBytes(gridLevel), device);
+}
 
 std::vector<mlir::AffineForOp> Analyzer::collectOutermostLoop(mlir::ModuleOp& module) {
   ConstPassGuard constPassGuard;
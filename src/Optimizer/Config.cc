@@ -0,0 +1,130 @@
+#include "Optimizer/Config.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Host.h"
+
+namespace KernelCodeGen {
+
+namespace {
+
+bool divisible(int x, int y) {
+  return y > 0 && x % y == 0;
+}
+
+}
+
+const std::vector<ConfigField<MatmulConfig>>& MatmulConfig::fields() {
+  static const std::vector<ConfigField<MatmulConfig>> result = {
+    {"BLOCK_SIZE_M", &MatmulConfig::BLOCK_SIZE_M, true}, {"BLOCK_SIZE_N", &MatmulConfig::BLOCK_SIZE_N, true},
+    {"BLOCK_SIZE_K", &MatmulConfig::BLOCK_SIZE_K, true}, {"GROUP_SIZE_M", &MatmulConfig::GROUP_SIZE_M, false},
+    {"THREAD_SIZE_M", &MatmulConfig::THREAD_SIZE_M, true}, {"THREAD_SIZE_N", &MatmulConfig::THREAD_SIZE_N, true},
+    {"VECTORIZE_WIDTH", &MatmulConfig::VECTORIZE_WIDTH, true}, {"WARP_SIZE", &MatmulConfig::WARP_SIZE, true}
+  };
+  return result;
+}
+
+bool MatmulConfig::validate() const {
+  if (BLOCK_SIZE_K <= 0 || GROUP_SIZE_M <= 0) return false;
+  if (!divisible(BLOCK_SIZE_M, THREAD_SIZE_M) || !divisible(BLOCK_SIZE_N, THREAD_SIZE_N)) return false;
+  if (!divisible(THREAD_SIZE_M, VECTORIZE_WIDTH) || !divisible(THREAD_SIZE_N, VECTORIZE_WIDTH)) return false;
+  auto threads = (BLOCK_SIZE_M / THREAD_SIZE_M) * (BLOCK_SIZE_N / THREAD_SIZE_N);
+  return divisible(threads, WARP_SIZE);
+}
+
+const std::vector<ConfigField<ElementWiseConfig>>& ElementWiseConfig::fields() {
+  static const std::vector<ConfigField<ElementWiseConfig>> result = {
+    {"BLOCK_SIZE_M", &ElementWiseConfig::BLOCK_SIZE_M, true}, {"BLOCK_SIZE_N", &ElementWiseConfig::BLOCK_SIZE_N, false},
+    {"THREAD_SIZE_M", &ElementWiseConfig::THREAD_SIZE_M, true}, {"THREAD_SIZE_N", &ElementWiseConfig::THREAD_SIZE_N, true},
+    {"VECTORIZE_WIDTH", &ElementWiseConfig::VECTORIZE_WIDTH, true}
+  };
+  return result;
+}
+
+bool ElementWiseConfig::validate() const {
+  return divisible(BLOCK_SIZE_M, THREAD_SIZE_M) && divisible(BLOCK_SIZE_N, THREAD_SIZE_N) &&
+         divisible(THREAD_SIZE_N, VECTORIZE_WIDTH);
+}
+
+const std::vector<ConfigField<LayerNormConfig>>& LayerNormConfig::fields() {
+  static const std::vector<ConfigField<LayerNormConfig>> result = {
+    {"BLOCK_SIZE", &LayerNormConfig::BLOCK_SIZE, true}, {"THREAD_SIZE", &LayerNormConfig::THREAD_SIZE, true},
+    {"VECTORIZE_WIDTH", &LayerNormConfig::VECTORIZE_WIDTH, true}
+  };
+  return result;
+}
+
+bool LayerNormConfig::validate() const {
+  return divisible(BLOCK_SIZE, THREAD_SIZE) && divisible(THREAD_SIZE, VECTORIZE_WIDTH);
+}
+
+const std::vector<ConfigField<FMHAConfig>>& FMHAConfig::fields() {
+  static const std::vector<ConfigField<FMHAConfig>> result = {
+    {"BLOCK_SIZE", &FMHAConfig::BLOCK_SIZE, true}, {"HdxBr", &FMHAConfig::HdxBr, true},
+    {"BrxBc", &FMHAConfig::BrxBc, true}, {"WarpX_O", &FMHAConfig::WarpX_O, true},
+    {"Slice", &FMHAConfig::Slice, true}, {"BrTileS", &FMHAConfig::BrTileS, true},
+    {"BcTileS", &FMHAConfig::BcTileS, true}, {"BrTileO", &FMHAConfig::BrTileO, true},
+    {"HdTileO", &FMHAConfig::HdTileO, true}, {"Width", &FMHAConfig::Width, true},
+    {"WARP_SIZE", &FMHAConfig::WARP_SIZE, true}
+  };
+  return result;
+}
+
+bool FMHAConfig::validate() const {
+  if (HdxBr <= 0 || BrxBc <= 0 || BrTileS <= 0 || BcTileS <= 0 || BrTileO <= 0 || HdTileO <= 0) return false;
+  return divisible(BLOCK_SIZE, WARP_SIZE) && divisible(BLOCK_SIZE / WARP_SIZE, WarpX_O) && divisible(Slice, Width);
+}
+
+const std::vector<ConfigField<BatchMatmulConfig>>& BatchMatmulConfig::fields() {
+  static const std::vector<ConfigField<BatchMatmulConfig>> result = {
+    {"BLOCK_SIZE_M", &BatchMatmulConfig::BLOCK_SIZE_M, true}, {"BLOCK_SIZE_N", &BatchMatmulConfig::BLOCK_SIZE_N, true},
+    {"BLOCK_SIZE_K", &BatchMatmulConfig::BLOCK_SIZE_K, true}, {"THREAD_SIZE_M", &BatchMatmulConfig::THREAD_SIZE_M, true},
+    {"THREAD_SIZE_N", &BatchMatmulConfig::THREAD_SIZE_N, true},
+    {"VECTORIZE_WIDTH", &BatchMatmulConfig::VECTORIZE_WIDTH, true}, {"WARP_SIZE", &BatchMatmulConfig::WARP_SIZE, true}
+  };
+  return result;
+}
+
+bool BatchMatmulConfig::validate() const {
+  if (BLOCK_SIZE_K <= 0) return false;
+  if (!divisible(BLOCK_SIZE_M, THREAD_SIZE_M) || !divisible(BLOCK_SIZE_N, THREAD_SIZE_N)) return false;
+  if (!divisible(THREAD_SIZE_M, VECTORIZE_WIDTH) || !divisible(THREAD_SIZE_N, VECTORIZE_WIDTH)) return false;
+  auto threads = (BLOCK_SIZE_M / THREAD_SIZE_M) * (BLOCK_SIZE_N / THREAD_SIZE_N);
+  return divisible(threads, WARP_SIZE);
+}
+
+const std::vector<ConfigField<CpuMatmulConfig>>& CpuMatmulConfig::fields() {
+  static const std::vector<ConfigField<CpuMatmulConfig>> result = {
+    {"MC", &CpuMatmulConfig::MC, true}, {"NC", &CpuMatmulConfig::NC, true}, {"KC", &CpuMatmulConfig::KC, true},
+    {"MR", &CpuMatmulConfig::MR, true}, {"NR", &CpuMatmulConfig::NR, true},
+    {"VECTORIZE_WIDTH", &CpuMatmulConfig::VECTORIZE_WIDTH, true}, {"UNROLL_K", &CpuMatmulConfig::UNROLL_K, false}
+  };
+  return result;
+}
+
+bool CpuMatmulConfig::validate() const {
+  if (KC <= 0 || UNROLL_K <= 0) return false;
+  return divisible(MC, MR) && divisible(NC, NR) && divisible(NR, VECTORIZE_WIDTH);
+}
+
+CpuMatmulConfig CpuMatmulConfig::avx2() {
+  return CpuMatmulConfig();
+}
+
+CpuMatmulConfig CpuMatmulConfig::avx512() {
+  CpuMatmulConfig config;
+  config.MC = 168;
+  config.NC = 3072;
+  config.KC = 256;
+  config.MR = 14;
+  config.NR = 32;
+  config.VECTORIZE_WIDTH = 16;
+  return config;
+}
+
+CpuMatmulConfig CpuMatmulConfig::host() {
+  llvm::StringMap<bool> features;
+  if (llvm::sys::getHostCPUFeatures(features) && features.lookup("avx512f")) return avx512();
+  return avx2();
+}
+
+}
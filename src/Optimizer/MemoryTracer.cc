@@ -0,0 +1,428 @@
+#include "Optimizer/MemoryTracer.h"
+#include "Optimizer/Analyzer.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <set>
+
+namespace KernelCodeGen {
+
+namespace {
+
+// an integer value of every lane of a warp, a single value is shared by all lanes.
+struct Lanes {
+  std::vector<int64_t> values;
+
+  int64_t at(int64_t lane) const {
+    return values.size() == 1 ? values[0] : values[lane];
+  }
+};
+
+int64_t floorDiv(int64_t x, int64_t y) {
+  return x / y - ((x % y != 0) && ((x < 0) != (y < 0)));
+}
+
+class Tracer {
+public:
+  Tracer(TraceStats& stats_, int64_t warpSize_, int64_t maxRequests_)
+    : stats(stats_), warpSize(warpSize_), maxRequests(maxRequests_) {}
+
+  void traceBlock(mlir::AffineParallelOp gridLevel, int64_t block) {
+    env.clear();
+    setWarp(1);
+    setIVs(gridLevel, block);
+    run(*gridLevel.getBody());
+    stats.tracedBlocks += 1;
+  }
+
+private:
+  void setWarp(int64_t lanes_) {
+    lanes = lanes_;
+    mask.assign(lanes, true);
+  }
+
+  // decode a linear id into the ivs of a parallel op, the last iv is the fastest.
+  bool setIVs(mlir::AffineParallelOp parallelOp, int64_t id, int64_t lane = 0, Lanes* laneIVs = nullptr) {
+    auto ranges = parallelOp.getConstantRanges();
+    if (!ranges) return false;
+    auto ivs = parallelOp.getIVs();
+    auto steps = parallelOp.getSteps();
+    for (int i = ranges->size() - 1; i >= 0; i--) {
+      auto range = (*ranges)[i];
+      int64_t lower = 0;
+      auto lowerMap = parallelOp.getLowerBoundMap(i);
+      if (lowerMap.getNumResults() == 1) {
+        if (auto constExpr = lowerMap.getResult(0).dyn_cast<mlir::AffineConstantExpr>()) lower = constExpr.getValue();
+      }
+      auto value = lower + (id % range) * steps[i];
+      id /= range;
+      if (laneIVs) laneIVs[i].values[lane] = value;
+      else env[ivs[i]] = Lanes{{value}};
+    }
+    return true;
+  }
+
+  bool lookup(mlir::Value value, Lanes& result) {
+    auto iter = env.find(value);
+    if (iter != env.end()) {
+      result = iter->second;
+      return true;
+    }
+    if (auto constOp = value.getDefiningOp<mlir::arith::ConstantOp>()) {
+      if (auto attr = constOp.getValue().dyn_cast<mlir::IntegerAttr>()) {
+        result = Lanes{{attr.getValue().getSExtValue()}};
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool lookup(mlir::ValueRange values, std::vector<Lanes>& result) {
+    result.resize(values.size());
+    for (int i = 0; i < values.size(); i++) {
+      if (!lookup(values[i], result[i])) return false;
+    }
+    return true;
+  }
+
+  // the results of the map for every active lane.
+  bool evalMap(mlir::AffineMap map, mlir::ValueRange operands, std::vector<Lanes>& results) {
+    std::vector<Lanes> inputs;
+    if (!lookup(operands, inputs)) return false;
+    results.assign(map.getNumResults(), Lanes{std::vector<int64_t>(lanes, 0)});
+    std::vector<int64_t> dims(map.getNumDims()), symbols(map.getNumSymbols());
+    for (int64_t lane = 0; lane < lanes; lane++) {
+      if (!mask[lane]) continue;
+      for (int i = 0; i < inputs.size(); i++) {
+        if (i < dims.size()) dims[i] = inputs[i].at(lane);
+        else symbols[i - dims.size()] = inputs[i].at(lane);
+      }
+      for (int r = 0; r < map.getNumResults(); r++) {
+        if (!AccessAnalyzer::evalExpr(map.getResult(r), dims, symbols, results[r].values[lane])) return false;
+      }
+    }
+    return true;
+  }
+
+  // max of the lower bound results and min of the upper bound results of every lane.
+  bool evalBound(mlir::AffineMap map, mlir::ValueRange operands, bool lower, Lanes& result) {
+    std::vector<Lanes> results;
+    if (!evalMap(map, operands, results) || results.empty()) return false;
+    result = results[0];
+    for (int r = 1; r < results.size(); r++) {
+      for (int64_t lane = 0; lane < lanes; lane++) {
+        auto value = results[r].values[lane];
+        result.values[lane] = lower ? std::max(result.values[lane], value) : std::min(result.values[lane], value);
+      }
+    }
+    return true;
+  }
+
+  // runs the body for every iteration any active lane takes, the other lanes are masked off.
+  void loop(mlir::Value iv, const Lanes& lower, const Lanes& upper, int64_t step, mlir::Block& body) {
+    if (step <= 0) return;
+    int64_t first = INT64_MAX, last = INT64_MIN;
+    for (int64_t lane = 0; lane < lanes; lane++) {
+      if (!mask[lane]) continue;
+      first = std::min(first, lower.at(lane));
+      last = std::max(last, upper.at(lane));
+    }
+    auto saved = mask;
+    for (auto value = first; value < last && !stopped; value += step) {
+      bool any = false;
+      for (int64_t lane = 0; lane < lanes; lane++) {
+        auto low = lower.at(lane);
+        mask[lane] = saved[lane] && value >= low && value < upper.at(lane) && (value - low) % step == 0;
+        any |= mask[lane];
+      }
+      if (!any) continue;
+      env[iv] = Lanes{{value}};
+      run(body);
+    }
+    mask = saved;
+  }
+
+  // runs the block for the lanes where the condition holds.
+  void branch(const std::vector<bool>& condition, mlir::Block* block) {
+    if (block == nullptr) return;
+    auto saved = mask;
+    bool any = false;
+    for (int64_t lane = 0; lane < lanes; lane++) {
+      mask[lane] = saved[lane] && condition[lane];
+      any |= mask[lane];
+    }
+    if (any) run(*block);
+    mask = saved;
+  }
+
+  void runThreads(mlir::AffineParallelOp blockLevel) {
+    auto ranges = blockLevel.getConstantRanges();
+    if (!ranges) return;
+    int64_t threads = 1;
+    for (auto range : *ranges) threads *= range;
+    auto ivs = blockLevel.getIVs();
+    auto outside = env;
+    for (int64_t start = 0; start < threads && !stopped; start += warpSize) {
+      setWarp(std::min(warpSize, threads - start));
+      std::vector<Lanes> laneIVs(ivs.size(), Lanes{std::vector<int64_t>(lanes, 0)});
+      for (int64_t lane = 0; lane < lanes; lane++) setIVs(blockLevel, start + lane, lane, laneIVs.data());
+      for (int i = 0; i < ivs.size(); i++) env[ivs[i]] = laneIVs[i];
+      run(*blockLevel.getBody());
+      stats.tracedWarps += 1;
+      env = outside;
+    }
+    setWarp(1);
+  }
+
+  void record(mlir::Operation* op, const AccessOperands& operands) {
+    auto type = operands.memref.getType().cast<mlir::MemRefType>();
+    auto space = static_cast<MemorySpace>(type.getMemorySpaceAsInt());
+    if (space != MemorySpace::global && space != MemorySpace::shared) return;
+    if (stats.globalRequests + stats.sharedRequests >= maxRequests) {
+      stats.truncated = stopped = true;
+      return;
+    }
+
+    llvm::SmallVector<int64_t> strides;
+    int64_t offset;
+    std::vector<Lanes> indices;
+    if (mlir::failed(mlir::getStridesAndOffset(type, strides, offset)) ||
+        llvm::any_of(strides, [](int64_t stride) { return mlir::ShapedType::isDynamicStrideOrOffset(stride); }) ||
+        !evalMap(operands.map, operands.operands, indices) || indices.size() != strides.size()) {
+      stats.unresolved += 1;
+      return;
+    }
+    WarpAccess access;
+    access.op = op;
+    access.space = space;
+    access.isStore = operands.isStore;
+    access.bytesPerLane = Analyzer::getTypeBytes(operands.valueType);
+    auto elementBytes = Analyzer::getTypeBytes(type.getElementType());
+    for (int64_t lane = 0; lane < lanes; lane++) {
+      if (!mask[lane]) continue;
+      int64_t element = 0;
+      for (int d = 0; d < strides.size(); d++) element += indices[d].values[lane] * strides[d];
+      access.addresses.push_back(element * elementBytes);
+    }
+    if (access.addresses.empty()) return;
+
+    auto iter = accessIndex.find(op);
+    if (iter == accessIndex.end()) {
+      iter = accessIndex.insert({op, stats.accesses.size()}).first;
+      stats.accesses.push_back(TracedAccess());
+      stats.accesses.back().op = op;
+      stats.accesses.back().space = space;
+    }
+    auto& traced = stats.accesses[iter->second];
+    traced.requests += 1;
+    if (space == MemorySpace::shared) {
+      auto conflict = AccessAnalyzer::bankConflict(access);
+      traced.wavefronts += conflict.wavefronts;
+      traced.idealWavefronts += conflict.idealWavefronts;
+      stats.sharedRequests += 1;
+      stats.sharedWavefronts += conflict.wavefronts;
+      stats.sharedIdealWavefronts += conflict.idealWavefronts;
+    } else {
+      auto coalescing = AccessAnalyzer::coalescing(access);
+      traced.sectors += coalescing.sectors;
+      traced.usefulBytes += coalescing.usefulBytes;
+      stats.globalRequests += 1;
+      stats.globalSectors += coalescing.sectors;
+      stats.globalUsefulBytes += coalescing.usefulBytes;
+      auto buffer = operands.memref.getAsOpaquePointer();
+      for (auto address : access.addresses) {
+        auto last = floorDiv(address + access.bytesPerLane - 1, 32);
+        for (auto sector = floorDiv(address, 32); sector <= last; sector++) footprint.insert({buffer, sector});
+      }
+      stats.l2FootprintBytes = footprint.size() * 32;
+    }
+  }
+
+  // integer arith on the index computations, anything else leaves its results unknown.
+  void compute(mlir::Operation* op) {
+    if (op->getNumResults() != 1 || op->getName().getDialectNamespace() != "arith") return;
+    std::vector<Lanes> inputs;
+    if (!lookup(op->getOperands(), inputs) || inputs.empty()) return;
+    if (!mlir::getElementTypeOrSelf(op->getResult(0).getType()).isIntOrIndex()) return;
+
+    Lanes result{std::vector<int64_t>(lanes, 0)};
+    for (int64_t lane = 0; lane < lanes; lane++) {
+      if (!mask[lane]) continue;
+      auto x = inputs[0].at(lane), y = inputs.size() > 1 ? inputs[1].at(lane) : 0;
+      auto& value = result.values[lane];
+      if (mlir::isa<mlir::arith::AddIOp>(op)) value = x + y;
+      else if (mlir::isa<mlir::arith::SubIOp>(op)) value = x - y;
+      else if (mlir::isa<mlir::arith::MulIOp>(op)) value = x * y;
+      else if (mlir::isa<mlir::arith::DivSIOp, mlir::arith::DivUIOp>(op)) value = y ? x / y : 0;
+      else if (mlir::isa<mlir::arith::RemSIOp, mlir::arith::RemUIOp>(op)) value = y ? x % y : 0;
+      else if (mlir::isa<mlir::arith::FloorDivSIOp>(op)) value = y ? floorDiv(x, y) : 0;
+      else if (mlir::isa<mlir::arith::CeilDivSIOp>(op)) value = y ? -floorDiv(-x, y) : 0;
+      else if (mlir::isa<mlir::arith::MinSIOp>(op)) value = std::min(x, y);
+      else if (mlir::isa<mlir::arith::MaxSIOp>(op)) value = std::max(x, y);
+      else if (mlir::isa<mlir::arith::AndIOp>(op)) value = x & y;
+      else if (mlir::isa<mlir::arith::OrIOp>(op)) value = x | y;
+      else if (mlir::isa<mlir::arith::XOrIOp>(op)) value = x ^ y;
+      else if (mlir::isa<mlir::arith::IndexCastOp, mlir::arith::ExtSIOp, mlir::arith::ExtUIOp,
+                         mlir::arith::TruncIOp>(op)) value = x;
+      else if (mlir::isa<mlir::arith::SelectOp>(op)) value = x ? y : inputs[2].at(lane);
+      else if (auto cmpOp = mlir::dyn_cast<mlir::arith::CmpIOp>(op)) {
+        using Predicate = mlir::arith::CmpIPredicate;
+        auto ux = static_cast<uint64_t>(x), uy = static_cast<uint64_t>(y);
+        switch (cmpOp.getPredicate()) {
+          case Predicate::eq: value = x == y; break;
+          case Predicate::ne: value = x != y; break;
+          case Predicate::slt: value = x < y; break;
+          case Predicate::sle: value = x <= y; break;
+          case Predicate::sgt: value = x > y; break;
+          case Predicate::sge: value = x >= y; break;
+          case Predicate::ult: value = ux < uy; break;
+          case Predicate::ule: value = ux <= uy; break;
+          case Predicate::ugt: value = ux > uy; break;
+          case Predicate::uge: value = ux >= uy; break;
+        }
+      } else return;
+    }
+    env[op->getResult(0)] = result;
+  }
+
+  void run(mlir::Block& block) {
+    for (auto& op : block) {
+      if (stopped) return;
+      run(&op);
+    }
+  }
+
+  void run(mlir::Operation* op) {
+    AccessOperands operands;
+    if (AccessAnalyzer::getAccessOperands(op, operands)) {
+      record(op, operands);
+    } else if (auto forOp = mlir::dyn_cast<mlir::AffineForOp>(op)) {
+      Lanes lower, upper;
+      if (!evalBound(forOp.getLowerBoundMap(), forOp.getLowerBoundOperands(), true, lower) ||
+          !evalBound(forOp.getUpperBoundMap(), forOp.getUpperBoundOperands(), false, upper)) {
+        return;
+      }
+      loop(forOp.getInductionVar(), lower, upper, forOp.getStep(), *forOp.getBody());
+    } else if (auto forOp = mlir::dyn_cast<mlir::scf::ForOp>(op)) {
+      Lanes lower, upper, step;
+      if (!lookup(forOp.getLowerBound(), lower) || !lookup(forOp.getUpperBound(), upper) ||
+          !lookup(forOp.getStep(), step) || step.values.size() != 1) {
+        return;
+      }
+      loop(forOp.getInductionVar(), lower, upper, step.values[0], *forOp.getBody());
+    } else if (auto ifOp = mlir::dyn_cast<mlir::AffineIfOp>(op)) {
+      auto set = ifOp.getIntegerSet();
+      std::vector<Lanes> inputs;
+      std::vector<bool> condition(lanes, true);
+      // a guard which can't be evaluated is taken.
+      if (lookup(ifOp.getOperands(), inputs)) {
+        std::vector<int64_t> dims(set.getNumDims()), symbols(set.getNumSymbols());
+        for (int64_t lane = 0; lane < lanes; lane++) {
+          if (!mask[lane]) continue;
+          for (int i = 0; i < inputs.size(); i++) {
+            if (i < dims.size()) dims[i] = inputs[i].at(lane);
+            else symbols[i - dims.size()] = inputs[i].at(lane);
+          }
+          for (int c = 0; c < set.getNumConstraints() && condition[lane]; c++) {
+            int64_t value = 0;
+            if (!AccessAnalyzer::evalExpr(set.getConstraint(c), dims, symbols, value)) continue;
+            condition[lane] = set.isEq(c) ? value == 0 : value >= 0;
+          }
+        }
+      }
+      branch(condition, ifOp.getThenBlock());
+      for (auto&& taken : condition) taken = !taken;
+      if (ifOp.hasElse()) branch(condition, ifOp.getElseBlock());
+    } else if (auto ifOp = mlir::dyn_cast<mlir::scf::IfOp>(op)) {
+      Lanes value;
+      std::vector<bool> condition(lanes, true);
+      if (lookup(ifOp.getCondition(), value)) {
+        for (int64_t lane = 0; lane < lanes; lane++) condition[lane] = value.at(lane) != 0;
+      }
+      branch(condition, &ifOp.getThenRegion().front());
+      for (auto&& taken : condition) taken = !taken;
+      if (!ifOp.getElseRegion().empty()) branch(condition, &ifOp.getElseRegion().front());
+    } else if (auto parallelOp = mlir::dyn_cast<mlir::AffineParallelOp>(op)) {
+      // the thread level, a parallel op inside a warp isn't generated.
+      if (lanes == 1) runThreads(parallelOp);
+    } else if (auto applyOp = mlir::dyn_cast<mlir::AffineApplyOp>(op)) {
+      std::vector<Lanes> results;
+      if (evalMap(applyOp.getAffineMap(), applyOp.getMapOperands(), results)) env[applyOp.getResult()] = results[0];
+    } else if (auto minOp = mlir::dyn_cast<mlir::AffineMinOp>(op)) {
+      Lanes result;
+      if (evalBound(minOp.getAffineMap(), minOp.getMapOperands(), false, result)) env[minOp.getResult()] = result;
+    } else if (auto maxOp = mlir::dyn_cast<mlir::AffineMaxOp>(op)) {
+      Lanes result;
+      if (evalBound(maxOp.getAffineMap(), maxOp.getMapOperands(), true, result)) env[maxOp.getResult()] = result;
+    } else if (op->getNumRegions() == 0) {
+      compute(op);
+    } else {
+      for (auto& region : op->getRegions()) {
+        for (auto& block : region) run(block);
+      }
+    }
+  }
+
+  TraceStats& stats;
+  int64_t warpSize;
+  int64_t maxRequests;
+  bool stopped = false;
+  int64_t lanes = 1;
+  std::vector<bool> mask;
+  llvm::DenseMap<mlir::Value, Lanes> env;
+  std::map<mlir::Operation*, int> accessIndex;
+  std::set<std::pair<const void*, int64_t>> footprint;
+};
+
+}
+
+TraceStats MemoryTracer::trace(mlir::AffineParallelOp gridLevel, int64_t sampleBlocks, int64_t warpSize,
+                               int64_t maxRequests) {
+  TraceStats stats;
+  auto ranges = gridLevel.getConstantRanges();
+  if (!ranges) return stats;
+  stats.blocks = 1;
+  for (auto range : *ranges) stats.blocks *= range;
+  if (stats.blocks == 0) return stats;
+
+  // evenly spread, the last block is where the partial tiles usually are.
+  std::vector<int64_t> blocks;
+  auto count = sampleBlocks <= 0 ? stats.blocks : std::min(sampleBlocks, stats.blocks);
+  for (int64_t i = 0; i < count; i++) {
+    auto block = count == 1 ? 0 : i * (stats.blocks - 1) / (count - 1);
+    if (blocks.empty() || blocks.back() != block) blocks.push_back(block);
+  }
+
+  Tracer tracer(stats, warpSize, maxRequests);
+  for (auto block : blocks) {
+    if (stats.truncated) break;
+    tracer.traceBlock(gridLevel, block);
+  }
+  return stats;
+}
+
+void MemoryTracer::dump(const TraceStats& stats, llvm::raw_ostream& os) {
+  for (auto& access : stats.accesses) {
+    os << access.op->getName() << (access.space == MemorySpace::shared ? " shared" : " global") << ": "
+       << access.requests << " requests";
+    if (access.space == MemorySpace::shared) {
+      os << ", " << access.wavefronts << " wavefronts, " << access.wavefronts - access.idealWavefronts
+         << " replays\n";
+    } else {
+      os << ", " << access.sectors << " sectors, efficiency "
+         << (access.sectors ? 1.0 * access.usefulBytes / (access.sectors * 32) : 1.0) << "\n";
+    }
+  }
+  os << "traced " << stats.tracedBlocks << " of " << stats.blocks << " blocks, " << stats.tracedWarps << " warps"
+     << (stats.truncated ? " (truncated)" : "") << "\n";
+  os << "global: " << stats.globalRequests << " requests, " << stats.globalSectors << " sectors, efficiency "
+     << stats.sectorEfficiency() << ", L2 footprint " << stats.l2FootprintBytes << " bytes\n";
+  os << "shared: " << stats.sharedRequests << " requests, " << stats.sharedWavefronts << " wavefronts, "
+     << stats.bankConflictReplays() << " replays, degree " << stats.bankConflictDegree() << "\n";
+  if (stats.unresolved) os << "unresolved: " << stats.unresolved << " requests\n";
+}
+
+}
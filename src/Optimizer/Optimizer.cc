@@ -25,13 +25,28 @@ inline std::string toStr(mlir::Type type) {
 
 namespace KernelCodeGen {
 
-std::map<std::string, int> MatmulOptimizer::matmulConfig;
-std::map<std::string, int> FMHAOptimizer::fmhaConfig;
-std::map<std::string, int> BinaryOptimizer::binaryConfig;
-std::map<std::string, int> ElementWiseOptimizer::elementWiseConfig;
-std::map<std::string, int> LayerNormOptimizer::layerNormConfig;
-std::map<std::string, int> GatherOptimizer::gatherConfig;
-std::map<std::string, int> BatchMatmulOptimizer::batchMatmulConfig;
+std::vector<mlir::func::FuncOp> Optimizer::filterTargets(std::vector<mlir::func::FuncOp> funcs) {
+  if (targets.empty() && reused.empty()) return std::move(funcs);
+  std::vector<mlir::func::FuncOp> result;
+  for (auto func : funcs) {
+    auto symbol = func.getSymName().str();
+    if (isTarget(symbol) && reused.count(symbol) == 0) result.push_back(func);
+  }
+  return std::move(result);
+}
+
+std::unique_ptr<Optimizer> createOptimizer(const std::string& name) {
+  if (name == "Matmul") return std::make_unique<MatmulOptimizer>();
+  if (name == "CpuMatmul") return std::make_unique<CpuMatmulOptimizer>();
+  if (name == "Binary") return std::make_unique<BinaryOptimizer>();
+  if (name == "ElementWise") return std::make_unique<ElementWiseOptimizer>();
+  if (name == "LayerNorm") return std::make_unique<LayerNormOptimizer>();
+  if (name == "Gather") return std::make_unique<GatherOptimizer>();
+  if (name == "FMHA") return std::make_unique<FMHAOptimizer>();
+  if (name == "BatchMatmul") return std::make_unique<BatchMatmulOptimizer>();
+  llvm::errs() << "Unknown optimizer " << name << "\n";
+  return nullptr;
+}
 
 struct LoadOrStoreOp {
   enum MemRSKind {
@@ -242,7 +257,7 @@ int searchInductionVar(const std::vector<mlir::AffineForOp>& loops, mlir::Value
 
 bool MatmulOptimizer::applicable(mlir::ModuleOp& module) {
   clear();
-  auto&& matmulFuncs = Analyzer::collectFunctions(module, "Matmul");
+  auto&& matmulFuncs = filterTargets(Analyzer::collectFunctions(module, "Matmul"));
   bool res = matmulFuncs.size() != 0 ? true : false;
 
   for (auto& matmulFunc : matmulFuncs) {
@@ -298,10 +313,10 @@ mlir::AffineMap MatmulOptimizer::getAffineMap(const std::string& mapIdentifier,
   auto dim5 = builder.getAffineDimExpr(5);
   auto dim6 = builder.getAffineDimExpr(6);
   auto dim7 = builder.getAffineDimExpr(7);
-  int64_t blockDimY = matmulConfig["BLOCK_SIZE_M"] / matmulConfig["THREAD_SIZE_M"];
-  int64_t blockDimX = matmulConfig["BLOCK_SIZE_N"] / matmulConfig["THREAD_SIZE_N"];
-  bool vectorize = matmulConfig.count("VECTORIZE_WIDTH") != 0;
-  int width = vectorize ? matmulConfig["VECTORIZE_WIDTH"] : 1;
+  int64_t blockDimY = matmulConfig.BLOCK_SIZE_M / matmulConfig.THREAD_SIZE_M;
+  int64_t blockDimX = matmulConfig.BLOCK_SIZE_N / matmulConfig.THREAD_SIZE_N;
+  bool vectorize = matmulConfig.VECTORIZE_WIDTH > 1;
+  int width = vectorize ? matmulConfig.VECTORIZE_WIDTH : 1;
 
   std::vector<int64_t> warpOrg {2, 4};  
   std::vector<int64_t> threadOrg {8, 4};
@@ -312,9 +327,9 @@ mlir::AffineMap MatmulOptimizer::getAffineMap(const std::string& mapIdentifier,
     // iv represent a block copy for iv times. 
     auto threadIdExpr = dim0 * blockDimX + dim1;
     auto virtaulThreadIxExpr = threadIdExpr + dim4 * blockDimY * blockDimX;
-    auto M_Offset = virtaulThreadIxExpr.floorDiv(static_cast<uint64_t>(matmulConfig["BLOCK_SIZE_K"]) / width);
-    auto K_Offset = virtaulThreadIxExpr % (static_cast<uint64_t>(matmulConfig["BLOCK_SIZE_K"]) / width); 
-    auto M_Base = dim2 * matmulConfig["BLOCK_SIZE_M"];
+    auto M_Offset = virtaulThreadIxExpr.floorDiv(static_cast<uint64_t>(matmulConfig.BLOCK_SIZE_K) / width);
+    auto K_Offset = virtaulThreadIxExpr % (static_cast<uint64_t>(matmulConfig.BLOCK_SIZE_K) / width); 
+    auto M_Base = dim2 * matmulConfig.BLOCK_SIZE_M;
     auto K_Base = dim3;
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(M_Offset + M_Base);
@@ -325,10 +340,10 @@ mlir::AffineMap MatmulOptimizer::getAffineMap(const std::string& mapIdentifier,
     // operands are: [threadIdx.y, threadIdx.x, k_outer, blockIdx.x, iv]
     auto threadIdExpr = dim0 * blockDimX + dim1;
     auto virtaulThreadIxExpr = threadIdExpr + dim4 * blockDimY * blockDimX;
-    auto K_Offset = virtaulThreadIxExpr.floorDiv(static_cast<uint64_t>(matmulConfig["BLOCK_SIZE_N"]) / width);
-    auto N_Offset = virtaulThreadIxExpr % (static_cast<uint64_t>(matmulConfig["BLOCK_SIZE_N"]) / width); 
+    auto K_Offset = virtaulThreadIxExpr.floorDiv(static_cast<uint64_t>(matmulConfig.BLOCK_SIZE_N) / width);
+    auto N_Offset = virtaulThreadIxExpr % (static_cast<uint64_t>(matmulConfig.BLOCK_SIZE_N) / width); 
     auto K_Base = dim2;
-    auto N_Base = dim3 * matmulConfig["BLOCK_SIZE_N"];
+    auto N_Base = dim3 * matmulConfig.BLOCK_SIZE_N;
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(K_Offset + K_Base);
     exprs.push_back(N_Offset * width + N_Base);
@@ -338,8 +353,8 @@ mlir::AffineMap MatmulOptimizer::getAffineMap(const std::string& mapIdentifier,
     // operands are: [threadIdx.y, threadIdx.x, iv, ivInVector]
     auto threadIdExpr = dim0 * blockDimX + dim1;
     auto virtaulThreadIxExpr = threadIdExpr + dim2 * blockDimY * blockDimX;
-    auto M_Offset = virtaulThreadIxExpr.floorDiv(static_cast<uint64_t>(matmulConfig["BLOCK_SIZE_K"]) / width);
-    auto K_Offset = virtaulThreadIxExpr % (static_cast<uint64_t>(matmulConfig["BLOCK_SIZE_K"]) / width);
+    auto M_Offset = virtaulThreadIxExpr.floorDiv(static_cast<uint64_t>(matmulConfig.BLOCK_SIZE_K) / width);
+    auto K_Offset = virtaulThreadIxExpr % (static_cast<uint64_t>(matmulConfig.BLOCK_SIZE_K) / width);
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(K_Offset * width + dim3);
     exprs.push_back(M_Offset);
@@ -349,8 +364,8 @@ mlir::AffineMap MatmulOptimizer::getAffineMap(const std::string& mapIdentifier,
     // operands are: [threadIdx.y, threadIdx.x, iv]
     auto threadIdExpr = dim0 * blockDimX + dim1;
     auto virtaulThreadIxExpr = threadIdExpr + dim2 * blockDimY * blockDimX;
-    auto K_Offset = virtaulThreadIxExpr.floorDiv(static_cast<uint64_t>(matmulConfig["BLOCK_SIZE_N"]) / width);
-    auto N_Offset = virtaulThreadIxExpr % (static_cast<uint64_t>(matmulConfig["BLOCK_SIZE_N"]) / width); 
+    auto K_Offset = virtaulThreadIxExpr.floorDiv(static_cast<uint64_t>(matmulConfig.BLOCK_SIZE_N) / width);
+    auto N_Offset = virtaulThreadIxExpr % (static_cast<uint64_t>(matmulConfig.BLOCK_SIZE_N) / width); 
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(K_Offset);
     exprs.push_back(N_Offset * width);
@@ -359,8 +374,8 @@ mlir::AffineMap MatmulOptimizer::getAffineMap(const std::string& mapIdentifier,
     // dims are:[dim0, dim1, dim2, dim3]
     // operands are: [threadIdx.y, threadIdx.x, k_inner, iv]
     auto threadIdExpr = dim0 * blockDimX + dim1;
-    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(matmulConfig["WARP_SIZE"]));
-    auto laneId = threadIdExpr % static_cast<uint64_t>(matmulConfig["WARP_SIZE"]);
+    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(matmulConfig.WARP_SIZE));
+    auto laneId = threadIdExpr % static_cast<uint64_t>(matmulConfig.WARP_SIZE);
 
     auto M_offset = laneId.floorDiv(threadOrg[1]) + threadOrg[0] * (warpId.floorDiv(warpOrg[1]) + dim3 * warpOrg[0]);
     auto K_offset = dim2;
@@ -372,8 +387,8 @@ mlir::AffineMap MatmulOptimizer::getAffineMap(const std::string& mapIdentifier,
     // dims are:[dim0, dim1, dim2, dim3]
     // operands are: [threadIdx.y, threadIdx.x, k_inner, iv]
     auto threadIdExpr = dim0 * blockDimX + dim1;
-    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(matmulConfig["WARP_SIZE"]));
-    auto laneId = threadIdExpr % static_cast<uint64_t>(matmulConfig["WARP_SIZE"]);
+    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(matmulConfig.WARP_SIZE));
+    auto laneId = threadIdExpr % static_cast<uint64_t>(matmulConfig.WARP_SIZE);
 
     auto N_offset = laneId % threadOrg[1] + threadOrg[1] * (warpId % warpOrg[1] + dim3 * warpOrg[1]);
     auto K_offset = dim2;
@@ -389,14 +404,14 @@ mlir::AffineMap MatmulOptimizer::getAffineMap(const std::string& mapIdentifier,
     // dims are:[dim0, dim1, dim2, dim3, dim4, dim5, dim6, dim7]
     // operands are: [threadIdx.y, threadIdx.x, blockIdx.y, blockIdx.x, iv0, iv1, iv2, iv3]
     auto threadIdExpr = dim0 * blockDimX + dim1;
-    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(matmulConfig["WARP_SIZE"]));
-    auto laneId = threadIdExpr % static_cast<uint64_t>(matmulConfig["WARP_SIZE"]);
+    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(matmulConfig.WARP_SIZE));
+    auto laneId = threadIdExpr % static_cast<uint64_t>(matmulConfig.WARP_SIZE);
 
     auto M_offset = laneId.floorDiv(threadOrg[1]) + threadOrg[0] * (warpId.floorDiv(warpOrg[1]) + dim4.floorDiv(width) * warpOrg[0]);
     auto N_offset = laneId % threadOrg[1] + threadOrg[1] * (warpId % warpOrg[1] + dim5.floorDiv(width) * warpOrg[1]);
     llvm::SmallVector<mlir::AffineExpr> exprs;
-    exprs.push_back(dim2 * matmulConfig["BLOCK_SIZE_M"] + M_offset * width + dim6);
-    exprs.push_back(dim3 * matmulConfig["BLOCK_SIZE_N"] + N_offset * width + dim7);
+    exprs.push_back(dim2 * matmulConfig.BLOCK_SIZE_M + M_offset * width + dim6);
+    exprs.push_back(dim3 * matmulConfig.BLOCK_SIZE_N + N_offset * width + dim7);
     return mlir::AffineMap::get(/*dimCount*/8, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());
   } else {
     assert(false);
@@ -411,8 +426,8 @@ void MatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
     auto buffers = matmulBuffers[matmul];
     auto A = buffers.A, B = buffers.B, C = buffers.C;
     
-    auto m_axes = Rewriter::split(loopM, 3, {matmulConfig["THREAD_SIZE_M"], matmulConfig["BLOCK_SIZE_M"]});
-    auto n_axes = Rewriter::split(loopN, 3, {matmulConfig["THREAD_SIZE_N"], matmulConfig["BLOCK_SIZE_N"]});
+    auto m_axes = Rewriter::split(loopM, 3, {matmulConfig.THREAD_SIZE_M, matmulConfig.BLOCK_SIZE_M});
+    auto n_axes = Rewriter::split(loopN, 3, {matmulConfig.THREAD_SIZE_N, matmulConfig.BLOCK_SIZE_N});
 
     DUMP(module);
 
@@ -436,17 +451,17 @@ void MatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
     Rewriter::reorder({loopK, m_inner, n_inner});
     DUMP(module);
 
-    auto k_axes = Rewriter::split(loopK, 2, {matmulConfig["BLOCK_SIZE_K"]});
+    auto k_axes = Rewriter::split(loopK, 2, {matmulConfig.BLOCK_SIZE_K});
     auto k_outer = k_axes[0], k_inner = k_axes[1];
     DUMP(module);
 
     int64_t blockThreads;
     auto blockDim = Analyzer::getParallelNumber(blockLevel, blockThreads);
 
-    auto ldgASize = matmulConfig["BLOCK_SIZE_K"] * matmulConfig["BLOCK_SIZE_M"] / blockThreads;
-    auto ldgBSize = matmulConfig["BLOCK_SIZE_K"] * matmulConfig["BLOCK_SIZE_N"] / blockThreads;
-    auto fragASize = matmulConfig["BLOCK_SIZE_M"] / smAReadSride(blockThreads, matmulConfig["WARP_SIZE"]);
-    auto fragBSize = matmulConfig["BLOCK_SIZE_N"] / smBReadSride(blockThreads, matmulConfig["WARP_SIZE"]);
+    auto ldgASize = matmulConfig.BLOCK_SIZE_K * matmulConfig.BLOCK_SIZE_M / blockThreads;
+    auto ldgBSize = matmulConfig.BLOCK_SIZE_K * matmulConfig.BLOCK_SIZE_N / blockThreads;
+    auto fragASize = matmulConfig.BLOCK_SIZE_M / smAReadSride(blockThreads, matmulConfig.WARP_SIZE);
+    auto fragBSize = matmulConfig.BLOCK_SIZE_N / smBReadSride(blockThreads, matmulConfig.WARP_SIZE);
     auto elementA = A.getType().dyn_cast<mlir::MemRefType>().getElementType();
     auto elementB = B.getType().dyn_cast<mlir::MemRefType>().getElementType();
 
@@ -456,9 +471,9 @@ void MatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
     auto tileB = Rewriter::alloc_buffer(/*parallelLevel*/blockLevel, MemorySpace::local, {ldgBSize}, elementB);
     auto tileA = Rewriter::alloc_buffer(/*parallelLevel*/blockLevel, MemorySpace::local, {ldgASize}, elementA);
     auto smB = Rewriter::alloc_buffer(/*parallelLevel*/gridLevel, MemorySpace::shared,
-            {matmulConfig["BLOCK_SIZE_K"], matmulConfig["BLOCK_SIZE_N"]}, elementB);
+            {matmulConfig.BLOCK_SIZE_K, matmulConfig.BLOCK_SIZE_N}, elementB);
     auto smA = Rewriter::alloc_buffer(/*parallelLevel*/gridLevel, MemorySpace::shared,
-            {matmulConfig["BLOCK_SIZE_K"], matmulConfig["BLOCK_SIZE_M"]}, elementA);
+            {matmulConfig.BLOCK_SIZE_K, matmulConfig.BLOCK_SIZE_M}, elementA);
     DUMP(module);
     
     auto blockIdx = Rewriter::getParallelIdx(gridLevel);
@@ -466,19 +481,19 @@ void MatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
     
     auto loadTileAMap = getAffineMap("loadTileA", builder);
     auto loadTileA = Rewriter::read(A, tileA, loadTileAMap, {threadIdx[0], threadIdx[1], blockIdx[0], k_outer.getInductionVar()}, 
-                      matmulConfig["VECTORIZE_WIDTH"], k_outer, Position::begin);
+                      matmulConfig.VECTORIZE_WIDTH, k_outer, Position::begin);
     auto loadTileBMap = getAffineMap("loadTileB", builder);
     auto loadTileB = Rewriter::read(B, tileB, loadTileBMap, 
                       {threadIdx[0], threadIdx[1], k_outer.getInductionVar(), blockIdx[1]}, 
-                      matmulConfig["VECTORIZE_WIDTH"], loadTileA, Position::after);
+                      matmulConfig.VECTORIZE_WIDTH, loadTileA, Position::after);
     DUMP(module);
 
     auto storeTileAMap = getAffineMap("storeTileA", builder);
     auto storeTileA = Rewriter::write(tileA, smA, storeTileAMap, {threadIdx[0], threadIdx[1]}, 
-                        matmulConfig["VECTORIZE_WIDTH"], loadTileB, Position::after);
+                        matmulConfig.VECTORIZE_WIDTH, loadTileB, Position::after);
     auto storeTileBMap = getAffineMap("storeTileB", builder);
     auto storeTileB = Rewriter::write(tileB, smB, storeTileBMap, {threadIdx[0], threadIdx[1]}, 
-                                matmulConfig["VECTORIZE_WIDTH"], storeTileA, Position::after);
+                                matmulConfig.VECTORIZE_WIDTH, storeTileA, Position::after);
     auto gpuBarrierPrefix = Rewriter::barrier(loadTileA, Position::before);
     auto gpuBarrierSuffix = Rewriter::barrier(storeTileB, Position::after);
 
@@ -486,10 +501,10 @@ void MatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
 
     auto loadFragAMap = getAffineMap("loadFragA", builder);
     auto loadFragA = Rewriter::read(smA, fragA, loadFragAMap, {threadIdx[0], threadIdx[1], k_inner.getInductionVar()}, 
-                      matmulConfig["VECTORIZE_WIDTH"], k_inner, Position::begin);
+                      matmulConfig.VECTORIZE_WIDTH, k_inner, Position::begin);
     auto loadFragBMap = getAffineMap("loadFragB", builder);
     auto loadFragB = Rewriter::read(smB, fragB, loadFragBMap, {threadIdx[0], threadIdx[1], k_inner.getInductionVar()}, 
-                      matmulConfig["VECTORIZE_WIDTH"], loadFragA, Position::after);
+                      matmulConfig.VECTORIZE_WIDTH, loadFragA, Position::after);
     DUMP(module);
 
     Rewriter::cache_read(k_inner, A, fragA, getAffineMap("cacheReadA", builder), {m_inner.getInductionVar()});
@@ -498,8 +513,8 @@ void MatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
 
     auto writeCbody = Rewriter::get_write(blockLevel, C);
     assert(writeCbody.size() == 1);
-    auto m_inner_axes = Rewriter::split(writeCbody[0][0], 2, {matmulConfig["VECTORIZE_WIDTH"]});
-    auto n_inner_axes = Rewriter::split(writeCbody[0][1], 2, {matmulConfig["VECTORIZE_WIDTH"]});
+    auto m_inner_axes = Rewriter::split(writeCbody[0][0], 2, {matmulConfig.VECTORIZE_WIDTH});
+    auto n_inner_axes = Rewriter::split(writeCbody[0][1], 2, {matmulConfig.VECTORIZE_WIDTH});
     auto m_inner_0 = m_inner_axes[0], m_inner_1 = m_inner_axes[1];
     auto n_inner_0 = n_inner_axes[0], n_inner_1 = n_inner_axes[1];
     Rewriter::reorder({m_inner_0, n_inner_0, m_inner_1, n_inner_1});
@@ -510,7 +525,7 @@ void MatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
                           n_inner_0.getInductionVar(), m_inner_1.getInductionVar(), n_inner_1.getInductionVar()});
     DUMP(module);
 
-    Rewriter::vectorize(n_inner_1, matmulConfig["VECTORIZE_WIDTH"]);
+    Rewriter::vectorize(n_inner_1, matmulConfig.VECTORIZE_WIDTH);
     DUMP(module);
     
     auto doubleLoadTileB = Rewriter::pipeline({loadTileB, storeTileB}, smB, k_outer);
@@ -544,14 +559,18 @@ void MatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
     Rewriter::delete_false_if(module);
     DUMP(module);
 
-    int64_t threshold = std::max(matmulConfig["BLOCK_SIZE_K"], std::max(matmulConfig["THREAD_SIZE_M"], matmulConfig["THREAD_SIZE_N"]));
+    // groups of GROUP_SIZE_M tile rows run together and share the tiles of A and B in L2.
+    Rewriter::swizzleGrid(gridLevel, matmulConfig.GROUP_SIZE_M);
+    DUMP(module);
+
+    int64_t threshold = std::max(matmulConfig.BLOCK_SIZE_K, std::max(matmulConfig.THREAD_SIZE_M, matmulConfig.THREAD_SIZE_N));
     Rewriter::unroll(module, [&](mlir::AffineForOp forOp)->bool {
       if (!forOp.hasConstantBounds()) return false;
       auto step = forOp.getStep();
       auto ub = forOp.getConstantUpperBound();
       auto lb = forOp.getConstantLowerBound();
       auto times = (ub - lb) / step;
-      if (times >= std::min<int64_t>(threshold, matmulConfig["VECTORIZE_WIDTH"])) return false;
+      if (times >= std::min<int64_t>(threshold, matmulConfig.VECTORIZE_WIDTH)) return false;
       return true;
     });
     DUMP(module);
@@ -569,6 +588,286 @@ void MatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
   }
 }
 
+/*----------------------------cpu matmul---------------------------------*/
+
+// the largest multiple of unit which divides extent and is not above block.
+int64_t fitCpuBlock(int64_t extent, int64_t block, int64_t unit) {
+  for (int64_t size = std::min(block, extent) / unit * unit; size >= unit; size -= unit) {
+    if (extent % size == 0) return size;
+  }
+  return unit;
+}
+
+bool CpuMatmulOptimizer::applicable(mlir::ModuleOp& module) {
+  clear();
+  auto&& matmulFuncs = filterTargets(Analyzer::collectFunctions(module, "Matmul"));
+
+  for (auto& matmulFunc : matmulFuncs) {
+    auto funcName = matmulFunc.getSymName().str();
+    if (funcName.find("BatchMatmul") != std::string::npos) continue;
+    // the matmuls taken by MatmulOptimizer run on the gpu, the ones already blocked have more loops.
+    auto state = matmulFunc->getAttrOfType<mlir::StringAttr>(std::string("func.state"));
+    if (!state || state.getValue() != "cpu") continue;
+    auto&& loops = Analyzer::collectFuncLoops(matmulFunc);
+    if (loops.size() != 3 || loops[2].getNumIterOperands() != 1) continue;
+
+    MatmulOptimizer::MemoryBuffer ABC;
+    auto funcArgs = matmulFunc.front().getArguments();
+    ABC.A = funcArgs[0];
+    ABC.B = funcArgs[1];
+    auto returnOp = mlir::dyn_cast<mlir::func::ReturnOp>(matmulFunc.front().back());
+    ABC.C = returnOp.getOperand(0);
+    auto typeA = ABC.A.getType().dyn_cast<mlir::MemRefType>();
+    auto typeC = ABC.C.getType().dyn_cast<mlir::MemRefType>();
+    if (!typeC.getElementType().isa<mlir::FloatType>()) continue;
+
+    Blocking blocking;
+    blocking.m = typeC.getShape()[0];
+    blocking.n = typeC.getShape()[1];
+    blocking.k = typeA.getShape()[1];
+    if (blocking.n % cpuMatmulConfig.NR != 0) {
+      if (KCGLog::level == Log::Debug) {
+        llvm::errs() << funcName << ": N is not a multiple of NR = " << cpuMatmulConfig.NR << ", not blocked\n";
+      }
+      continue;
+    }
+    blocking.paddedM = (blocking.m + cpuMatmulConfig.MR - 1) / cpuMatmulConfig.MR * cpuMatmulConfig.MR;
+    blocking.mc = fitCpuBlock(blocking.paddedM, cpuMatmulConfig.MC, cpuMatmulConfig.MR);
+    blocking.nc = fitCpuBlock(blocking.n, cpuMatmulConfig.NC, cpuMatmulConfig.NR);
+    blocking.kc = fitCpuBlock(blocking.k, cpuMatmulConfig.KC, 1);
+
+    matmuls.insert(matmulFunc);
+    matmulLoops[matmulFunc] = std::move(loops);
+    matmulBuffers[matmulFunc] = ABC;
+    matmulBlockings[matmulFunc] = blocking;
+  }
+  return matmuls.size() != 0;
+}
+
+mlir::AffineMap CpuMatmulOptimizer::getAffineMap(const std::string& mapIdentifier, mlir::OpBuilder& builder,
+                                                 const Blocking& blocking, const std::vector<int64_t>& extras) {
+  auto dim0 = builder.getAffineDimExpr(0);
+  auto dim1 = builder.getAffineDimExpr(1);
+  auto dim2 = builder.getAffineDimExpr(2);
+  auto dim3 = builder.getAffineDimExpr(3);
+  auto dim4 = builder.getAffineDimExpr(4);
+  int64_t MR = cpuMatmulConfig.MR, NR = cpuMatmulConfig.NR;
+
+  if (mapIdentifier == "packReadA") {
+    // dims are:[dim0, dim1, dim2, dim3, dim4]
+    // operands are: [ic, pc, panel, row, k]
+    llvm::SmallVector<mlir::AffineExpr> exprs;
+    exprs.push_back(dim0 + dim2 * MR + dim3);
+    exprs.push_back(dim1 + dim4);
+    return mlir::AffineMap::get(/*dimCount*/5, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());
+  } else if (mapIdentifier == "packWriteA") {
+    // dims are:[dim0, dim1, dim2]
+    // operands are: [panel, row, k], the rows of a micro-panel are contiguous for every k.
+    llvm::SmallVector<mlir::AffineExpr> exprs;
+    exprs.push_back(dim0);
+    exprs.push_back(dim2);
+    exprs.push_back(dim1);
+    return mlir::AffineMap::get(/*dimCount*/3, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());
+  } else if (mapIdentifier == "packReadB") {
+    // dims are:[dim0, dim1, dim2, dim3, dim4]
+    // operands are: [jc, pc, panel, k, col]
+    llvm::SmallVector<mlir::AffineExpr> exprs;
+    exprs.push_back(dim1 + dim3);
+    exprs.push_back(dim0 + dim2 * NR + dim4);
+    return mlir::AffineMap::get(/*dimCount*/5, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());
+  } else if (mapIdentifier == "packWriteB") {
+    // dims are:[dim0, dim1, dim2]
+    // operands are: [panel, k, col]
+    llvm::SmallVector<mlir::AffineExpr> exprs;
+    exprs.push_back(dim0);
+    exprs.push_back(dim1);
+    exprs.push_back(dim2);
+    return mlir::AffineMap::get(/*dimCount*/3, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());
+  } else if (mapIdentifier == "loadPackA" || mapIdentifier == "loadPackB") {
+    // dims are:[dim0, dim1]
+    // operands are: [ir, k] or [jr, k], extras are: [row] or [col]
+    auto width = mapIdentifier == "loadPackA" ? MR : NR;
+    llvm::SmallVector<mlir::AffineExpr> exprs;
+    exprs.push_back(dim0.floorDiv(width));
+    exprs.push_back(dim1);
+    exprs.push_back(builder.getAffineConstantExpr(extras[0]));
+    return mlir::AffineMap::get(/*dimCount*/2, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());
+  } else if (mapIdentifier == "tileC") {
+    // dims are:[dim0, dim1, dim2, dim3]
+    // operands are: [ic, ir, jc, jr], extras are: [row, col]
+    llvm::SmallVector<mlir::AffineExpr> exprs;
+    exprs.push_back(dim0 + dim1 + extras[0]);
+    exprs.push_back(dim2 + dim3 + extras[1]);
+    return mlir::AffineMap::get(/*dimCount*/4, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());
+  } else {
+    assert(false);
+  }
+}
+
+mlir::IntegerSet CpuMatmulOptimizer::getIntegerSet(const std::string& setIdentifier, mlir::OpBuilder& builder,
+                                                   const Blocking& blocking, const std::vector<int64_t>& extras) {
+  auto dim0 = builder.getAffineDimExpr(0);
+  auto dim1 = builder.getAffineDimExpr(1);
+  auto dim2 = builder.getAffineDimExpr(2);
+
+  if (setIdentifier == "packRowA") {
+    // dims are:[dim0, dim1, dim2]
+    // operands are: [ic, panel, row]
+    auto expr = blocking.m - 1 - (dim0 + dim1 * cpuMatmulConfig.MR + dim2);
+    return mlir::IntegerSet::get(3, 0, llvm::ArrayRef<mlir::AffineExpr>({expr}), llvm::ArrayRef<bool>({false}));
+  } else if (setIdentifier == "rowC") {
+    // dims are:[dim0, dim1]
+    // operands are: [ic, ir], extras are: [row]
+    auto expr = blocking.m - 1 - (dim0 + dim1 + extras[0]);
+    return mlir::IntegerSet::get(2, 0, llvm::ArrayRef<mlir::AffineExpr>({expr}), llvm::ArrayRef<bool>({false}));
+  } else {
+    assert(false);
+  }
+}
+
+void CpuMatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& builder) {
+  auto& config = cpuMatmulConfig;
+  for (auto& matmul : matmuls) {
+    // the function stays on the host, the HostJIT compiles it.
+    auto loops = matmulLoops[matmul];
+    auto loopM = loops[0], loopN = loops[1];
+    auto buffers = matmulBuffers[matmul];
+    auto A = buffers.A, B = buffers.B, C = buffers.C;
+    auto& blocking = matmulBlockings[matmul];
+    auto loc = builder.getUnknownLoc();
+    auto elementType = C.getType().dyn_cast<mlir::MemRefType>().getElementType();
+    auto vectorType = mlir::VectorType::get(config.VECTORIZE_WIDTH, elementType);
+    int64_t vectors = config.NR / config.VECTORIZE_WIDTH;
+    bool padded = blocking.paddedM != blocking.m;
+
+    // the body of the point loops is replaced below, so they may run over the padded rows.
+    loopM.setConstantUpperBound(blocking.paddedM);
+    auto m_axes = Rewriter::split(loopM, 3, {config.MR, blocking.mc});
+    auto n_axes = Rewriter::split(loopN, 3, {config.NR, blocking.nc});
+    DUMP(module);
+
+    auto ic = m_axes[0], ir = m_axes[1], m_point = m_axes[2];
+    auto jc = n_axes[0], jr = n_axes[1], n_point = n_axes[2];
+    Rewriter::reorder({jc, ic, jr, ir, m_point, n_point});
+    DUMP(module);
+
+    // the MR x NR point loops only hold the naive reduction.
+    m_point.erase();
+
+    auto pcBuilder = Rewriter::getBuilder(ic, Position::before);
+    auto pc = Rewriter::create_constant_loop(pcBuilder, 0, blocking.k, blocking.kc);
+    ic->moveBefore(pc.getBody()->getTerminator());
+    DUMP(module);
+
+    // every micro-kernel adds its KC slice of the product to C.
+    auto initBuilder = Rewriter::getBuilder(jc, Position::before);
+    auto zero = initBuilder.create<mlir::arith::ConstantOp>(loc, initBuilder.getFloatAttr(elementType, 0));
+    Rewriter::set_buffer(initBuilder, C, zero.getResult());
+
+    auto packA = Rewriter::alloc_buffer(jc, Position::before, MemorySpace::global,
+                                        {blocking.mc / config.MR, blocking.kc, config.MR}, elementType);
+    auto packB = Rewriter::alloc_buffer(jc, Position::before, MemorySpace::global,
+                                        {blocking.nc / config.NR, blocking.kc, config.NR}, elementType);
+    auto func = matmul;
+    mlir::OpBuilder deallocBuilder(&func.front().back());
+    deallocBuilder.create<mlir::memref::DeallocOp>(loc, packA);
+    deallocBuilder.create<mlir::memref::DeallocOp>(loc, packB);
+    DUMP(module);
+
+    auto jcIv = jc.getInductionVar(), pcIv = pc.getInductionVar(), icIv = ic.getInductionVar();
+    auto jrIv = jr.getInductionVar(), irIv = ir.getInductionVar();
+
+    // the NC x KC panel of B, NR columns of a k next to each other.
+    auto packBBuilder = Rewriter::getBuilder(pc, Position::begin);
+    auto packReadB = getAffineMap("packReadB", builder, blocking);
+    auto packWriteB = getAffineMap("packWriteB", builder, blocking);
+    mlir::buildAffineLoopNest(packBBuilder, loc, mlir::SmallVector<int64_t, 3>(3, 0),
+      mlir::SmallVector<int64_t, 3>({blocking.nc / config.NR, blocking.kc, config.NR}),
+      mlir::SmallVector<int64_t, 3>({1, 1, config.VECTORIZE_WIDTH}),
+      [&](mlir::OpBuilder &nestedBuilder, mlir::Location loc, mlir::ValueRange ivs) {
+        auto ld = nestedBuilder.create<mlir::AffineVectorLoadOp>(loc, vectorType, B, packReadB,
+                    mlir::ValueRange({jcIv, pcIv, ivs[0], ivs[1], ivs[2]}));
+        nestedBuilder.create<mlir::AffineVectorStoreOp>(loc, ld.getResult(), packB, packWriteB, ivs);
+      }
+    );
+
+    // the MC x KC block of A, MR rows of a k next to each other. A is read along its rows.
+    auto packABuilder = Rewriter::getBuilder(ic, Position::begin);
+    auto packReadA = getAffineMap("packReadA", builder, blocking);
+    auto packWriteA = getAffineMap("packWriteA", builder, blocking);
+    mlir::buildAffineLoopNest(packABuilder, loc, mlir::SmallVector<int64_t, 3>(3, 0),
+      mlir::SmallVector<int64_t, 3>({blocking.mc / config.MR, config.MR, blocking.kc}),
+      mlir::SmallVector<int64_t, 3>(3, 1),
+      [&](mlir::OpBuilder &nestedBuilder, mlir::Location loc, mlir::ValueRange ivs) {
+        mlir::OpBuilder::InsertionGuard nestedGuard(nestedBuilder);
+        if (padded) {
+          auto ifOp = nestedBuilder.create<mlir::AffineIfOp>(loc, getIntegerSet("packRowA", builder, blocking),
+                        mlir::ValueRange({icIv, ivs[0], ivs[1]}), true);
+          nestedBuilder.setInsertionPointToStart(ifOp.getElseBlock());
+          nestedBuilder.create<mlir::AffineStoreOp>(loc, zero.getResult(), packA, packWriteA, ivs);
+          nestedBuilder.setInsertionPointToStart(ifOp.getThenBlock());
+        }
+        auto ld = nestedBuilder.create<mlir::AffineLoadOp>(loc, A, packReadA,
+                    mlir::ValueRange({icIv, pcIv, ivs[0], ivs[1], ivs[2]}));
+        nestedBuilder.create<mlir::AffineStoreOp>(loc, ld.getResult(), packA, packWriteA, ivs);
+      }
+    );
+    DUMP(module);
+
+    // micro-kernel: the MR x NR tile of C is carried through the k loop in MR x NR / width vector registers.
+    auto kernelBuilder = Rewriter::getBuilder(ir, Position::begin);
+    auto zeroVector = kernelBuilder.create<mlir::vector::BroadcastOp>(loc, vectorType, zero.getResult());
+    llvm::SmallVector<mlir::Value> inits(config.MR * vectors, zeroVector.getResult());
+    auto kernelBody = [&](mlir::OpBuilder &builder, mlir::Location nestedLoc, mlir::Value iv,
+                          mlir::ValueRange iterArgs) {
+      mlir::OpBuilder::InsertionGuard nestedGuard(builder);
+      std::vector<mlir::Value> rowB;
+      for (int64_t v = 0; v < vectors; v++) {
+        auto map = getAffineMap("loadPackB", builder, blocking, {v * config.VECTORIZE_WIDTH});
+        auto ld = builder.create<mlir::AffineVectorLoadOp>(loc, vectorType, packB, map, mlir::ValueRange({jrIv, iv}));
+        rowB.push_back(ld.getResult());
+      }
+      llvm::SmallVector<mlir::Value> results;
+      for (int64_t row = 0; row < config.MR; row++) {
+        auto map = getAffineMap("loadPackA", builder, blocking, {row});
+        auto ld = builder.create<mlir::AffineLoadOp>(loc, packA, map, mlir::ValueRange({irIv, iv}));
+        auto broadcast = builder.create<mlir::vector::BroadcastOp>(loc, vectorType, ld.getResult());
+        for (int64_t v = 0; v < vectors; v++) {
+          auto fma = builder.create<mlir::vector::FMAOp>(loc, broadcast.getResult(), rowB[v],
+                                                         iterArgs[row * vectors + v]);
+          results.push_back(fma.getResult());
+        }
+      }
+      builder.create<mlir::AffineYieldOp>(loc, results);
+    };
+    auto kLoop = kernelBuilder.create<mlir::AffineForOp>(loc, 0, blocking.kc, 1, inits, kernelBody);
+
+    for (int64_t row = 0; row < config.MR; row++) {
+      mlir::OpBuilder rowBuilder(kernelBuilder.getContext());
+      if (padded) {
+        auto ifOp = kernelBuilder.create<mlir::AffineIfOp>(loc, getIntegerSet("rowC", builder, blocking, {row}),
+                      mlir::ValueRange({icIv, irIv}), false);
+        rowBuilder.setInsertionPointToStart(ifOp.getThenBlock());
+      } else {
+        rowBuilder.setInsertionPoint(kernelBuilder.getInsertionBlock(), kernelBuilder.getInsertionPoint());
+      }
+      for (int64_t v = 0; v < vectors; v++) {
+        auto map = getAffineMap("tileC", builder, blocking, {row, v * config.VECTORIZE_WIDTH});
+        llvm::SmallVector<mlir::Value> operands({icIv, irIv, jcIv, jrIv});
+        auto ld = rowBuilder.create<mlir::AffineVectorLoadOp>(loc, vectorType, C, map, operands);
+        auto add = rowBuilder.create<mlir::arith::AddFOp>(loc, ld.getResult(), kLoop.getResult(row * vectors + v));
+        rowBuilder.create<mlir::AffineVectorStoreOp>(loc, add.getResult(), C, map, operands);
+      }
+    }
+    DUMP(module);
+
+    if (config.UNROLL_K > 1 && blocking.kc % config.UNROLL_K == 0) {
+      (void)mlir::loopUnrollByFactor(kLoop, config.UNROLL_K);
+    }
+    DUMP(module);
+  }
+}
+
 /*----------------------------binary---------------------------------*/
 
 std::vector<int64_t> getCreateAffineMapArgs(std::vector<mlir::AffineForOp> loops) {
@@ -587,7 +886,7 @@ std::vector<int64_t> getCreateAffineMapArgs(std::vector<mlir::AffineForOp> loops
 
 bool BinaryOptimizer::applicable(mlir::ModuleOp& module) {
   clear();
-  auto&& binaryFuncs = Analyzer::collectFunctions(module, "Binary");
+  auto&& binaryFuncs = filterTargets(Analyzer::collectFunctions(module, "Binary"));
   bool res = binaryFuncs.size() != 0 ? true : false;
 
   for (auto& binaryFunc : binaryFuncs) {
@@ -939,8 +1238,8 @@ void BinaryOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
 
     DUMP(module);
     // 循环切块大小
-    auto split_out_loops = Rewriter::split(new_loops[0], 3, {binaryConfig["THREAD_SIZE_M"], binaryConfig["BLOCK_SIZE_M"]});  // 第一个是一个thread计算的维度，第二个是一个block计算的多大的维度
-    auto split_in_loops = Rewriter::split(new_loops[1], 3, {binaryConfig["THREAD_SIZE_N"], binaryConfig["BLOCK_SIZE_N"]});   // 
+    auto split_out_loops = Rewriter::split(new_loops[0], 3, {binaryConfig.THREAD_SIZE_M, binaryConfig.BLOCK_SIZE_M});  // 第一个是一个thread计算的维度，第二个是一个block计算的多大的维度
+    auto split_in_loops = Rewriter::split(new_loops[1], 3, {binaryConfig.THREAD_SIZE_N, binaryConfig.BLOCK_SIZE_N});   // 
     DUMP(module);
 
     auto out_outer = split_out_loops[0], out_mider = split_out_loops[1], out_inner = split_out_loops[2];
@@ -959,8 +1258,8 @@ void BinaryOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
     auto blockElemIdx = Rewriter::getElementIdx(gridLevel);
     auto ThreadElemIdx = Rewriter::getElementIdx(blockLevel);
     
-    if (dimX % binaryConfig["THREAD_SIZE_N"] || dimY % binaryConfig["THREAD_SIZE_M"]) {
-      std::vector<int> range{dimY, dimX, binaryConfig["THREAD_SIZE_M"], binaryConfig["THREAD_SIZE_N"]};
+    if (dimX % binaryConfig.THREAD_SIZE_N || dimY % binaryConfig.THREAD_SIZE_M) {
+      std::vector<int> range{dimY, dimX, binaryConfig.THREAD_SIZE_M, binaryConfig.THREAD_SIZE_N};
       llvm::SmallVector<mlir::Value> operands{blockElemIdx[0], blockElemIdx[1], ThreadElemIdx[0], ThreadElemIdx[1]};  // by bx ty tx
       auto ifop = Rewriter::irregularMat(out_inner, range, operands);
       DUMP(module);
@@ -994,7 +1293,7 @@ void BinaryOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
 /*-----------------------------elementwise----------------------------*/
 bool ElementWiseOptimizer::applicable(mlir::ModuleOp& module) {
   clear();
-  auto&& elementWiseFuncs = Analyzer::collectFunctions(module, "Elementwise");
+  auto&& elementWiseFuncs = filterTargets(Analyzer::collectFunctions(module, "Elementwise"));
   bool res = elementWiseFuncs.size() != 0 ? true : false;
 
   for (auto& elementWiseFunc : elementWiseFuncs) {
@@ -1090,8 +1389,8 @@ void ElementWiseOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder
 
     DUMP(module);
     // 循环切块大小
-    auto split_out_loops = Rewriter::split(new_loops[0], 3, {elementWiseConfig["THREAD_SIZE_M"], elementWiseConfig["BLOCK_SIZE_M"]});
-    auto split_in_loops = Rewriter::split(new_loops[1], 3, {elementWiseConfig["THREAD_SIZE_M"], elementWiseConfig["BLOCK_SIZE_M"]});
+    auto split_out_loops = Rewriter::split(new_loops[0], 3, {elementWiseConfig.THREAD_SIZE_M, elementWiseConfig.BLOCK_SIZE_M});
+    auto split_in_loops = Rewriter::split(new_loops[1], 3, {elementWiseConfig.THREAD_SIZE_M, elementWiseConfig.BLOCK_SIZE_M});
     DUMP(module);
 
     auto out_outer = split_out_loops[0], out_mider = split_out_loops[1], out_inner = split_out_loops[2];
@@ -1110,8 +1409,8 @@ void ElementWiseOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder
       Rewriter::schedule(cst, blockLevel, Position::begin);
     });
 
-    if (dimX % elementWiseConfig["THREAD_SIZE_N"] || dimY % elementWiseConfig["THREAD_SIZE_M"]) {
-      std::vector<int> range{dimY, dimX, elementWiseConfig["THREAD_SIZE_M"], elementWiseConfig["THREAD_SIZE_N"]};
+    if (dimX % elementWiseConfig.THREAD_SIZE_N || dimY % elementWiseConfig.THREAD_SIZE_M) {
+      std::vector<int> range{dimY, dimX, elementWiseConfig.THREAD_SIZE_M, elementWiseConfig.THREAD_SIZE_N};
       llvm::SmallVector<mlir::Value> operands{blockElemIdx[0], blockElemIdx[1], ThreadElemIdx[0], ThreadElemIdx[1]};  // by bx ty tx
       auto ifop = Rewriter::irregularMat(out_inner, range, operands);
       DUMP(module);
@@ -1127,21 +1426,21 @@ void ElementWiseOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder
         auto output_type = output.getType();
         auto element_ = output_type.dyn_cast<mlir::MemRefType>().getElementType();
         auto noVectorLoadOrStore = getAffineMap("NoVectorLoadOrStore", builder, extras);
-        auto frag = Rewriter::alloc_buffer(/*parallelLevel*/blockLevel, MemorySpace::local, {elementWiseConfig["THREAD_SIZE_N"]}, element);  // 计算input -> reg
-        auto frag_ = Rewriter::alloc_buffer(/*parallelLevel*/blockLevel, MemorySpace::local, {elementWiseConfig["THREAD_SIZE_N"]}, element_);  // 计算input -> reg
+        auto frag = Rewriter::alloc_buffer(/*parallelLevel*/blockLevel, MemorySpace::local, {elementWiseConfig.THREAD_SIZE_N}, element);  // 计算input -> reg
+        auto frag_ = Rewriter::alloc_buffer(/*parallelLevel*/blockLevel, MemorySpace::local, {elementWiseConfig.THREAD_SIZE_N}, element_);  // 计算input -> reg
         if (toStr(element) == "float32") {
-          Rewriter::read(input, frag, loadOrStoreMap, operands, elementWiseConfig["VECTORIZE_WIDTH"], out_inner, Position::begin);
+          Rewriter::read(input, frag, loadOrStoreMap, operands, elementWiseConfig.VECTORIZE_WIDTH, out_inner, Position::begin);
           Rewriter::write(frag_, output, noVectorLoadOrStore, operands, in_inner, Position::after);
         } else if (toStr(element_) == "float32"){
           Rewriter::read(input, frag, noVectorLoadOrStore, operands, out_inner, Position::begin);
-          Rewriter::write(frag_, output, loadOrStoreMap, operands, elementWiseConfig["VECTORIZE_WIDTH"], in_inner, Position::after);
+          Rewriter::write(frag_, output, loadOrStoreMap, operands, elementWiseConfig.VECTORIZE_WIDTH, in_inner, Position::after);
         }
         Rewriter::cache_read(in_inner, input, frag, pointLoadOrStore, {in_inner.getInductionVar()});
         Rewriter::cache_write(in_inner, output, frag_, pointLoadOrStore, {in_inner.getInductionVar()});
       } else {
-        auto frag = Rewriter::alloc_buffer(/*parallelLevel*/blockLevel, MemorySpace::local, {elementWiseConfig["THREAD_SIZE_N"]}, element);  // 计算input -> reg
-        Rewriter::read(input, frag, loadOrStoreMap, operands, elementWiseConfig["VECTORIZE_WIDTH"], out_inner, Position::begin);
-        Rewriter::write(frag, input, loadOrStoreMap, operands, elementWiseConfig["VECTORIZE_WIDTH"], in_inner, Position::after);
+        auto frag = Rewriter::alloc_buffer(/*parallelLevel*/blockLevel, MemorySpace::local, {elementWiseConfig.THREAD_SIZE_N}, element);  // 计算input -> reg
+        Rewriter::read(input, frag, loadOrStoreMap, operands, elementWiseConfig.VECTORIZE_WIDTH, out_inner, Position::begin);
+        Rewriter::write(frag, input, loadOrStoreMap, operands, elementWiseConfig.VECTORIZE_WIDTH, in_inner, Position::after);
         Rewriter::cache_read(in_inner, input, frag, pointLoadOrStore, {in_inner.getInductionVar()});
         Rewriter::cache_write(in_inner, input, frag, pointLoadOrStore, {in_inner.getInductionVar()});
       }
@@ -1178,7 +1477,7 @@ void ElementWiseOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder
 /*----------------------------layernorm-------------------------------*/
 bool LayerNormOptimizer::applicable(mlir::ModuleOp& module) {
   clear();
-  auto&& layerNormFuncs = Analyzer::collectFunctions(module, "LayerNorm");
+  auto&& layerNormFuncs = filterTargets(Analyzer::collectFunctions(module, "LayerNorm"));
   bool res = layerNormFuncs.size() != 0 ? true : false;
 
   for (auto& layerNormFunc : layerNormFuncs) {
@@ -1379,7 +1678,7 @@ std::vector<mlir::AffineForOp> LayerNormOptimizer::read(mlir::AffineForOp forOp,
 
   auto storeOp = builder.create<mlir::AffineStoreOp>(builder.getUnknownLoc(), loadOp.getResult(), buffers[0], storeMap, storeOperand);
   mlir::AffineForOp firstLoop;
-  if (totalDim >= 4) firstLoop = Rewriter::vectorize(oneForOp, layerNormConfig["VECTORIZE_WIDTH"]);
+  if (totalDim >= 4) firstLoop = Rewriter::vectorize(oneForOp, layerNormConfig.VECTORIZE_WIDTH);
   else firstLoop = oneForOp;
   loops.push_back(firstLoop);
 
@@ -1825,9 +2124,9 @@ void LayerNormOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder&
     auto iterBuffer2 = Rewriter::bufferizeLoopCarryVar(sonLoop2, outLoop.getBody());
     DUMP(module);
 
-    auto split_loops1 = Rewriter::split(sonLoop1, 3, {layerNormConfig["THREAD_SIZE"], layerNormConfig["BLOCK_SIZE"]});
-    auto split_loops2 = Rewriter::split(sonLoop2, 3, {layerNormConfig["THREAD_SIZE"], layerNormConfig["BLOCK_SIZE"]});
-    auto split_loops3 = Rewriter::split(sonLoop3, 3, {layerNormConfig["THREAD_SIZE"], layerNormConfig["BLOCK_SIZE"]});
+    auto split_loops1 = Rewriter::split(sonLoop1, 3, {layerNormConfig.THREAD_SIZE, layerNormConfig.BLOCK_SIZE});
+    auto split_loops2 = Rewriter::split(sonLoop2, 3, {layerNormConfig.THREAD_SIZE, layerNormConfig.BLOCK_SIZE});
+    auto split_loops3 = Rewriter::split(sonLoop3, 3, {layerNormConfig.THREAD_SIZE, layerNormConfig.BLOCK_SIZE});
     DUMP(module);
 
     // split_loops1[1]，split_loops2[1]，split_loops3[1] no exist
@@ -1852,9 +2151,9 @@ void LayerNormOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder&
 
     auto input_type = input.getType();
     auto element = input_type.dyn_cast<mlir::MemRefType>().getElementType();
-    auto tempArray = Rewriter::alloc_buffer(gridLevel, MemorySpace::shared, {layerNormConfig["BLOCK_SIZE"]}, element);
-    auto tempScaleArray = Rewriter::alloc_buffer(gridLevel, MemorySpace::shared, {layerNormConfig["BLOCK_SIZE"]}, element);
-    auto tempBiasArray = Rewriter::alloc_buffer(gridLevel, MemorySpace::shared, {layerNormConfig["BLOCK_SIZE"]}, element);
+    auto tempArray = Rewriter::alloc_buffer(gridLevel, MemorySpace::shared, {layerNormConfig.BLOCK_SIZE}, element);
+    auto tempScaleArray = Rewriter::alloc_buffer(gridLevel, MemorySpace::shared, {layerNormConfig.BLOCK_SIZE}, element);
+    auto tempBiasArray = Rewriter::alloc_buffer(gridLevel, MemorySpace::shared, {layerNormConfig.BLOCK_SIZE}, element);
     auto frontLoops1 = read(split_loops1[2], {tempArray, input}); // 从input取数存到shared，且进行向量化
     auto frontLoops2 = read(split_loops2[2], {tempArray, input});
     auto frontLoops3 = read(split_loops3[2], {tempArray, output});
@@ -1933,7 +2232,7 @@ void LayerNormOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder&
 /*-----------------------------gather----------------------------*/
 bool GatherOptimizer::applicable(mlir::ModuleOp& module) {
   clear();
-  auto&& gatherFuncs = Analyzer::collectFunctions(module, "Gather");
+  auto&& gatherFuncs = filterTargets(Analyzer::collectFunctions(module, "Gather"));
   bool res = gatherFuncs.size() != 0 ? true : false;
 
   for (auto& gatherFunc : gatherFuncs) {
@@ -2019,8 +2318,8 @@ void GatherOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
     extras.push_back(twoLoops[1].getUpperBoundMap().getSingleConstantResult());
     DUMP(module);
 
-    auto split_out_loops = Rewriter::split(twoLoops[0], 3, {gatherConfig["THREAD_SIZE_M"], gatherConfig["BLOCK_SIZE_M"]});
-    auto split_in_loops = Rewriter::split(twoLoops[1], 3, {gatherConfig["THREAD_SIZE_M"], gatherConfig["BLOCK_SIZE_M"]});
+    auto split_out_loops = Rewriter::split(twoLoops[0], 3, {gatherConfig.THREAD_SIZE_M, gatherConfig.BLOCK_SIZE_M});
+    auto split_in_loops = Rewriter::split(twoLoops[1], 3, {gatherConfig.THREAD_SIZE_M, gatherConfig.BLOCK_SIZE_M});
     DUMP(module);
 
     auto out_outer = split_out_loops[0], out_mider = split_out_loops[1], out_inner = split_out_loops[2];
@@ -2045,12 +2344,12 @@ void GatherOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& bui
     } else {
       auto input_type = input.getType();
       auto element = input_type.dyn_cast<mlir::MemRefType>().getElementType();
-      auto storeReg = Rewriter::alloc_buffer(blockLevel, MemorySpace::local, {gatherConfig["THREAD_SIZE_N"]}, element);  // 计算input -> reg
+      auto storeReg = Rewriter::alloc_buffer(blockLevel, MemorySpace::local, {gatherConfig.THREAD_SIZE_N}, element);  // 计算input -> reg
       auto writeMap = getAffineMap("VectorLoadOrStore", builder, extras);
       auto cacheWriteMap = getAffineMap("PointLoadOrStore", builder);
 
       llvm::SmallVector<mlir::Value> operands({blockElemIdx[0], ThreadElemIdx[0], out_inner.getInductionVar(), blockElemIdx[1], ThreadElemIdx[1]});
-      Rewriter::write(storeReg, output, writeMap, operands, gatherConfig["VECTORIZE_WIDTH"], in_inner, Position::after);
+      Rewriter::write(storeReg, output, writeMap, operands, gatherConfig.VECTORIZE_WIDTH, in_inner, Position::after);
       Rewriter::cache_write(in_inner, output, storeReg, cacheWriteMap, {in_inner.getInductionVar()});
     }
 
@@ -2118,6 +2417,7 @@ bool FMHAOptimizer::applicable(mlir::ModuleOp& module) {
     auto call2Matmul = funcCalls[i];
     // auto func = call.getCalleeAttrName().str();
     auto funcName = call2Matmul.getCallee().str();
+    if (!isTarget(funcName)) continue;
     if (funcName.find(std::string("BatchMatmul")) != std::string::npos) {
       auto matmul = Analyzer::getTargetFunction(module, funcName);
       auto attr = matmul->getAttr(std::string("func.state")).dyn_cast<mlir::StringAttr>();
@@ -2196,6 +2496,7 @@ bool FMHAOptimizer::applicable(mlir::ModuleOp& module) {
       }
     }
   }
+  return call2callsMap.size() != 0;
 }
 
 mlir::AffineMap FMHAOptimizer::getAffineMap(const std::string& mapIdentifier, mlir::OpBuilder& builder) {
@@ -2207,17 +2508,17 @@ mlir::AffineMap FMHAOptimizer::getAffineMap(const std::string& mapIdentifier, ml
   auto dim5 = builder.getAffineDimExpr(5);
   auto dim6 = builder.getAffineDimExpr(6);
   auto dim7 = builder.getAffineDimExpr(7);
-  int64_t BLOCK_SIZE = fmhaConfig["BLOCK_SIZE"];
-  int width = fmhaConfig["Width"];
+  int64_t BLOCK_SIZE = fmhaConfig.BLOCK_SIZE;
+  int width = fmhaConfig.Width;
 
   // std::vector<int64_t> warpOrg {2, 4};
   // std::vector<int64_t> threadOrg {8, 4};
 
-  const int LaneX_S = fmhaConfig["Bc"] / fmhaConfig["BcTileS"];
-  const int LaneY_S = fmhaConfig["WARP_SIZE"] / LaneX_S;
+  const int LaneX_S = fmhaConfig.Bc / fmhaConfig.BcTileS;
+  const int LaneY_S = fmhaConfig.WARP_SIZE / LaneX_S;
 
-  const int LaneX_O = fmhaConfig["Hd"] / fmhaConfig["HdTileO"] / fmhaConfig["WarpX_O"];
-  const int LaneY_O = fmhaConfig["WARP_SIZE"] / LaneX_O;
+  const int LaneX_O = fmhaConfig.Hd / fmhaConfig.HdTileO / fmhaConfig.WarpX_O;
+  const int LaneY_O = fmhaConfig.WARP_SIZE / LaneX_O;
 
   if (mapIdentifier == "loadTileQ") {
     // dims are:[dim0, dim1, dim2, dim3, dim4, dim5]
@@ -2225,12 +2526,12 @@ mlir::AffineMap FMHAOptimizer::getAffineMap(const std::string& mapIdentifier, ml
     // iv represent a block copy for iv times. 
     auto threadIdExpr = dim3;
     auto vThreadIdExpr = threadIdExpr + dim5 * BLOCK_SIZE;
-    auto Br_Offset = vThreadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["Slice"]) / width);
-    auto Hd_Offset = vThreadIdExpr % (static_cast<uint64_t>(fmhaConfig["Slice"]) / width); 
+    auto Br_Offset = vThreadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.Slice) / width);
+    auto Hd_Offset = vThreadIdExpr % (static_cast<uint64_t>(fmhaConfig.Slice) / width); 
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(dim0);
     exprs.push_back(dim1);
-    exprs.push_back(dim2 * fmhaConfig["Br"] + Br_Offset);
+    exprs.push_back(dim2 * fmhaConfig.Br + Br_Offset);
     exprs.push_back(dim4 + Hd_Offset * width);
     return mlir::AffineMap::get(/*dimCount*/6, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());
   } else if (mapIdentifier == "loadTileK") {
@@ -2239,8 +2540,8 @@ mlir::AffineMap FMHAOptimizer::getAffineMap(const std::string& mapIdentifier, ml
     // iv represent a block copy for iv times. 
     auto threadIdExpr = dim2;
     auto vThreadIdExpr = threadIdExpr + dim5 * BLOCK_SIZE;
-    auto Bc_Offset = vThreadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["Slice"]) / width);
-    auto Hd_Offset = vThreadIdExpr % (static_cast<uint64_t>(fmhaConfig["Slice"]) / width); 
+    auto Bc_Offset = vThreadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.Slice) / width);
+    auto Hd_Offset = vThreadIdExpr % (static_cast<uint64_t>(fmhaConfig.Slice) / width); 
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(dim0);
     exprs.push_back(dim1);
@@ -2252,8 +2553,8 @@ mlir::AffineMap FMHAOptimizer::getAffineMap(const std::string& mapIdentifier, ml
     // operands are: [threadIdx.x, iv, ivInVector]
     auto threadIdExpr = dim0;
     auto vThreadIdExpr = threadIdExpr + dim1 * BLOCK_SIZE;
-    auto Br_Offset = vThreadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["Slice"]) / width);
-    auto Hd_Offset = vThreadIdExpr % (static_cast<uint64_t>(fmhaConfig["Slice"]) / width);
+    auto Br_Offset = vThreadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.Slice) / width);
+    auto Hd_Offset = vThreadIdExpr % (static_cast<uint64_t>(fmhaConfig.Slice) / width);
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(Hd_Offset * width + dim2);
     exprs.push_back(Br_Offset);
@@ -2263,8 +2564,8 @@ mlir::AffineMap FMHAOptimizer::getAffineMap(const std::string& mapIdentifier, ml
     // operands are: [threadIdx.x, iv, ivInVector]
     auto threadIdExpr = dim0;
     auto vThreadIdExpr = threadIdExpr + dim1 * BLOCK_SIZE;
-    auto Bc_Offset = vThreadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["Slice"]) / width);
-    auto Hd_Offset = vThreadIdExpr % (static_cast<uint64_t>(fmhaConfig["Slice"]) / width);
+    auto Bc_Offset = vThreadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.Slice) / width);
+    auto Hd_Offset = vThreadIdExpr % (static_cast<uint64_t>(fmhaConfig.Slice) / width);
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(Hd_Offset * width + dim2);
     exprs.push_back(Bc_Offset);
@@ -2273,21 +2574,21 @@ mlir::AffineMap FMHAOptimizer::getAffineMap(const std::string& mapIdentifier, ml
     // dims are:[dim0, dim1, dim2]
     // operands are: [threadIdx.x, hd_inner, iv]
     auto threadIdExpr = dim0;
-    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]));
-    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]);
+    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.WARP_SIZE));
+    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig.WARP_SIZE);
 
     auto ylane_s = laneId.floorDiv(LaneX_S);
 
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(dim1);
-    exprs.push_back(warpId * LaneY_S * fmhaConfig["BrTileS"] + dim2 * LaneY_S * width + ylane_s * width);
+    exprs.push_back(warpId * LaneY_S * fmhaConfig.BrTileS + dim2 * LaneY_S * width + ylane_s * width);
     return mlir::AffineMap::get(/*dimCount*/3, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());    
   } else if (mapIdentifier == "loadFragK") {
     // dims are:[dim0, dim1, dim2]
     // operands are: [threadIdx.x, hd_inner, iv]
     auto threadIdExpr = dim0;
-    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]));
-    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]);
+    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.WARP_SIZE));
+    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig.WARP_SIZE);
 
     auto xlane_s = laneId % (LaneX_S);
 
@@ -2299,25 +2600,25 @@ mlir::AffineMap FMHAOptimizer::getAffineMap(const std::string& mapIdentifier, ml
     // dims are:[dim0, dim1]
     // operands are: [threadIdx.x, iv]
     auto threadIdExpr = dim0;
-    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]));
-    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]);
+    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.WARP_SIZE));
+    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig.WARP_SIZE);
 
     auto ylane_s = laneId.floorDiv(LaneX_S);
     llvm::SmallVector<mlir::AffineExpr> exprs;
-    exprs.push_back(warpId * LaneY_S * fmhaConfig["BrTileS"] + dim1.floorDiv(width) * LaneY_S * width + ylane_s * width + dim1 % width);
+    exprs.push_back(warpId * LaneY_S * fmhaConfig.BrTileS + dim1.floorDiv(width) * LaneY_S * width + ylane_s * width + dim1 % width);
     return mlir::AffineMap::get(/*dimCount*/2, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext()); 
   } else if (mapIdentifier == "storeTileP") {
     // dims are:[dim0, dim1, dim2]
     // operands are: [threadIdx.x, bc, br]
     auto threadIdExpr = dim0;
-    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]));
-    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]);
+    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.WARP_SIZE));
+    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig.WARP_SIZE);
 
     auto ylane_s = laneId.floorDiv(LaneX_S);
     auto xlane_s = laneId % (LaneX_S);
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(dim1.floorDiv(width) * LaneX_S * width + xlane_s * width + dim1 % width);
-    exprs.push_back(warpId * LaneY_S * fmhaConfig["BrTileS"] + dim2 * LaneY_S + ylane_s * width);
+    exprs.push_back(warpId * LaneY_S * fmhaConfig.BrTileS + dim2 * LaneY_S + ylane_s * width);
     return mlir::AffineMap::get(/*dimCount*/3, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext()); 
   } else if (mapIdentifier == "readTileS") {
     // dims are:[dim0, dim1]
@@ -2330,16 +2631,16 @@ mlir::AffineMap FMHAOptimizer::getAffineMap(const std::string& mapIdentifier, ml
     // dims are:[dim0, dim1]
     // operands are: [threadIdx.x, br]
     auto threadIdExpr = dim0;
-    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]));
-    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]);
+    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.WARP_SIZE));
+    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig.WARP_SIZE);
 
-    auto xwarp_o = warpId % fmhaConfig["WarpX_O"];
-    auto ywarp_o = warpId.floorDiv(fmhaConfig["WarpX_O"]);
+    auto xwarp_o = warpId % fmhaConfig.WarpX_O;
+    auto ywarp_o = warpId.floorDiv(fmhaConfig.WarpX_O);
 
     auto ylane_o = laneId.floorDiv(LaneX_O);
 
     llvm::SmallVector<mlir::AffineExpr> exprs;
-    exprs.push_back(ywarp_o * LaneY_O * fmhaConfig["BrTileO"] + dim1 * LaneY_O * width + ylane_o * width);
+    exprs.push_back(ywarp_o * LaneY_O * fmhaConfig.BrTileO + dim1 * LaneY_O * width + ylane_o * width);
     return mlir::AffineMap::get(/*dimCount*/2, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());
   } else if (mapIdentifier == "loadTileV") {
     // dims are:[dim0, dim1, dim2, dim3, dim4, dim5]
@@ -2347,8 +2648,8 @@ mlir::AffineMap FMHAOptimizer::getAffineMap(const std::string& mapIdentifier, ml
     // iv represent a block copy for iv times. 
     auto threadIdExpr = dim2;
     auto vThreadIdExpr = threadIdExpr + dim5 * BLOCK_SIZE;
-    auto Bc_Offset = vThreadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["Hd"]) / width);
-    auto Hd_Offset = vThreadIdExpr % (static_cast<uint64_t>(fmhaConfig["Hd"]) / width); 
+    auto Bc_Offset = vThreadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.Hd) / width);
+    auto Hd_Offset = vThreadIdExpr % (static_cast<uint64_t>(fmhaConfig.Hd) / width); 
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(dim0);
     exprs.push_back(dim1);
@@ -2360,8 +2661,8 @@ mlir::AffineMap FMHAOptimizer::getAffineMap(const std::string& mapIdentifier, ml
     // operands are: [threadIdx.x, iv]
     auto threadIdExpr = dim0;
     auto vThreadIdExpr = threadIdExpr + dim1 * BLOCK_SIZE;
-    auto Bc_Offset = vThreadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["Hd"]) / width);
-    auto Hd_Offset = vThreadIdExpr % (static_cast<uint64_t>(fmhaConfig["Hd"]) / width);
+    auto Bc_Offset = vThreadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.Hd) / width);
+    auto Hd_Offset = vThreadIdExpr % (static_cast<uint64_t>(fmhaConfig.Hd) / width);
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(Bc_Offset);
     exprs.push_back(Hd_Offset * width);
@@ -2370,65 +2671,65 @@ mlir::AffineMap FMHAOptimizer::getAffineMap(const std::string& mapIdentifier, ml
     // dims are:[dim0, dim1, dim2, dim3]
     // operands are: [threadIdx.x, bc_outer, bc_inner, iv]
     auto threadIdExpr = dim0;
-    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]));
-    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]);
+    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.WARP_SIZE));
+    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig.WARP_SIZE);
 
-    auto ywarp_o = warpId.floorDiv(fmhaConfig["WarpX_O"]);
+    auto ywarp_o = warpId.floorDiv(fmhaConfig.WarpX_O);
 
     auto ylane_o = laneId.floorDiv(LaneX_O);
 
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(dim1 + dim2);
-    exprs.push_back(ywarp_o * LaneY_O * fmhaConfig["BrTileO"] + dim3 * width * LaneY_O + ylane_o * width);
+    exprs.push_back(ywarp_o * LaneY_O * fmhaConfig.BrTileO + dim3 * width * LaneY_O + ylane_o * width);
     return mlir::AffineMap::get(/*dimCount*/4, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());   
   } else if (mapIdentifier == "loadFragV") {
     // dims are:[dim0, dim1, dim2]
     // operands are: [threadIdx.x, bc_inner, iv]
     auto threadIdExpr = dim0;
-    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]));
-    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]);
+    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.WARP_SIZE));
+    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig.WARP_SIZE);
 
-    auto xwarp_o = warpId % fmhaConfig["WarpX_O"];
+    auto xwarp_o = warpId % fmhaConfig.WarpX_O;
     auto xlane_o = laneId % LaneX_O;
 
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(dim1);
-    exprs.push_back(xwarp_o * LaneX_O * fmhaConfig["HdTileO"] + dim2 * width * LaneX_O + xlane_o * width);
+    exprs.push_back(xwarp_o * LaneX_O * fmhaConfig.HdTileO + dim2 * width * LaneX_O + xlane_o * width);
     return mlir::AffineMap::get(/*dimCount*/3, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());   
   } else if (mapIdentifier == "brIdxO") {
     // dims are:[dim0, dim1]
     // operands are: [threadIdx.x, iv]
     auto threadIdExpr = dim0;
-    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]));
-    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]);
+    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.WARP_SIZE));
+    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig.WARP_SIZE);
 
-    auto ywarp_o = warpId.floorDiv(fmhaConfig["WarpX_O"]);
+    auto ywarp_o = warpId.floorDiv(fmhaConfig.WarpX_O);
 
     auto ylane_o = laneId.floorDiv(LaneX_O);
 
     llvm::SmallVector<mlir::AffineExpr> exprs;
-    exprs.push_back(ywarp_o * LaneY_O * fmhaConfig["BrTileO"] + dim1 * LaneY_O * width + ylane_o * width);
+    exprs.push_back(ywarp_o * LaneY_O * fmhaConfig.BrTileO + dim1 * LaneY_O * width + ylane_o * width);
     return mlir::AffineMap::get(/*dimCount*/2, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext()); 
   } else if (mapIdentifier == "storeTileO") {
     // dims are:[dim0, dim1, dim2, dim3, dim4, dim5]
     // operands are: [blockIdx.z, blockIdx.y, blockIdx.x, threadIdx.x, br, hd]
     auto threadIdExpr = dim0;
-    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]));
-    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig["WARP_SIZE"]);
+    auto warpId = threadIdExpr.floorDiv(static_cast<uint64_t>(fmhaConfig.WARP_SIZE));
+    auto laneId = threadIdExpr % static_cast<uint64_t>(fmhaConfig.WARP_SIZE);
 
-    auto xwarp_o = warpId % fmhaConfig["WarpX_O"];
-    auto ywarp_o = warpId.floorDiv(fmhaConfig["WarpX_O"]);
+    auto xwarp_o = warpId % fmhaConfig.WarpX_O;
+    auto ywarp_o = warpId.floorDiv(fmhaConfig.WarpX_O);
 
     auto ylane_o = laneId.floorDiv(LaneX_O);
     auto xlane_o = laneId % (LaneX_O);
 
-    auto Br_Offset = ywarp_o * LaneY_O * fmhaConfig["BrTileO"] + dim4.floorDiv(width) * width * LaneY_O + ylane_o * width + dim4 % width;
-    auto Hd_Offset = xwarp_o * LaneX_O * fmhaConfig["HdTileO"] + dim5 * LaneX_O + xlane_o * width;
+    auto Br_Offset = ywarp_o * LaneY_O * fmhaConfig.BrTileO + dim4.floorDiv(width) * width * LaneY_O + ylane_o * width + dim4 % width;
+    auto Hd_Offset = xwarp_o * LaneX_O * fmhaConfig.HdTileO + dim5 * LaneX_O + xlane_o * width;
 
     llvm::SmallVector<mlir::AffineExpr> exprs;
     exprs.push_back(dim0);
     exprs.push_back(dim1);
-    exprs.push_back(dim2 * fmhaConfig["Br"] + Br_Offset);
+    exprs.push_back(dim2 * fmhaConfig.Br + Br_Offset);
     exprs.push_back(Hd_Offset);
     return mlir::AffineMap::get(/*dimCount*/6, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), builder.getContext());
   } else {
@@ -2474,13 +2775,13 @@ void initMaxSum(mlir::OpBuilder& builder, int64_t lowerBound, int64_t upperBound
 
 void FMHAOptimizer::softmaxIR(mlir::OpBuilder& builder, mlir::Value tileS, mlir::Value rowMax, mlir::Value smMax, mlir::Value rowSum, 
   mlir::Value smSum, mlir::Value smFac, mlir::Value zero, mlir::Value flt_min, mlir::Value tid) {
-  auto br_loop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["BrTileS"], 1);
+  auto br_loop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.BrTileS, 1);
   auto br = br_loop.getInductionVar();
   builder.setInsertionPointToStart(br_loop.getBody());
   builder.create<mlir::AffineStoreOp>(builder.getUnknownLoc(), flt_min, rowMax, mlir::ValueRange({br}));
   builder.create<mlir::AffineStoreOp>(builder.getUnknownLoc(), zero, rowSum, mlir::ValueRange({br}));
 
-  auto bc_loop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["BcTileS"], 1);
+  auto bc_loop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.BcTileS, 1);
   auto bc = bc_loop.getInductionVar();
   builder.setInsertionPointToStart(bc_loop.getBody());
 
@@ -2501,18 +2802,18 @@ void FMHAOptimizer::softmaxIR(mlir::OpBuilder& builder, mlir::Value tileS, mlir:
   builder.create<mlir::AffineStoreOp>(builder.getUnknownLoc(), tmp11.getResult(), rowMax, mlir::ValueRange({br}));
   
   builder.setInsertionPointAfter(br_loop);
-  auto br_shfl_loop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["BrTileS"], 1);
+  auto br_shfl_loop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.BrTileS, 1);
   auto br_sf = br_shfl_loop.getInductionVar();
   builder.setInsertionPointToStart(br_shfl_loop.getBody());
 
-  for (int i = 1; i < fmhaConfig["Bc"] / fmhaConfig["BcTileS"]; i *= 2) {
+  for (int i = 1; i < fmhaConfig.Bc / fmhaConfig.BcTileS; i *= 2) {
     auto tmp1 = builder.create<mlir::AffineLoadOp>(builder.getUnknownLoc(), rowMax, mlir::ValueRange({br_sf}));
     auto tmp2 = builder.create<mlir::AffineLoadOp>(builder.getUnknownLoc(), rowSum, mlir::ValueRange({br_sf}));
 
     auto tmp3 = builder.create<mlir::gpu::ShuffleOp>(builder.getUnknownLoc(), tmp1.getResult(), i, 
-        fmhaConfig["Bc"] / fmhaConfig["BcTileS"], mlir::gpu::ShuffleMode::DOWN);
+        fmhaConfig.Bc / fmhaConfig.BcTileS, mlir::gpu::ShuffleMode::DOWN);
     auto tmp4 = builder.create<mlir::gpu::ShuffleOp>(builder.getUnknownLoc(), tmp2.getResult(), i, 
-        fmhaConfig["Bc"] / fmhaConfig["BcTileS"], mlir::gpu::ShuffleMode::DOWN);
+        fmhaConfig.Bc / fmhaConfig.BcTileS, mlir::gpu::ShuffleMode::DOWN);
     
     auto tmp5 = builder.create<mlir::arith::MaxFOp>(builder.getUnknownLoc(), tmp1.getResult(), tmp3.getResult(0));
 
@@ -2536,13 +2837,13 @@ void FMHAOptimizer::softmaxIR(mlir::OpBuilder& builder, mlir::Value tileS, mlir:
   // iv + 2 * step <= ub
   //-> ub - 2 * step - iv >= 0
   auto dim0 = builder.getAffineDimExpr(0);
-  exprs.push_back(dim0 % (fmhaConfig["Bc"] / fmhaConfig["BcTileS"]));
+  exprs.push_back(dim0 % (fmhaConfig.Bc / fmhaConfig.BcTileS));
   eqFlags.push_back(true);///< true: == 0, false: >= 0
   auto cst = mlir::IntegerSet::get(1, 0, llvm::ArrayRef<mlir::AffineExpr>(exprs), llvm::ArrayRef<bool>(eqFlags));
   auto ifOp = builder.create<mlir::AffineIfOp>(builder.getUnknownLoc(), cst, mlir::ValueRange{tid}, /*withElseRegion=*/false);
   builder.setInsertionPointToStart(ifOp.getBody());
 
-  auto br_wb_loop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["BrTileS"], 1);
+  auto br_wb_loop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.BrTileS, 1);
   auto br_wb = br_wb_loop.getInductionVar();
   builder.setInsertionPointToStart(br_wb_loop.getBody());
 
@@ -2572,23 +2873,23 @@ void FMHAOptimizer::softmaxIR(mlir::OpBuilder& builder, mlir::Value tileS, mlir:
   builder.setInsertionPointAfter(ifOp);
   ///< Write P to shared memory.
   ///< Update rowMax within the same row.
-  auto br_broadcast_loop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["BrTileS"], 1);
+  auto br_broadcast_loop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.BrTileS, 1);
   auto br_broadcast = br_broadcast_loop.getInductionVar();
   builder.setInsertionPointToStart(br_broadcast_loop.getBody());
   {
   auto tmp1 = builder.create<mlir::AffineLoadOp>(builder.getUnknownLoc(), rowMax, mlir::ValueRange({br_broadcast}));
   auto tmp2 = builder.create<mlir::gpu::ShuffleOp>(builder.getUnknownLoc(), tmp1.getResult(), 0, 
-      fmhaConfig["Bc"] / fmhaConfig["BcTileS"], mlir::gpu::ShuffleMode::IDX);
+      fmhaConfig.Bc / fmhaConfig.BcTileS, mlir::gpu::ShuffleMode::IDX);
   builder.create<mlir::AffineStoreOp>(builder.getUnknownLoc(), tmp2.getResult(0), rowMax, mlir::ValueRange({br_broadcast}));
   }
   builder.setInsertionPointAfter(br_broadcast_loop);
   
   ///< factor each element by exp.
   ///< tileS[bc][br] = exp(tileS[bc][br] - rowMax[br]);
-  auto outerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["BcTileS"], 1);
+  auto outerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.BcTileS, 1);
   auto ip = builder.saveInsertionPoint();
   builder.setInsertionPointToStart(outerLoop.getBody());
-  auto innerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["BrTileS"], 1);
+  auto innerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.BrTileS, 1);
   builder.setInsertionPointToStart(innerLoop.getBody());
   {
     auto bc = outerLoop.getInductionVar();
@@ -2661,17 +2962,17 @@ void FMHAOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& build
     for (auto b : matmul1Desc.batch) bounds.push_back(b);
 
     auto Hd = head_dim;
-    auto Br = fmhaConfig["HdxBr"] / Hd;
-    auto Bc = fmhaConfig["BrxBc"] / Br;
-    auto Slice = fmhaConfig["Slice"];
-    auto BLOCK_SIZE = fmhaConfig["BLOCK_SIZE"];
+    auto Br = fmhaConfig.HdxBr / Hd;
+    auto Bc = fmhaConfig.BrxBc / Br;
+    auto Slice = fmhaConfig.Slice;
+    auto BLOCK_SIZE = fmhaConfig.BLOCK_SIZE;
 
-    fmhaConfig["Hd"] = Hd;
-    fmhaConfig["Br"] = Br;
-    fmhaConfig["Bc"] = Bc;
+    fmhaConfig.Hd = Hd;
+    fmhaConfig.Br = Br;
+    fmhaConfig.Bc = Bc;
 
     bounds.push_back(seq_len / Br);
-    bounds.push_back(fmhaConfig["BLOCK_SIZE"]);
+    bounds.push_back(fmhaConfig.BLOCK_SIZE);
 
     mlir::SmallVector<int64_t, 8> lowerBounds(bounds.size(), /*Value=*/0);
     mlir::SmallVector<int64_t, 8> steps(bounds.size(), /*Value=*/1);
@@ -2697,10 +2998,10 @@ void FMHAOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& build
     auto smSum = Rewriter::alloc_buffer(/*parallelLevel*/blockLevel, MemorySpace::shared, {Br}, elementType);
     auto smFac = Rewriter::alloc_buffer(/*parallelLevel*/blockLevel, MemorySpace::shared, {Br}, elementType);
 
-    auto BrTileS = fmhaConfig["BrTileS"];
-    auto BcTileS = fmhaConfig["BcTileS"];
-    auto BrTileO = fmhaConfig["BrTileO"];
-    auto HdTileO = fmhaConfig["HdTileO"];
+    auto BrTileS = fmhaConfig.BrTileS;
+    auto BcTileS = fmhaConfig.BcTileS;
+    auto BrTileO = fmhaConfig.BrTileO;
+    auto HdTileO = fmhaConfig.HdTileO;
 
     auto tileO = Rewriter::alloc_buffer(/*parallelLevel*/blockLevel, MemorySpace::local, {BrTileO, HdTileO}, elementType);
 
@@ -2731,11 +3032,11 @@ void FMHAOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& build
     builder.setInsertionPointAfter(bar1);
 
     Rewriter::read(builder, Q, ldgQ, getAffineMap("loadTileQ", builder), {gridLevel.getIVs()[0], gridLevel.getIVs()[1], 
-      gridLevel.getIVs()[2], blockLevel.getIVs()[0], hd_outer.getInductionVar()}, fmhaConfig["Width"]);
+      gridLevel.getIVs()[2], blockLevel.getIVs()[0], hd_outer.getInductionVar()}, fmhaConfig.Width);
     Rewriter::read(builder, K, ldgK, getAffineMap("loadTileK", builder), {gridLevel.getIVs()[0], gridLevel.getIVs()[1], 
-      blockLevel.getIVs()[0], outer_reduce.getInductionVar(), hd_outer.getInductionVar()}, fmhaConfig["Width"]);
-    Rewriter::write(builder, ldgQ, smQ, getAffineMap("storeTileQ", builder), {blockLevel.getIVs()[0]}, fmhaConfig["Width"]);
-    auto writeSmK = Rewriter::write(builder, ldgK, smK, getAffineMap("storeTileK", builder), {blockLevel.getIVs()[0]}, fmhaConfig["Width"]);
+      blockLevel.getIVs()[0], outer_reduce.getInductionVar(), hd_outer.getInductionVar()}, fmhaConfig.Width);
+    Rewriter::write(builder, ldgQ, smQ, getAffineMap("storeTileQ", builder), {blockLevel.getIVs()[0]}, fmhaConfig.Width);
+    auto writeSmK = Rewriter::write(builder, ldgK, smK, getAffineMap("storeTileK", builder), {blockLevel.getIVs()[0]}, fmhaConfig.Width);
 
     auto bar2 = Rewriter::barrier(writeSmK, Position::after);
 
@@ -2745,9 +3046,9 @@ void FMHAOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& build
     auto hd_inner = Rewriter::create_constant_loop(builder, 0, Slice, 1);
     builder.setInsertionPointToStart(hd_inner.getBody());
     Rewriter::read(builder, smQ, fragQ, getAffineMap("loadFragQ", builder), {blockLevel.getIVs()[0], hd_inner.getInductionVar()}, 
-      fmhaConfig["Width"]);
+      fmhaConfig.Width);
     Rewriter::read(builder, smK, fragK, getAffineMap("loadFragK", builder), {blockLevel.getIVs()[0], hd_inner.getInductionVar()}, 
-      fmhaConfig["Width"]);
+      fmhaConfig.Width);
 
     Rewriter::outer_product(builder, tileS, fragK, fragQ, BcTileS, BrTileS);
 
@@ -2759,27 +3060,27 @@ void FMHAOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& build
     softmaxIR(builder, tileS, rowMax, smMax, rowSum, smSum, smFac, zero.getResult(), flt_min.getResult(), blockLevel.getIVs()[0]);
 
     ///< Write P(S) to shared memory.
-    auto outerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["BcTileS"], 1);
+    auto outerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.BcTileS, 1);
     builder.setInsertionPointToStart(outerLoop.getBody());
-    auto innerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["BrTileS"], fmhaConfig["Width"]);
+    auto innerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.BrTileS, fmhaConfig.Width);
     builder.setInsertionPointToStart(innerLoop.getBody());
     {
       auto bc = outerLoop.getInductionVar();
       auto br = innerLoop.getInductionVar();
-      auto vectorType = mlir::VectorType::get(fmhaConfig["Width"], tileS.getType().dyn_cast<mlir::MemRefType>().getElementType());
+      auto vectorType = mlir::VectorType::get(fmhaConfig.Width, tileS.getType().dyn_cast<mlir::MemRefType>().getElementType());
       auto ld = builder.create<mlir::AffineVectorLoadOp>(builder.getUnknownLoc(), vectorType, tileS, getAffineMap("readTileS", builder), mlir::ValueRange({bc, br}));
       auto st = builder.create<mlir::AffineVectorStoreOp>(builder.getUnknownLoc(), ld.getResult(), smP, getAffineMap("storeTileP", builder), mlir::ValueRange{blockLevel.getIVs()[0], bc, br}); 
     }
     auto bar3 = Rewriter::barrier(outerLoop, Position::after);
     auto factor = Rewriter::alloc_buffer(bar3, Position::after, MemorySpace::local, {BrTileO}, elementType);
     builder.setInsertionPointAfter(factor.getDefiningOp());
-    Rewriter::read(builder, smFac, factor, getAffineMap("loadFactor", builder), {blockLevel.getIVs()[0]}, fmhaConfig["Width"]);
+    Rewriter::read(builder, smFac, factor, getAffineMap("loadFactor", builder), {blockLevel.getIVs()[0]}, fmhaConfig.Width);
 
     ///< Refactor tileO.
     {
-    auto outerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["BrTileO"], 1);
+    auto outerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.BrTileO, 1);
     builder.setInsertionPointToStart(outerLoop.getBody());
-    auto innerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["HdTileO"], 1);
+    auto innerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.HdTileO, 1);
     builder.setInsertionPointToStart(innerLoop.getBody());
   
     auto br = outerLoop.getInductionVar();
@@ -2802,9 +3103,9 @@ void FMHAOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& build
     builder.setInsertionPointAfter(bar4);
 
     Rewriter::read(builder, V, ldgV, getAffineMap("loadTileV", builder), {gridLevel.getIVs()[0], gridLevel.getIVs()[1], 
-      blockLevel.getIVs()[0], outer_reduce.getInductionVar(), bc_outer.getInductionVar()}, fmhaConfig["Width"]);
+      blockLevel.getIVs()[0], outer_reduce.getInductionVar(), bc_outer.getInductionVar()}, fmhaConfig.Width);
 
-    auto writeSmV = Rewriter::write(builder, ldgV, smV, getAffineMap("storeTileV", builder), {blockLevel.getIVs()[0]}, fmhaConfig["Width"]);
+    auto writeSmV = Rewriter::write(builder, ldgV, smV, getAffineMap("storeTileV", builder), {blockLevel.getIVs()[0]}, fmhaConfig.Width);
 
     auto bar5 = Rewriter::barrier(writeSmV, Position::after);
 
@@ -2814,21 +3115,21 @@ void FMHAOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& build
     auto bc_inner = Rewriter::create_constant_loop(builder, 0, Slice, 1);
     builder.setInsertionPointToStart(bc_inner.getBody());
     Rewriter::read(builder, smP, fragP, getAffineMap("loadFragP", builder), {blockLevel.getIVs()[0], bc_outer.getInductionVar(), bc_inner.getInductionVar()}, 
-      fmhaConfig["Width"]);
+      fmhaConfig.Width);
     Rewriter::read(builder, smV, fragV, getAffineMap("loadFragV", builder), {blockLevel.getIVs()[0], bc_inner.getInductionVar()}, 
-      fmhaConfig["Width"]);
+      fmhaConfig.Width);
 
     Rewriter::outer_product(builder, tileO, fragP, fragV, BrTileO, HdTileO);
 
     ///< Load sum
     auto rowSumO = Rewriter::alloc_buffer(outer_reduce, Position::after, MemorySpace::local, {BrTileO}, elementType);
     builder.setInsertionPointAfter(rowSumO.getDefiningOp());
-    Rewriter::read(builder, smSum, rowSumO, getAffineMap("brIdxO", builder), {blockLevel.getIVs()[0]}, fmhaConfig["Width"]);
+    Rewriter::read(builder, smSum, rowSumO, getAffineMap("brIdxO", builder), {blockLevel.getIVs()[0]}, fmhaConfig.Width);
     ///< Refactor tileO
     {
-    auto outerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["BrTileO"], 1);
+    auto outerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.BrTileO, 1);
     builder.setInsertionPointToStart(outerLoop.getBody());
-    auto innerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["HdTileO"], 1);
+    auto innerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.HdTileO, 1);
     builder.setInsertionPointToStart(innerLoop.getBody());
   
     auto br = outerLoop.getInductionVar();
@@ -2843,15 +3144,15 @@ void FMHAOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& build
     
     ///< Write back O
     {
-    auto outerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["BrTileO"], 1);
+    auto outerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.BrTileO, 1);
     builder.setInsertionPointToStart(outerLoop.getBody());
-    auto innerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig["HdTileO"], fmhaConfig["Width"]);
+    auto innerLoop = Rewriter::create_constant_loop(builder, 0, fmhaConfig.HdTileO, fmhaConfig.Width);
     builder.setInsertionPointToStart(innerLoop.getBody());
   
     auto br = outerLoop.getInductionVar();
     auto hd = innerLoop.getInductionVar();
     
-    auto vectorType = mlir::VectorType::get(fmhaConfig["Width"], tileO.getType().dyn_cast<mlir::MemRefType>().getElementType());
+    auto vectorType = mlir::VectorType::get(fmhaConfig.Width, tileO.getType().dyn_cast<mlir::MemRefType>().getElementType());
     auto ld = builder.create<mlir::AffineVectorLoadOp>(builder.getUnknownLoc(), vectorType, tileO, mlir::ValueRange({br, hd}));
     auto st = builder.create<mlir::AffineVectorStoreOp>(builder.getUnknownLoc(), ld.getResult(), O, getAffineMap("storeTileO", builder), 
         mlir::ValueRange({gridLevel.getIVs()[0], gridLevel.getIVs()[1], gridLevel.getIVs()[2], blockLevel.getIVs()[0], br, hd})); 
@@ -2862,7 +3163,7 @@ void FMHAOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder& build
 /*----------------------------batch matmul-------------------------------*/
 bool BatchMatmulOptimizer::applicable(mlir::ModuleOp& module) {
   clear();
-  auto&& batchMatmulFuncs = Analyzer::collectFunctions(module, "BatchMatmul");
+  auto&& batchMatmulFuncs = filterTargets(Analyzer::collectFunctions(module, "BatchMatmul"));
   bool res = batchMatmulFuncs.size() != 0 ? true : false;
 
   for (auto& batchMatmulFunc : batchMatmulFuncs) {
@@ -3176,17 +3477,17 @@ mlir::AffineMap BatchMatmulOptimizer::getAffineMap(const std::string& mapIdentif
   auto dim7 = builder.getAffineDimExpr(7);
   auto dim8 = builder.getAffineDimExpr(8);
 
-  int64_t block_size_m = batchMatmulConfig["BLOCK_SIZE_M"];
-  int64_t block_size_n = batchMatmulConfig["BLOCK_SIZE_N"];
-  int64_t block_size_k = batchMatmulConfig["BLOCK_SIZE_K"];
-  int64_t thread_size_m = batchMatmulConfig["THREAD_SIZE_M"];
-  int64_t thread_size_n = batchMatmulConfig["THREAD_SIZE_N"];
-  int64_t warpSize = batchMatmulConfig["WARP_SIZE"];
+  int64_t block_size_m = batchMatmulConfig.BLOCK_SIZE_M;
+  int64_t block_size_n = batchMatmulConfig.BLOCK_SIZE_N;
+  int64_t block_size_k = batchMatmulConfig.BLOCK_SIZE_K;
+  int64_t thread_size_m = batchMatmulConfig.THREAD_SIZE_M;
+  int64_t thread_size_n = batchMatmulConfig.THREAD_SIZE_N;
+  int64_t warpSize = batchMatmulConfig.WARP_SIZE;
 
   int64_t blockDimY = block_size_m / thread_size_m;   // thready
   int64_t blockDimX = block_size_n / thread_size_n;   // threadx
-  bool vectorize = batchMatmulConfig.count("VECTORIZE_WIDTH") != 0;
-  int width = vectorize ? batchMatmulConfig["VECTORIZE_WIDTH"] : 1;
+  bool vectorize = batchMatmulConfig.VECTORIZE_WIDTH > 1;
+  int width = vectorize ? batchMatmulConfig.VECTORIZE_WIDTH : 1;
 
   int64_t warp_size_y = 8;  // 将一个warp排列为y方向8个thread
   int64_t warp_size_x = 4;  // 将一个warp排列为x方向4个thread
@@ -3295,8 +3596,8 @@ void BatchMatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder
     // auto descirpe = buffer.matmul;
     auto batchNum = buffer.matmul.batch.size();
 
-    auto m_split_loops = Rewriter::split(loops[loops.size()-3], 3, {batchMatmulConfig["THREAD_SIZE_M"], batchMatmulConfig["BLOCK_SIZE_M"]});
-    auto n_split_loops = Rewriter::split(loops[loops.size()-2], 3, {batchMatmulConfig["THREAD_SIZE_N"], batchMatmulConfig["BLOCK_SIZE_N"]});
+    auto m_split_loops = Rewriter::split(loops[loops.size()-3], 3, {batchMatmulConfig.THREAD_SIZE_M, batchMatmulConfig.BLOCK_SIZE_M});
+    auto n_split_loops = Rewriter::split(loops[loops.size()-2], 3, {batchMatmulConfig.THREAD_SIZE_N, batchMatmulConfig.BLOCK_SIZE_N});
 
     auto loopK = loops[loops.size() - 1];
     auto m_outer = m_split_loops[0]; auto m_mider = m_split_loops[1]; auto m_inner = m_split_loops[2];
@@ -3315,18 +3616,18 @@ void BatchMatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder
     Rewriter::reorder({loopK, m_inner, n_inner});
     DUMP(module);
 
-    auto k_axes = Rewriter::split(loopK, 2, {batchMatmulConfig["BLOCK_SIZE_K"]});
+    auto k_axes = Rewriter::split(loopK, 2, {batchMatmulConfig.BLOCK_SIZE_K});
     auto k_outer = k_axes[0], k_inner = k_axes[1];
     DUMP(module);
 
     int64_t blockThreads;
     auto blockDim = Analyzer::getParallelNumber(blockLevel, blockThreads);
 
-    auto ldgASize = batchMatmulConfig["BLOCK_SIZE_K"] * batchMatmulConfig["BLOCK_SIZE_M"] / blockThreads;
-    auto ldgBSize = batchMatmulConfig["BLOCK_SIZE_K"] * batchMatmulConfig["BLOCK_SIZE_N"] / blockThreads;
-    auto fragASize = batchMatmulConfig["THREAD_SIZE_M"];
-    auto fragBSize = batchMatmulConfig["THREAD_SIZE_N"];
-    auto vectorize_width = batchMatmulConfig["VECTORIZE_WIDTH"];
+    auto ldgASize = batchMatmulConfig.BLOCK_SIZE_K * batchMatmulConfig.BLOCK_SIZE_M / blockThreads;
+    auto ldgBSize = batchMatmulConfig.BLOCK_SIZE_K * batchMatmulConfig.BLOCK_SIZE_N / blockThreads;
+    auto fragASize = batchMatmulConfig.THREAD_SIZE_M;
+    auto fragBSize = batchMatmulConfig.THREAD_SIZE_N;
+    auto vectorize_width = batchMatmulConfig.VECTORIZE_WIDTH;
     auto elementA = A.getType().dyn_cast<mlir::MemRefType>().getElementType();
     auto elementB = B.getType().dyn_cast<mlir::MemRefType>().getElementType();
 
@@ -3336,8 +3637,8 @@ void BatchMatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder
     auto fragB = Rewriter::alloc_buffer(blockLevel, MemorySpace::local, {fragBSize}, elementB);
     auto fragA = Rewriter::alloc_buffer(blockLevel, MemorySpace::local, {fragASize}, elementA);
 
-    auto smB = Rewriter::alloc_buffer(gridLevel, MemorySpace::shared, {batchMatmulConfig["BLOCK_SIZE_K"], batchMatmulConfig["BLOCK_SIZE_N"]}, elementB);
-    auto smA = Rewriter::alloc_buffer(gridLevel, MemorySpace::shared, {batchMatmulConfig["BLOCK_SIZE_K"], batchMatmulConfig["BLOCK_SIZE_M"]}, elementA);
+    auto smB = Rewriter::alloc_buffer(gridLevel, MemorySpace::shared, {batchMatmulConfig.BLOCK_SIZE_K, batchMatmulConfig.BLOCK_SIZE_N}, elementB);
+    auto smA = Rewriter::alloc_buffer(gridLevel, MemorySpace::shared, {batchMatmulConfig.BLOCK_SIZE_K, batchMatmulConfig.BLOCK_SIZE_M}, elementA);
     DUMP(module);
     
     auto blockIdx = Rewriter::getParallelIdx(gridLevel);
@@ -3418,7 +3719,7 @@ void BatchMatmulOptimizer::applyOptimzer(mlir::ModuleOp& module, mlir::OpBuilder
     Rewriter::delete_false_if(module);
     DUMP(module);
   
-    int64_t threshold = std::max(batchMatmulConfig["BLOCK_SIZE_K"], std::max(batchMatmulConfig["THREAD_SIZE_M"], batchMatmulConfig["THREAD_SIZE"]));
+    int64_t threshold = std::max(batchMatmulConfig.BLOCK_SIZE_K, batchMatmulConfig.THREAD_SIZE_M);
     Rewriter::unroll(module, [&](mlir::AffineForOp forOp)->bool {
       if (!forOp.hasConstantBounds()) return false;
       auto step = forOp.getStep();
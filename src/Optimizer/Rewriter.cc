@@ -2454,4 +2454,27 @@ std::vector<mlir::Value> Rewriter::blockLevelOneToTwo(mlir::AffineParallelOp pal
   std::vector<mlir::Value> result{threadIdxY, threadIdxX};
   return result;
 }
+
+std::vector<mlir::Value> Rewriter::swizzleGrid(mlir::AffineParallelOp gridLevel, int64_t groupSizeM) {
+  auto blockIdx = getParallelIdx(gridLevel);
+  auto ranges = gridLevel.getConstantRanges();
+  if (blockIdx.size() != 2 || !ranges || groupSizeM <= 1 || (*ranges)[0] % groupSizeM != 0) return blockIdx;
+  auto gridN = (*ranges)[1];
+
+  mlir::OpBuilder builder(gridLevel);
+  builder.setInsertionPointToStart(gridLevel.getBody());
+  // pid = y * gridN + x is the launch order, every group holds groupSizeM * gridN blocks.
+  auto pid = builder.getAffineDimExpr(0) * gridN + builder.getAffineDimExpr(1);
+  auto local = pid % (groupSizeM * gridN);
+  auto rowMap = mlir::AffineMap::get(2, 0, pid.floorDiv(groupSizeM * gridN) * groupSizeM + local % groupSizeM);
+  auto colMap = mlir::AffineMap::get(2, 0, local.floorDiv(groupSizeM));
+  auto row = builder.create<mlir::AffineApplyOp>(builder.getUnknownLoc(), rowMap, mlir::ValueRange(blockIdx));
+  auto col = builder.create<mlir::AffineApplyOp>(builder.getUnknownLoc(), colMap, mlir::ValueRange(blockIdx));
+
+  llvm::SmallPtrSet<mlir::Operation*, 2> swizzle{row.getOperation(), col.getOperation()};
+  blockIdx[0].replaceAllUsesExcept(row.getResult(), swizzle);
+  blockIdx[1].replaceAllUsesExcept(col.getResult(), swizzle);
+  std::vector<mlir::Value> result{row.getResult(), col.getResult()};
+  return result;
+}
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "KernelCodeGen.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+using namespace KernelCodeGen;
+
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+  if (!condition) {
+    std::printf("FAILED: %s\n", what.c_str());
+    failures += 1;
+  }
+}
+
+const char* getModeName(CPUParallel parallel) {
+  return parallel == CPUParallel::WorkStealing ? "work stealing" : "openmp";
+}
+
+// builds the source of CPUGen into a shared library with the host compiler and loads it.
+// the work stealing kernels link the runtime of the repo, the OpenMP ones get the flags CMake found for it.
+void* loadKernel(const std::string& source, CPUParallel parallel, const std::string& kernel) {
+  llvm::SmallString<128> sourcePath, libraryPath;
+  if (llvm::sys::fs::createTemporaryFile("kcg_cpu", "cc", sourcePath) ||
+      llvm::sys::fs::createTemporaryFile("kcg_cpu", "so", libraryPath)) {
+    return nullptr;
+  }
+  {
+    std::error_code error;
+    llvm::raw_fd_ostream file(sourcePath, error);
+    if (error) return nullptr;
+    file << source;
+  }
+
+  std::vector<std::string> args{KCG_CXX_COMPILER, "-std=c++17", "-O2", "-shared", "-fPIC", "-o",
+                                libraryPath.str().str(), sourcePath.str().str()};
+  if (parallel == CPUParallel::WorkStealing) {
+    args.push_back("-I" KCG_SOURCE_DIR "/include");
+    args.push_back(KCG_SOURCE_DIR "/src/Backend/CPURuntime.cc");
+    args.push_back("-pthread");
+  } else {
+    llvm::SmallVector<llvm::StringRef> flags;
+    llvm::StringRef(KCG_OPENMP_FLAGS).split(flags, ' ', -1, false);
+    for (auto flag : flags) args.push_back(flag.str());
+  }
+  std::vector<llvm::StringRef> argRefs(args.begin(), args.end());
+  std::string message;
+  auto status = llvm::sys::ExecuteAndWait(args[0], argRefs, llvm::None, {}, 0, 0, &message);
+  llvm::sys::fs::remove(sourcePath);
+  if (status != 0) {
+    std::printf("%s: %s\n", args[0].c_str(), message.c_str());
+    return nullptr;
+  }
+
+  auto library = llvm::sys::DynamicLibrary::getPermanentLibrary(libraryPath.c_str(), &message);
+  llvm::sys::fs::remove(libraryPath);
+  if (!library.isValid()) {
+    std::printf("%s\n", message.c_str());
+    return nullptr;
+  }
+  return library.getAddressOfSymbol(kernel.c_str());
+}
+
+int64_t countMismatches(const std::vector<float>& expected, const std::vector<float>& actual, float tolerance) {
+  int64_t mismatches = 0;
+  for (int64_t i = 0; i < expected.size(); i++) {
+    if (!(std::fabs(expected[i] - actual[i]) <= tolerance * (1.0f + std::fabs(expected[i])))) mismatches += 1;
+  }
+  return mismatches;
+}
+
+// the MatmulOptimizer kernel stages the tiles of A and B in shared memory between barriers, its CPU form must
+// compute the C of the naive graph run through the HostJIT.
+void test_matmul(int64_t m, int64_t n, int64_t k) {
+  auto shape = std::to_string(m) + "x" + std::to_string(n) + "x" + std::to_string(k);
+  KernelCodeGenerator generator("CPU");
+  generator.setLogMode(Log::Release);
+  generator.opts.push_back(std::move(std::make_unique<MatmulOptimizer>()));
+  auto& graph = generator.createGraph("cpu_backend_matmul");
+  auto A = graph.create<PlaceHolder>(std::vector<int64_t>{m, k}, std::string{"float32"});
+  auto B = graph.create<PlaceHolder>(std::vector<int64_t>{k, n}, std::string{"float32"});
+  graph.create<Matmul>(A, B);
+
+  // small integers keep every partial sum exact, so any order of the k loop gives the same C.
+  std::vector<float> a(m * k), b(k * n), naive(m * n, NAN);
+  for (int64_t i = 0; i < a.size(); i++) a[i] = static_cast<float>(i % 7) - 3.0f;
+  for (int64_t i = 0; i < b.size(); i++) b[i] = static_cast<float>(i % 5) - 2.0f;
+  std::vector<HostBuffer> inputs{{a.data(), {m, k}}, {b.data(), {k, n}}};
+  std::vector<HostBuffer> outputs{{naive.data(), {m, n}}};
+  check(generator.runGraph(inputs, outputs), shape + ": the naive matmul runs");
+
+  auto& module = generator.optimize(graph);
+  int64_t barriers = 0, sharedBuffers = 0;
+  module.walk([&](mlir::gpu::BarrierOp) { barriers += 1; });
+  module.walk([&](mlir::memref::AllocOp allocOp) {
+    if (allocOp.getType().getMemorySpaceAsInt() == static_cast<int>(MemorySpace::shared)) sharedBuffers += 1;
+  });
+  check(barriers > 0 && sharedBuffers > 0, shape + ": the matmul is staged in shared memory");
+
+  for (auto parallel : {CPUParallel::OpenMP, CPUParallel::WorkStealing}) {
+    auto mode = shape + " " + getModeName(parallel);
+    generator.setCPUParallel(parallel);
+    // the kernel takes the arguments of the function, then the C it returns.
+    using Kernel = void (*)(float*, float*, float*);
+    auto kernel = reinterpret_cast<Kernel>(loadKernel(generator.codegen(module), parallel, "kernel0"));
+    check(kernel != nullptr, mode + ": the source builds");
+    if (kernel == nullptr) continue;
+    std::vector<float> c(m * n, NAN);
+    kernel(a.data(), b.data(), c.data());
+    auto mismatches = countMismatches(naive, c, 0.0f);
+    check(mismatches == 0, mode + ": " + std::to_string(mismatches) + " elements differ");
+    std::printf("%s: %lld barriers, %lld mismatches\n", mode.c_str(), static_cast<long long>(barriers),
+                static_cast<long long>(mismatches));
+  }
+}
+
+// the LayerNormOptimizer kernel reduces the rows with gpu.shuffle, which reads the values of the other threads.
+void test_layer_norm(int64_t rows, int64_t cols) {
+  auto shape = std::to_string(rows) + "x" + std::to_string(cols);
+  KernelCodeGenerator generator("CPU");
+  generator.setLogMode(Log::Release);
+  generator.opts.push_back(std::move(std::make_unique<LayerNormOptimizer>()));
+  auto& graph = generator.createGraph("cpu_backend_layer_norm");
+  auto input = graph.create<PlaceHolder>(std::vector<int64_t>{rows, cols}, std::string{"float32"});
+  auto scale = graph.create<PlaceHolder>(std::vector<int64_t>{cols}, std::string{"float32"});
+  auto bias = graph.create<PlaceHolder>(std::vector<int64_t>{cols}, std::string{"float32"});
+  graph.create<LayerNorm>(input, scale, bias, 1);
+
+  std::vector<float> x(rows * cols), gamma(cols), beta(cols), naive(rows * cols, NAN);
+  for (int64_t i = 0; i < x.size(); i++) x[i] = static_cast<float>((i * 7) % 13) * 0.25f - 1.5f;
+  for (int64_t i = 0; i < cols; i++) gamma[i] = 1.0f + static_cast<float>(i % 3) * 0.5f;
+  for (int64_t i = 0; i < cols; i++) beta[i] = static_cast<float>(i % 5) * 0.1f;
+  std::vector<HostBuffer> inputs{{x.data(), {rows, cols}}, {gamma.data(), {cols}}, {beta.data(), {cols}}};
+  std::vector<HostBuffer> outputs{{naive.data(), {rows, cols}}};
+  check(generator.runGraph(inputs, outputs), shape + ": the naive layer norm runs");
+
+  auto& module = generator.optimize(graph);
+  int64_t shuffles = 0;
+  module.walk([&](mlir::gpu::ShuffleOp) { shuffles += 1; });
+  check(shuffles > 0, shape + ": the rows are reduced with gpu.shuffle");
+
+  for (auto parallel : {CPUParallel::OpenMP, CPUParallel::WorkStealing}) {
+    auto mode = shape + " " + getModeName(parallel);
+    generator.setCPUParallel(parallel);
+    using Kernel = void (*)(float*, float*, float*, float*);
+    auto kernel = reinterpret_cast<Kernel>(loadKernel(generator.codegen(module), parallel, "kernel0"));
+    check(kernel != nullptr, mode + ": the source builds");
+    if (kernel == nullptr) continue;
+    std::vector<float> y(rows * cols, NAN);
+    kernel(x.data(), gamma.data(), beta.data(), y.data());
+    // the tree of the shuffles sums in another order than the loop of the naive graph.
+    auto mismatches = countMismatches(naive, y, 1e-4f);
+    check(mismatches == 0, mode + ": " + std::to_string(mismatches) + " elements differ");
+    std::printf("%s: %lld gpu.shuffle, %lld mismatches\n", mode.c_str(), static_cast<long long>(shuffles),
+                static_cast<long long>(mismatches));
+  }
+}
+
+int main() {
+  // the default configs: 128x128 tiles of C, 2048 columns per block of the layer norm.
+  test_matmul(256, 256, 64);
+  test_layer_norm(16, 2048);
+  return failures == 0 ? 0 : 1;
+}
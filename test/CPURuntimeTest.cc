@@ -0,0 +1,116 @@
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Backend/CPURuntime.h"
+using namespace KernelCodeGen;
+
+
+std::atomic<int> failures{0};
+
+void check(bool condition, const std::string& what) {
+  if (!condition) {
+    std::printf("FAILED: %s\n", what.c_str());
+    failures += 1;
+  }
+}
+
+// counts how often every iteration ran.
+struct Counts {
+  std::vector<std::atomic<int>> hits;
+  explicit Counts(int64_t size) : hits(size) {}
+
+  static void fn(int64_t begin, int64_t end, void* context) {
+    auto counts = static_cast<Counts*>(context);
+    for (auto i = begin; i < end; i++) counts->hits[i] += 1;
+  }
+
+  bool once() const {
+    for (auto& hit : hits) {
+      if (hit != 1) return false;
+    }
+    return true;
+  }
+};
+
+void test_every_iteration_once(WorkStealingPool& pool) {
+  for (int64_t size : {0, 1, 7, 1000, 100003}) {
+    for (int64_t grain : {0, 1, 3, 64, 1000000}) {
+      Counts counts(size);
+      pool.parallelFor(0, size, grain, Counts::fn, &counts);
+      check(counts.once(), "size " + std::to_string(size) + " grain " + std::to_string(grain) + " runs once");
+    }
+  }
+  Counts counts(50);
+  pool.parallelFor(10, 40, 1, Counts::fn, &counts);
+  bool inside = true;
+  for (int64_t i = 0; i < 50; i++) inside &= counts.hits[i] == (i >= 10 && i < 40 ? 1 : 0);
+  check(inside, "only [begin, end) runs");
+}
+
+// every outer iteration runs a parallelFor of its own on the same pool, the waiting callers help instead of blocking.
+struct Nested {
+  WorkStealingPool* pool;
+  int64_t inner;
+  std::vector<Counts> counts;
+
+  static void fn(int64_t begin, int64_t end, void* context) {
+    auto nested = static_cast<Nested*>(context);
+    for (auto i = begin; i < end; i++) {
+      nested->pool->parallelFor(0, nested->inner, 1, Counts::fn, &nested->counts[i]);
+    }
+  }
+};
+
+void test_nested(WorkStealingPool& pool) {
+  Nested nested{&pool, 257, {}};
+  for (int i = 0; i < 64; i++) nested.counts.emplace_back(nested.inner);
+  pool.parallelFor(0, 64, 1, Nested::fn, &nested);
+  bool once = true;
+  for (auto& counts : nested.counts) once &= counts.once();
+  check(once, "nested calls run every inner iteration once");
+}
+
+void test_concurrent_callers(WorkStealingPool& pool) {
+  std::vector<std::thread> callers;
+  for (int caller = 0; caller < 4; caller++) {
+    callers.emplace_back([&pool, caller]() {
+      for (int round = 0; round < 20; round++) {
+        Counts counts(10000 + caller);
+        pool.parallelFor(0, counts.hits.size(), 16, Counts::fn, &counts);
+        check(counts.once(), "caller " + std::to_string(caller) + " runs every iteration once");
+      }
+    });
+  }
+  for (auto& caller : callers) caller.join();
+}
+
+// the C API goes through the global pool, a restart must not lose iterations.
+void test_c_api() {
+  kcg_runtime_set_threads(3);
+  check(kcg_runtime_num_threads() == 3, "the global pool has 3 threads");
+  kcg_runtime_reset_stats();
+  Counts counts(4096);
+  kcg_parallel_for(0, 4096, 0, Counts::fn, &counts);
+  check(counts.once(), "kcg_parallel_for runs every iteration once");
+
+  std::vector<kcg_worker_stats> stats(8);
+  auto written = kcg_runtime_stats(stats.data(), stats.size());
+  uint64_t chunks = 0;
+  for (int i = 0; i < written; i++) chunks += stats[i].chunks;
+  check(written > 0 && chunks > 0, "the stats count the chunks");
+  kcg_runtime_set_threads(0);
+}
+
+int main() {
+  for (int threads : {1, 4}) {
+    WorkStealingPool pool(threads);
+    test_every_iteration_once(pool);
+    test_nested(pool);
+    test_concurrent_callers(pool);
+  }
+  test_c_api();
+  std::printf("%d failures\n", failures.load());
+  return failures == 0 ? 0 : 1;
+}
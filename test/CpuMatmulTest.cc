@@ -0,0 +1,92 @@
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "KernelCodeGen.h"
+using namespace KernelCodeGen;
+
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+  if (!condition) {
+    std::printf("FAILED: %s\n", what.c_str());
+    failures += 1;
+  }
+}
+
+// C = A * B of the naive graph and of the CpuMatmulOptimizer blocking, both run through the HostJIT.
+void test_matmul(int64_t m, int64_t n, int64_t k) {
+  auto shape = std::to_string(m) + "x" + std::to_string(n) + "x" + std::to_string(k);
+  KernelCodeGenerator generator("CPU");
+  generator.setLogMode(Log::Release);
+  auto config = CpuMatmulConfig::host();
+  generator.opts.push_back(std::move(std::make_unique<CpuMatmulOptimizer>(config)));
+  auto& graph = generator.createGraph("cpu_matmul");
+  auto A = graph.create<PlaceHolder>(std::vector<int64_t>{m, k}, std::string{"float32"});
+  auto B = graph.create<PlaceHolder>(std::vector<int64_t>{k, n}, std::string{"float32"});
+  graph.create<Matmul>(A, B);
+
+  // small integers keep every partial sum exact, so any reordering of the k loop gives the same C.
+  std::vector<float> a(m * k), b(k * n);
+  for (int64_t i = 0; i < a.size(); i++) a[i] = static_cast<float>(i % 7) - 3.0f;
+  for (int64_t i = 0; i < b.size(); i++) b[i] = static_cast<float>(i % 5) - 2.0f;
+  std::vector<HostBuffer> inputs{{a.data(), {m, k}}, {b.data(), {k, n}}};
+
+  std::vector<float> naive(m * n, NAN), optimized(m * n, NAN);
+  std::vector<HostBuffer> outputs{{naive.data(), {m, n}}};
+  check(generator.runGraph(inputs, outputs), shape + ": the naive matmul runs");
+
+  auto& module = generator.optimize(graph);
+  int64_t fmas = 0;
+  module.walk([&](mlir::vector::FMAOp) { fmas += 1; });
+  // N must be a multiple of NR to be blocked, the other matmuls keep the naive loops.
+  check((fmas > 0) == (n % config.NR == 0), shape + ": blocked iff N is a multiple of NR");
+
+  outputs = {{optimized.data(), {m, n}}};
+  check(generator.runGraph(inputs, outputs), shape + ": the optimized matmul runs");
+
+  int64_t mismatches = 0;
+  for (int64_t i = 0; i < m * n; i++) {
+    if (!(naive[i] == optimized[i])) mismatches += 1;
+  }
+  check(mismatches == 0, shape + ": " + std::to_string(mismatches) + " elements differ");
+  std::printf("%s: %lld vector.fma, %lld mismatches\n", shape.c_str(), static_cast<long long>(fmas),
+              static_cast<long long>(mismatches));
+}
+
+// a new graph on the same generator runs its own functions, not the optimized module of the last graph.
+void test_second_graph() {
+  KernelCodeGenerator generator("CPU");
+  generator.setLogMode(Log::Release);
+  generator.opts.push_back(std::move(std::make_unique<CpuMatmulOptimizer>()));
+  for (auto shape : {std::vector<int64_t>{64, 64, 64}, std::vector<int64_t>{48, 32, 16}}) {
+    int64_t m = shape[0], n = shape[1], k = shape[2];
+    auto name = std::to_string(m) + "x" + std::to_string(n) + "x" + std::to_string(k);
+    auto& graph = generator.createGraph("graph_" + name);
+    auto A = graph.create<PlaceHolder>(std::vector<int64_t>{m, k}, std::string{"float32"});
+    auto B = graph.create<PlaceHolder>(std::vector<int64_t>{k, n}, std::string{"float32"});
+    graph.create<Matmul>(A, B);
+
+    std::vector<float> a(m * k, 1.0f), b(k * n, 2.0f), c(m * n, NAN);
+    std::vector<HostBuffer> inputs{{a.data(), {m, k}}, {b.data(), {k, n}}};
+    std::vector<HostBuffer> outputs{{c.data(), {m, n}}};
+    // the first graph is optimized, the second one runs before optimize().
+    if (m == 64) generator.optimize(graph);
+    check(generator.runGraph(inputs, outputs), name + ": runs after another graph");
+    int64_t wrong = 0;
+    for (auto value : c) wrong += value != 2.0f * k;
+    check(wrong == 0, name + ": " + std::to_string(wrong) + " wrong elements after another graph");
+  }
+}
+
+int main() {
+  // multiples of the blocking, then M off MR, K off KC and above it, M above MC, and an N the optimizer skips.
+  test_matmul(64, 64, 64);
+  test_matmul(67, 96, 131);
+  test_matmul(100, 160, 300);
+  test_matmul(203, 128, 97);
+  test_matmul(13, 40, 7);
+  test_second_graph();
+  return failures == 0 ? 0 : 1;
+}
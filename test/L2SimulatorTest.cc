@@ -0,0 +1,58 @@
+#include <cstdio>
+#include <set>
+#include "AutoTune/L2Simulator.h"
+using namespace KernelCodeGen;
+
+
+int failures = 0;
+
+void check(bool condition, const char* what) {
+  if (!condition) {
+    std::printf("FAILED: %s\n", what);
+    failures += 1;
+  }
+}
+
+// every tile is launched once, whatever the group size.
+void test_rasterize() {
+  for (int64_t group : {1, 2, 3, 8, 16}) {
+    auto order = L2Simulator::rasterize(10, 7, group);
+    std::set<std::pair<int64_t, int64_t>> tiles(order.begin(), order.end());
+    check(order.size() == 70 && tiles.size() == 70, "rasterize covers every tile once");
+    for (auto& tile : order) {
+      check(tile.first >= 0 && tile.first < 10 && tile.second >= 0 && tile.second < 7, "rasterize stays in the grid");
+    }
+  }
+  auto rowMajor = L2Simulator::rasterize(4, 4, 1);
+  check(rowMajor[1] == std::make_pair<int64_t, int64_t>(0, 1), "group 1 is row major");
+  auto grouped = L2Simulator::rasterize(4, 4, 2);
+  check(grouped[1] == std::make_pair<int64_t, int64_t>(1, 0), "group 2 walks down the column first");
+}
+
+// a wave of row major blocks spans a row or two of C and every tile of B, grouped blocks share both.
+void test_grouped_beats_row_major() {
+  DeviceProfile device;
+  auto l2 = L2Config::fromDevice(device, 2);
+  GemmTiling tiling;
+  tiling.m = tiling.n = tiling.k = 8192;
+  tiling.blockM = tiling.blockN = 128;
+  tiling.blockK = 32;
+
+  tiling.groupSizeM = 1;
+  auto rowMajor = L2Simulator::simulateGemm(tiling, l2, 2);
+  tiling.groupSizeM = 8;
+  auto grouped = L2Simulator::simulateGemm(tiling, l2, 2);
+  std::printf("8192^3 row major: hit rate %.3f, %lld MB from DRAM\n", rowMajor.hitRate(),
+              static_cast<long long>(rowMajor.dramBytes() >> 20));
+  std::printf("8192^3 grouped 8: hit rate %.3f, %lld MB from DRAM\n", grouped.hitRate(),
+              static_cast<long long>(grouped.dramBytes() >> 20));
+  check(rowMajor.simulatedBlocks == grouped.simulatedBlocks, "the same blocks are simulated");
+  check(grouped.dramBytes() < rowMajor.dramBytes(), "grouped rasterization reads less from DRAM");
+  check(grouped.hitRate() > rowMajor.hitRate(), "grouped rasterization hits L2 more often");
+}
+
+int main() {
+  test_rasterize();
+  test_grouped_beats_row_major();
+  return failures == 0 ? 0 : 1;
+}
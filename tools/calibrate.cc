@@ -0,0 +1,138 @@
+#include "KernelCodeGen.h"
+#include "AutoTune/Calibration.h"
+
+#include "llvm/Support/FormatVariadic.h"
+
+#include <string>
+#include <vector>
+
+using namespace KernelCodeGen;
+
+// Scores the matmul kernels of a benchmark log with a cost model and fits the correction of the device.
+//   calibrate <log> [--device=profile.json] [--evaluator=roofline|analytical] [--model=trees.json]
+//             [--save=profile.json] [--top=5]
+// --model prices with a LearnedEvaluator, the correction only applies to the roofline and analytical models.
+
+namespace {
+
+bool option(const std::string& arg, const std::string& name, std::string& value) {
+  auto prefix = "--" + name + "=";
+  if (arg.compare(0, prefix.size(), prefix) != 0) return false;
+  value = arg.substr(prefix.size());
+  return true;
+}
+
+void usage() {
+  llvm::errs() << "usage: calibrate <log> [--device=profile.json] [--evaluator=roofline|analytical] "
+               << "[--model=trees.json] [--save=profile.json] [--top=5]\n";
+}
+
+void report(const std::string& title, const std::vector<Measurement>& measurements) {
+  auto accuracy = Calibration::accuracy(measurements);
+  llvm::outs() << llvm::formatv("{0,-12} kendall {1,6:f3}  spearman {2,6:f3}  MAPE {3,8:f2}%\n",
+                                title, accuracy.kendall, accuracy.spearman, accuracy.mape);
+}
+
+}
+
+int main(int argc, char** argv) {
+  std::string logPath, devicePath, evaluatorName = "roofline", modelPath, savePath, value;
+  int top = 5;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (option(arg, "device", value)) devicePath = value;
+    else if (option(arg, "evaluator", value)) evaluatorName = value;
+    else if (option(arg, "model", value)) modelPath = value;
+    else if (option(arg, "save", value)) savePath = value;
+    else if (option(arg, "top", value)) top = std::atoi(value.c_str());
+    else if (arg.compare(0, 2, "--") != 0 && logPath.empty()) logPath = arg;
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (logPath.empty()) {
+    usage();
+    return 1;
+  }
+
+  std::vector<Measurement> measurements;
+  if (!Calibration::parseLog(logPath, measurements)) return 1;
+  if (measurements.empty()) {
+    llvm::errs() << "No measured kernel in \"" << logPath << "\"\n";
+    return 1;
+  }
+
+  DeviceProfile device;
+  if (!devicePath.empty() && !device.load(devicePath)) return 1;
+  // the raw model is scored, a previous correction would hide its error.
+  auto raw = device;
+  raw.latencyScale = 1.0;
+  raw.latencyOffsetUs = 0.0;
+
+  KernelCodeGenerator generator("CUDA");
+  generator.setDeviceProfile(raw);
+  generator.setIncremental(false);
+  generator.setOccupancyFloor(0.0f);
+  if (!modelPath.empty()) {
+    auto learned = std::make_unique<LearnedEvaluator>();
+    if (!learned->load(modelPath)) return 1;
+    generator.setEvaluator(std::move(learned));
+  } else if (evaluatorName == "analytical") {
+    generator.setEvaluator(std::make_unique<AnalyticalEvaluator>());
+  } else if (evaluatorName != "roofline") {
+    usage();
+    return 1;
+  }
+  generator.opts.push_back(std::move(std::make_unique<MatmulOptimizer>()));
+  auto& matmul = *generator.opts.back();
+  auto defaults = toRecord(MatmulConfig());
+
+  // regenerate every kernel with its config and price it.
+  std::vector<Measurement> scored;
+  for (auto& measurement : measurements) {
+    auto symbol = "Matmul_M" + std::to_string(measurement.m) + "_N" + std::to_string(measurement.n) +
+                  "_K" + std::to_string(measurement.k);
+    auto& graph = generator.createGraph(symbol);
+    auto A = graph.create<PlaceHolder>(std::vector<int64_t>{measurement.m, measurement.k}, std::string{"float32"});
+    auto B = graph.create<PlaceHolder>(std::vector<int64_t>{measurement.k, measurement.n}, std::string{"float32"});
+    graph.create<Matmul>(A, B);
+
+    generator.setConfigs(matmul, {measurement.config.empty() ? defaults : measurement.config});
+    auto& module = generator.optimize(graph);
+    if (generator.getTunedFunctions().empty()) {
+      llvm::errs() << "Skipped " << symbol << ": the config doesn't apply\n";
+      continue;
+    }
+    measurement.predicted = generator.evaluate(module);
+    scored.push_back(measurement);
+  }
+  if (scored.empty()) return 1;
+
+  llvm::outs() << "kernels: " << scored.size() << " of " << measurements.size() << "\n";
+  report("raw", scored);
+
+  double scale = 1.0, offsetMs = 0.0;
+  Calibration::fitCorrection(scored, scale, offsetMs);
+  auto corrected = scored;
+  for (auto& measurement : corrected) measurement.predicted = measurement.predicted * scale + offsetMs;
+  llvm::outs() << llvm::formatv("correction: {0:f4} * ms + {1:f2} us\n", scale, offsetMs * 1e3);
+  report("corrected", corrected);
+
+  llvm::outs() << "worst outliers (corrected):\n";
+  for (auto index : Calibration::outliers(corrected, top)) {
+    auto& measurement = corrected[index];
+    llvm::outs() << llvm::formatv("  M={0} N={1} K={2}  measured {3:f4} ms  predicted {4:f4} ms  ({5:f1}%)\n",
+                                  measurement.m, measurement.n, measurement.k, measurement.measured,
+                                  measurement.predicted,
+                                  (measurement.predicted - measurement.measured) / measurement.measured * 100.0);
+  }
+
+  if (!savePath.empty()) {
+    device.latencyScale = scale;
+    device.latencyOffsetUs = offsetMs * 1e3;
+    if (!device.save(savePath)) return 1;
+    llvm::outs() << "saved the corrected profile to " << savePath << "\n";
+  }
+  return 0;
+}